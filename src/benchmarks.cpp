@@ -0,0 +1,204 @@
+#include "benchmarks.h"
+#include "includes/Bvh.h"
+#include "helpers/bounds.h"
+#include "helpers/frustum.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Buildings on a square plot; ~4 x 4 units of ground per building
+    std::vector<Bounds> MakeCity(size_t count, std::mt19937& gen)
+    {
+        float side = 4.0f * std::sqrt((float)count);
+        std::uniform_real_distribution<float> position(-side * 0.5f, side * 0.5f);
+        std::uniform_real_distribution<float> footprint(0.5f, 1.5f);
+        std::uniform_real_distribution<float> height(2.0f, 30.0f);
+
+        std::vector<Bounds> city(count);
+        for (Bounds& b : city)
+        {
+            glm::vec3 base(position(gen), 0.0f, position(gen));
+            glm::vec3 half(footprint(gen), 0.0f, footprint(gen));
+            b = Bounds::FromBox(base - half, base + half + glm::vec3(0.0f, height(gen), 0.0f));
+        }
+        return city;
+    }
+
+    bool BoxInFrustum(const Frustum& frustum, const Bounds& b)
+    {
+        glm::vec3 center = (b.min + b.max) * 0.5f, extent = (b.max - b.min) * 0.5f;
+        for (const glm::vec4& p : frustum.planes)
+            if (glm::dot(glm::vec3(p), center) + glm::dot(glm::abs(glm::vec3(p)), extent) + p.w < 0.0f)
+                return false;
+        return true;
+    }
+
+    bool BoxTouchesSphere(const Bounds& b, const glm::vec3& center, float radius)
+    {
+        glm::vec3 d = center - glm::clamp(center, b.min, b.max);
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    bool BoxOverlapsBox(const Bounds& b, const glm::vec3& min, const glm::vec3& max)
+    {
+        return glm::all(glm::lessThanEqual(b.min, max)) && glm::all(glm::lessThanEqual(min, b.max));
+    }
+
+    float RayEnter(const Bounds& b, const Bvh::Ray& ray)
+    {
+        glm::vec3 invDir = 1.0f / ray.direction;
+        glm::vec3 t0 = (b.min - ray.origin) * invDir, t1 = (b.max - ray.origin) * invDir;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit  = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, ray.tMax));
+        return entry <= exit ? entry : FLT_MAX;
+    }
+
+    void Report(const char* name, double bvhMs, double linearMs, size_t queries, size_t results, size_t mismatches)
+    {
+        std::cout << "  " << std::left << std::setw(8) << name << std::right
+                  << std::setw(10) << bvhMs * 1000.0 / queries << " us/query (bvh)"
+                  << std::setw(10) << linearMs * 1000.0 / queries << " us/query (linear)"
+                  << std::setw(9) << (double)results / queries << " hits/query";
+        if (mismatches)
+            std::cout << "  MISMATCHES: " << mismatches;
+        std::cout << std::endl;
+    }
+
+    void RunOne(size_t count, std::mt19937& gen)
+    {
+        const size_t QUERIES = 1000;
+        std::vector<Bounds> city = MakeCity(count, gen);
+        float side = 4.0f * std::sqrt((float)count);
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << count << " objects" << std::endl;
+
+        Bvh bvh;
+        Clock::time_point start = Clock::now();
+        bvh.Build(city, 1);
+        double serialMs = MillisecondsSince(start);
+
+        start = Clock::now();
+        bvh.Build(city);
+        double parallelMs = MillisecondsSince(start);
+
+        // nudge a tenth of the buildings, as moving objects would between frames
+        std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+        for (size_t i = 0; i < city.size(); i += 10)
+        {
+            glm::vec3 d(nudge(gen), 0.0f, nudge(gen));
+            city[i] = Bounds::FromBox(city[i].min + d, city[i].max + d);
+        }
+        start = Clock::now();
+        bvh.Refit(city);
+        double refitMs = MillisecondsSince(start);
+
+        std::cout << "  build " << serialMs << " ms (1 thread), " << parallelMs << " ms (all threads), refit "
+                  << refitMs << " ms, " << bvh.NodeCount() << " nodes" << std::endl;
+
+        // same query set for the BVH and the linear scan
+        std::uniform_real_distribution<float> ground(-side * 0.5f, side * 0.5f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::vector<glm::vec3> points(QUERIES), directions(QUERIES);
+        for (size_t q = 0; q < QUERIES; ++q)
+        {
+            points[q] = glm::vec3(ground(gen), 20.0f, ground(gen));
+            float a = angle(gen);
+            directions[q] = glm::vec3(std::cos(a), -0.2f, std::sin(a));
+        }
+
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        std::vector<Frustum> frustums(QUERIES);
+        for (size_t q = 0; q < QUERIES; ++q)
+            frustums[q] = Frustum::FromMatrix(projection * glm::lookAt(points[q], points[q] + directions[q], glm::vec3(0.0f, 1.0f, 0.0f)));
+        std::vector<uint32_t> out, expected;
+        size_t results = 0, linearResults = 0, mismatches = 0;
+        double bvhMs = 0.0, linearMs = 0.0;
+
+        auto measure = [&](auto bvhQuery, auto linearTest) {
+            results = linearResults = mismatches = 0;
+            bvhMs = linearMs = 0.0;
+            for (size_t q = 0; q < QUERIES; ++q)
+            {
+                out.clear();
+                Clock::time_point t = Clock::now();
+                bvhQuery(q);
+                bvhMs += MillisecondsSince(t);
+                results += out.size();
+
+                expected.clear();
+                t = Clock::now();
+                for (uint32_t i = 0; i < city.size(); ++i)
+                {
+                    if (linearTest(q, city[i]))
+                        expected.push_back(i);
+                }
+                linearMs += MillisecondsSince(t);
+                // the same primitives, not just as many: the BVH reports them in tree order
+                std::sort(out.begin(), out.end());
+                mismatches += out != expected;
+            }
+        };
+
+        measure([&](size_t q) { bvh.QueryFrustum(frustums[q], out); },
+                [&](size_t q, const Bounds& b) { return BoxInFrustum(frustums[q], b); });
+        Report("frustum", bvhMs, linearMs, QUERIES, results, mismatches);
+
+        measure([&](size_t q) { bvh.QuerySphere(points[q], 25.0f, out); },
+                [&](size_t q, const Bounds& b) { return BoxTouchesSphere(b, points[q], 25.0f); });
+        Report("sphere", bvhMs, linearMs, QUERIES, results, mismatches);
+
+        measure([&](size_t q) { bvh.QueryBox(points[q] - glm::vec3(20.0f), points[q] + glm::vec3(20.0f), out); },
+                [&](size_t q, const Bounds& b) { return BoxOverlapsBox(b, points[q] - glm::vec3(20.0f), points[q] + glm::vec3(20.0f)); });
+        Report("box", bvhMs, linearMs, QUERIES, results, mismatches);
+
+        // rays: compare the nearest hit distance instead of a hit list
+        results = mismatches = 0;
+        bvhMs = linearMs = 0.0;
+        for (size_t q = 0; q < QUERIES; ++q)
+        {
+            Bvh::Ray ray = { points[q], directions[q], 500.0f };
+            Bvh::Hit hit;
+            Clock::time_point t = Clock::now();
+            bool found = bvh.Raycast(ray, hit);
+            bvhMs += MillisecondsSince(t);
+            results += found;
+
+            float nearest = FLT_MAX;
+            t = Clock::now();
+            for (const Bounds& b : city)
+                nearest = std::min(nearest, RayEnter(b, ray));
+            linearMs += MillisecondsSince(t);
+            mismatches += found ? (nearest != hit.t) : (nearest != FLT_MAX);
+        }
+        Report("ray", bvhMs, linearMs, QUERIES, results, mismatches);
+    }
+}
+
+int RunBvhBenchmark(size_t objectCount)
+{
+    std::mt19937 gen(1234);
+    for (size_t count = 1000; count < objectCount; count *= 10)
+        RunOne(count, gen);
+    RunOne(objectCount, gen);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+// Builds a synthetic city of objectCount boxes (constant density, so the city
+// grows in area with the count) at a few sizes up to objectCount and prints
+// BVH build, refit and query timings next to a linear scan of the same boxes.
+// Run with: Final --bench-bvh [objectCount]
+int RunBvhBenchmark(size_t objectCount);
@@ -0,0 +1,333 @@
+#pragma once
+
+/* Error-bounded keyframe reduction and quantization for bone tracks */
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+struct AnimCompressionSettings
+{
+	/*max distance (model units) a dropped translation key may drift from the curve*/
+	float positionError = 0.0005f;
+
+	/*max angle (radians) a dropped rotation key may drift from the curve*/
+	float rotationError = 0.0005f;
+
+	/*max absolute error a dropped scale key may drift from the curve*/
+	float scaleError = 0.0005f;
+};
+
+namespace AnimCompression
+{
+	// Marks which keys survive a Ramer-Douglas-Peucker style pass over time: a segment
+	// is split at its worst interior key until every dropped key is within tolerance
+	// of the interpolation between the kept keys around it.
+	template<typename T, typename Lerp, typename Error>
+	std::vector<bool> ReduceKeys(const std::vector<float>& times, const std::vector<T>& values,
+		float tolerance, Lerp lerp, Error error)
+	{
+		const int count = (int)values.size();
+		std::vector<bool> keep(count, false);
+		if (count == 0)
+			return keep;
+
+		keep[0] = true;
+		keep[count - 1] = true;
+
+		std::vector<std::pair<int, int>> segments;
+		if (count > 2)
+			segments.push_back({ 0, count - 1 });
+
+		while (!segments.empty())
+		{
+			auto [first, last] = segments.back();
+			segments.pop_back();
+
+			float span = times[last] - times[first];
+			float worstError = 0.0f;
+			int worstIndex = -1;
+			for (int i = first + 1; i < last; ++i)
+			{
+				float factor = span > 0.0f ? (times[i] - times[first]) / span : 0.0f;
+				float e = error(values[i], lerp(values[first], values[last], factor));
+				if (e > worstError)
+				{
+					worstError = e;
+					worstIndex = i;
+				}
+			}
+
+			if (worstIndex >= 0 && worstError > tolerance)
+			{
+				keep[worstIndex] = true;
+				if (worstIndex - first > 1) segments.push_back({ first, worstIndex });
+				if (last - worstIndex > 1) segments.push_back({ worstIndex, last });
+			}
+		}
+
+		// a track that never leaves tolerance of its first key collapses to a constant
+		if (count > 1 && error(values[0], values[count - 1]) <= tolerance)
+		{
+			bool constant = true;
+			for (int i = 1; i < count && constant; ++i)
+				constant = error(values[0], values[i]) <= tolerance;
+			if (constant)
+				std::fill(keep.begin() + 1, keep.end(), false);
+		}
+
+		return keep;
+	}
+
+	inline uint16_t QuantizeUnit(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return (uint16_t)std::lround(value * 65535.0f);
+	}
+
+	inline float DequantizeUnit(uint16_t value)
+	{
+		return value / 65535.0f;
+	}
+
+	// Smallest-three encoding: the largest component is dropped (recovered from unit
+	// length), the other three are stored in 15 bits each and the dropped index in 2 bits.
+	inline void PackQuat(const glm::quat& q, uint16_t out[3])
+	{
+		const float kRange = 0.70710678f; // 1/sqrt(2), bound on the three smallest components
+		float c[4] = { q.x, q.y, q.z, q.w };
+
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+			if (std::fabs(c[i]) > std::fabs(c[largest]))
+				largest = i;
+		float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+		uint64_t packed = (uint64_t)largest;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			float normalized = (c[i] * sign + kRange) / (2.0f * kRange);
+			normalized = std::min(std::max(normalized, 0.0f), 1.0f);
+			packed = (packed << 15) | (uint64_t)std::lround(normalized * 32767.0f);
+		}
+
+		out[0] = (uint16_t)(packed >> 32);
+		out[1] = (uint16_t)(packed >> 16);
+		out[2] = (uint16_t)(packed);
+	}
+
+	inline glm::quat UnpackQuat(const uint16_t in[3])
+	{
+		const float kRange = 0.70710678f;
+		uint64_t packed = ((uint64_t)in[0] << 32) | ((uint64_t)in[1] << 16) | (uint64_t)in[2];
+		int largest = (int)((packed >> 45) & 0x3);
+
+		float c[4];
+		float sumSquares = 0.0f;
+		int shift = 30;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			float normalized = ((packed >> shift) & 0x7FFF) / 32767.0f;
+			c[i] = normalized * 2.0f * kRange - kRange;
+			sumSquares += c[i] * c[i];
+			shift -= 15;
+		}
+		c[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSquares));
+
+		return glm::normalize(glm::quat(c[3], c[0], c[1], c[2]));
+	}
+
+	// Rotation angle between two unit quaternions. Uses the chord length instead of
+	// acos(dot) so tiny differences don't drown in float rounding.
+	inline float AngleBetween(const glm::quat& a, const glm::quat& b)
+	{
+		float chord = std::min(glm::length(a - b), glm::length(a + b));
+		return 4.0f * std::asin(std::min(1.0f, chord * 0.5f));
+	}
+}
+
+// Key times shared by both track kinds, quantized to 16 bits over the track's span.
+class CompressedKeyTimes
+{
+public:
+	void Build(const std::vector<float>& times, const std::vector<bool>& keep)
+	{
+		m_Start = times.empty() ? 0.0f : times.front();
+		float end = times.empty() ? 0.0f : times.back();
+		m_Span = end - m_Start;
+
+		m_Times.clear();
+		for (size_t i = 0; i < times.size(); ++i)
+			if (keep[i])
+				m_Times.push_back(AnimCompression::QuantizeUnit(m_Span > 0.0f ? (times[i] - m_Start) / m_Span : 0.0f));
+	}
+
+	int Count() const { return (int)m_Times.size(); }
+
+	float TimeAt(int index) const
+	{
+		return m_Start + AnimCompression::DequantizeUnit(m_Times[index]) * m_Span;
+	}
+
+	// Index of the key starting the segment that contains animationTime,
+	// clamped to the first/last segment outside the track.
+	int FindSegment(float animationTime) const
+	{
+		float normalized = m_Span > 0.0f ? (animationTime - m_Start) / m_Span : 0.0f;
+		uint16_t key = AnimCompression::QuantizeUnit(normalized);
+		auto it = std::upper_bound(m_Times.begin(), m_Times.end(), key);
+		int index = (int)(it - m_Times.begin()) - 1;
+		return std::min(std::max(index, 0), Count() - 2);
+	}
+
+	float SegmentFactor(int index, float animationTime) const
+	{
+		float t0 = TimeAt(index);
+		float t1 = TimeAt(index + 1);
+		if (t1 <= t0)
+			return 0.0f;
+		return std::min(std::max((animationTime - t0) / (t1 - t0), 0.0f), 1.0f);
+	}
+
+	size_t GetMemoryFootprint() const
+	{
+		return sizeof(*this) + m_Times.capacity() * sizeof(uint16_t);
+	}
+
+private:
+	std::vector<uint16_t> m_Times;
+	float m_Start = 0.0f;
+	float m_Span = 0.0f;
+};
+
+// Translation or scale track: reduced keys quantized against the track's own bounding range.
+class CompressedVec3Track
+{
+public:
+	void Build(const std::vector<float>& times, const std::vector<glm::vec3>& values, float tolerance)
+	{
+		auto lerp = [](const glm::vec3& a, const glm::vec3& b, float f) { return glm::mix(a, b, f); };
+		auto error = [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); };
+		std::vector<bool> keep = AnimCompression::ReduceKeys(times, values, tolerance, lerp, error);
+
+		m_Min = glm::vec3(0.0f);
+		m_Extent = glm::vec3(0.0f);
+		if (!values.empty())
+		{
+			glm::vec3 minValue = values[0], maxValue = values[0];
+			for (const glm::vec3& v : values)
+			{
+				minValue = glm::min(minValue, v);
+				maxValue = glm::max(maxValue, v);
+			}
+			m_Min = minValue;
+			m_Extent = maxValue - minValue;
+		}
+
+		m_Times.Build(times, keep);
+		m_Values.clear();
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			if (!keep[i])
+				continue;
+			for (int c = 0; c < 3; ++c)
+				m_Values.push_back(AnimCompression::QuantizeUnit(m_Extent[c] > 0.0f ? (values[i][c] - m_Min[c]) / m_Extent[c] : 0.0f));
+		}
+	}
+
+	int GetKeyCount() const { return m_Times.Count(); }
+	int FindSegment(float animationTime) const { return m_Times.FindSegment(animationTime); }
+
+	glm::vec3 GetKey(int index) const
+	{
+		const uint16_t* q = &m_Values[index * 3];
+		return m_Min + glm::vec3(AnimCompression::DequantizeUnit(q[0]),
+			AnimCompression::DequantizeUnit(q[1]),
+			AnimCompression::DequantizeUnit(q[2])) * m_Extent;
+	}
+
+	glm::vec3 Sample(float animationTime) const
+	{
+		if (GetKeyCount() == 1)
+			return GetKey(0);
+
+		int p0Index = m_Times.FindSegment(animationTime);
+		float factor = m_Times.SegmentFactor(p0Index, animationTime);
+		return glm::mix(GetKey(p0Index), GetKey(p0Index + 1), factor);
+	}
+
+	size_t GetMemoryFootprint() const
+	{
+		return m_Times.GetMemoryFootprint() + sizeof(m_Min) + sizeof(m_Extent)
+			+ m_Values.capacity() * sizeof(uint16_t);
+	}
+
+private:
+	CompressedKeyTimes m_Times;
+	std::vector<uint16_t> m_Values;
+	glm::vec3 m_Min;
+	glm::vec3 m_Extent;
+};
+
+// Rotation track: reduced keys stored as 48-bit smallest-three quaternions.
+class CompressedQuatTrack
+{
+public:
+	void Build(const std::vector<float>& times, std::vector<glm::quat> values, float tolerance)
+	{
+		// keep neighbouring keys on the same hemisphere so the reduction measures the short arc
+		for (size_t i = 1; i < values.size(); ++i)
+			if (glm::dot(values[i - 1], values[i]) < 0.0f)
+				values[i] = -values[i];
+
+		auto lerp = [](const glm::quat& a, const glm::quat& b, float f) { return glm::slerp(a, b, f); };
+		auto error = [](const glm::quat& a, const glm::quat& b) { return AnimCompression::AngleBetween(a, b); };
+		std::vector<bool> keep = AnimCompression::ReduceKeys(times, values, tolerance, lerp, error);
+
+		m_Times.Build(times, keep);
+		m_Values.clear();
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			if (!keep[i])
+				continue;
+			uint16_t packed[3];
+			AnimCompression::PackQuat(glm::normalize(values[i]), packed);
+			m_Values.insert(m_Values.end(), packed, packed + 3);
+		}
+	}
+
+	int GetKeyCount() const { return m_Times.Count(); }
+	int FindSegment(float animationTime) const { return m_Times.FindSegment(animationTime); }
+
+	glm::quat GetKey(int index) const
+	{
+		return AnimCompression::UnpackQuat(&m_Values[index * 3]);
+	}
+
+	glm::quat Sample(float animationTime) const
+	{
+		if (GetKeyCount() == 1)
+			return GetKey(0);
+
+		int p0Index = m_Times.FindSegment(animationTime);
+		float factor = m_Times.SegmentFactor(p0Index, animationTime);
+		return glm::normalize(glm::slerp(GetKey(p0Index), GetKey(p0Index + 1), factor));
+	}
+
+	size_t GetMemoryFootprint() const
+	{
+		return m_Times.GetMemoryFootprint() + m_Values.capacity() * sizeof(uint16_t);
+	}
+
+private:
+	CompressedKeyTimes m_Times;
+	std::vector<uint16_t> m_Values;
+};
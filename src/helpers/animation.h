@@ -22,7 +22,8 @@ class Animation
 public:
 	Animation() = default;
 
-	Animation(const std::string& animationPath, Model* model)
+	Animation(const std::string& animationPath, Model* model,
+		const AnimCompressionSettings& settings = AnimCompressionSettings())
 	{
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
@@ -33,7 +34,7 @@ public:
 		aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
 		globalTransformation = globalTransformation.Inverse();
 		ReadHierarchyData(m_RootNode, scene->mRootNode);
-		ReadMissingBones(animation, *model);
+		ReadMissingBones(animation, *model, settings);
 	}
 
 	~Animation()
@@ -61,8 +62,26 @@ public:
 		return m_BoneInfoMap;
 	}
 
+	// keyframe memory of the clip before and after compression, in bytes
+	size_t GetRawFootprint() const
+	{
+		size_t total = 0;
+		for (const Bone& bone : m_Bones)
+			total += bone.GetRawFootprint();
+		return total;
+	}
+
+	size_t GetCompressedFootprint() const
+	{
+		size_t total = 0;
+		for (const Bone& bone : m_Bones)
+			total += bone.GetCompressedFootprint();
+		return total;
+	}
+
 private:
-	void ReadMissingBones(const aiAnimation* animation, Model& model)
+	void ReadMissingBones(const aiAnimation* animation, Model& model,
+		const AnimCompressionSettings& settings)
 	{
 		int size = animation->mNumChannels;
 
@@ -81,7 +100,7 @@ private:
 				boneCount++;
 			}
 			m_Bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMap[channel->mNodeName.data].id, channel));
+				boneInfoMap[channel->mNodeName.data].id, channel, settings));
 		}
 
 		m_BoneInfoMap = boneInfoMap;
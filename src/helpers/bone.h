@@ -9,6 +9,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 #include "assimp_glm_helpers.h"
+#include "anim_compression.h"
 
 struct KeyPosition
 {
@@ -31,45 +32,50 @@ struct KeyScale
 class Bone
 {
 public:
-	Bone(const std::string& name, int ID, const aiNodeAnim* channel)
+	Bone(const std::string& name, int ID, const aiNodeAnim* channel,
+		const AnimCompressionSettings& settings = AnimCompressionSettings())
 		:
 		m_Name(name),
 		m_ID(ID),
 		m_LocalTransform(1.0f)
 	{
-		m_NumPositions = channel->mNumPositionKeys;
-
-		for (int positionIndex = 0; positionIndex < m_NumPositions; ++positionIndex)
+		// raw keys only live long enough to feed the compressor
+		std::vector<float> times;
+		std::vector<glm::vec3> positions;
+		for (unsigned int positionIndex = 0; positionIndex < channel->mNumPositionKeys; ++positionIndex)
 		{
 			aiVector3D aiPosition = channel->mPositionKeys[positionIndex].mValue;
-			float timeStamp = channel->mPositionKeys[positionIndex].mTime;
-			KeyPosition data;
-			data.position = AssimpGLMHelpers::GetGLMVec(aiPosition);
-			data.timeStamp = timeStamp;
-			m_Positions.push_back(data);
+			times.push_back((float)channel->mPositionKeys[positionIndex].mTime);
+			positions.push_back(AssimpGLMHelpers::GetGLMVec(aiPosition));
 		}
+		m_Positions.Build(times, positions, settings.positionError);
+		m_RawFootprint += positions.size() * sizeof(KeyPosition);
 
-		m_NumRotations = channel->mNumRotationKeys;
-		for (int rotationIndex = 0; rotationIndex < m_NumRotations; ++rotationIndex)
+		times.clear();
+		std::vector<glm::quat> rotations;
+		for (unsigned int rotationIndex = 0; rotationIndex < channel->mNumRotationKeys; ++rotationIndex)
 		{
 			aiQuaternion aiOrientation = channel->mRotationKeys[rotationIndex].mValue;
-			float timeStamp = channel->mRotationKeys[rotationIndex].mTime;
-			KeyRotation data;
-			data.orientation = AssimpGLMHelpers::GetGLMQuat(aiOrientation);
-			data.timeStamp = timeStamp;
-			m_Rotations.push_back(data);
+			times.push_back((float)channel->mRotationKeys[rotationIndex].mTime);
+			rotations.push_back(AssimpGLMHelpers::GetGLMQuat(aiOrientation));
 		}
+		m_Rotations.Build(times, rotations, settings.rotationError);
+		m_RawFootprint += rotations.size() * sizeof(KeyRotation);
 
-		m_NumScalings = channel->mNumScalingKeys;
-		for (int keyIndex = 0; keyIndex < m_NumScalings; ++keyIndex)
+		times.clear();
+		std::vector<glm::vec3> scales;
+		for (unsigned int keyIndex = 0; keyIndex < channel->mNumScalingKeys; ++keyIndex)
 		{
 			aiVector3D scale = channel->mScalingKeys[keyIndex].mValue;
-			float timeStamp = channel->mScalingKeys[keyIndex].mTime;
-			KeyScale data;
-			data.scale = AssimpGLMHelpers::GetGLMVec(scale);
-			data.timeStamp = timeStamp;
-			m_Scales.push_back(data);
+			times.push_back((float)channel->mScalingKeys[keyIndex].mTime);
+			scales.push_back(AssimpGLMHelpers::GetGLMVec(scale));
 		}
+		m_Scales.Build(times, scales, settings.scaleError);
+		m_RawFootprint += scales.size() * sizeof(KeyScale);
+
+		m_NumPositions = m_Positions.GetKeyCount();
+		m_NumRotations = m_Rotations.GetKeyCount();
+		m_NumScalings = m_Scales.GetKeyCount();
 	}
 	
 	void Update(float animationTime)
@@ -82,107 +88,61 @@ public:
 	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
 	std::string GetBoneName() const { return m_Name; }
 	int GetBoneID() { return m_ID; }
-	
+
+	/*bytes the keys would take as uncompressed Assimp-style keyframes*/
+	size_t GetRawFootprint() const { return m_RawFootprint; }
+
+	/*bytes the compressed tracks actually take*/
+	size_t GetCompressedFootprint() const
+	{
+		return m_Positions.GetMemoryFootprint() + m_Rotations.GetMemoryFootprint()
+			+ m_Scales.GetMemoryFootprint();
+	}
 
 
 	int GetPositionIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumPositions - 1; ++index)
-		{
-			if (animationTime < m_Positions[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return m_Positions.FindSegment(animationTime);
 	}
 
 	int GetRotationIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumRotations - 1; ++index)
-		{
-			if (animationTime < m_Rotations[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return m_Rotations.FindSegment(animationTime);
 	}
 
 	int GetScaleIndex(float animationTime)
 	{
-		for (int index = 0; index < m_NumScalings - 1; ++index)
-		{
-			if (animationTime < m_Scales[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return m_Scales.FindSegment(animationTime);
 	}
 
 
 private:
 
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
-	{
-		float scaleFactor = 0.0f;
-		float midWayLength = animationTime - lastTimeStamp;
-		float framesDiff = nextTimeStamp - lastTimeStamp;
-		scaleFactor = midWayLength / framesDiff;
-		return scaleFactor;
-	}
-
+	// the samplers decompress only the two keys around animationTime
 	glm::mat4 InterpolatePosition(float animationTime)
 	{
-		if (1 == m_NumPositions)
-			return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
-
-		int p0Index = GetPositionIndex(animationTime);
-		int p1Index = p0Index + 1;
-		float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
-			m_Positions[p1Index].timeStamp, animationTime);
-		glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position
-			, scaleFactor);
-		return glm::translate(glm::mat4(1.0f), finalPosition);
+		return glm::translate(glm::mat4(1.0f), m_Positions.Sample(animationTime));
 	}
 
 	glm::mat4 InterpolateRotation(float animationTime)
 	{
-		if (1 == m_NumRotations)
-		{
-			auto rotation = glm::normalize(m_Rotations[0].orientation);
-			return glm::toMat4(rotation);
-		}
-
-		int p0Index = GetRotationIndex(animationTime);
-		int p1Index = p0Index + 1;
-		float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
-			m_Rotations[p1Index].timeStamp, animationTime);
-		glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation
-			, scaleFactor);
-		finalRotation = glm::normalize(finalRotation);
-		return glm::toMat4(finalRotation);
-
+		return glm::toMat4(m_Rotations.Sample(animationTime));
 	}
 
 	glm::mat4 InterpolateScaling(float animationTime)
 	{
-		if (1 == m_NumScalings)
-			return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
-
-		int p0Index = GetScaleIndex(animationTime);
-		int p1Index = p0Index + 1;
-		float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
-			m_Scales[p1Index].timeStamp, animationTime);
-		glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale
-			, scaleFactor);
-		return glm::scale(glm::mat4(1.0f), finalScale);
+		return glm::scale(glm::mat4(1.0f), m_Scales.Sample(animationTime));
 	}
 
-	std::vector<KeyPosition> m_Positions;
-	std::vector<KeyRotation> m_Rotations;
-	std::vector<KeyScale> m_Scales;
+	CompressedVec3Track m_Positions;
+	CompressedQuatTrack m_Rotations;
+	CompressedVec3Track m_Scales;
 	int m_NumPositions;
 	int m_NumRotations;
 	int m_NumScalings;
+	size_t m_RawFootprint = 0;
 
 	glm::mat4 m_LocalTransform;
 	std::string m_Name;
 	int m_ID;
 };
-
@@ -0,0 +1,76 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Axis-aligned box plus bounding sphere, in whatever space the points were given in.
+// A default constructed Bounds is empty (radius < 0) and is never culled.
+struct Bounds
+{
+    glm::vec3 min    = glm::vec3( FLT_MAX);
+    glm::vec3 max    = glm::vec3(-FLT_MAX);
+    glm::vec3 center = glm::vec3(0.0f);
+    float     radius = -1.0f;
+
+    bool IsValid() const { return radius >= 0.0f; }
+
+    // box of the given points; the sphere is centred on the box and just reaches the farthest point
+    template <typename Iterator, typename PositionOf>
+    static Bounds FromPoints(Iterator first, Iterator last, PositionOf positionOf)
+    {
+        Bounds bounds;
+        for (Iterator it = first; it != last; ++it)
+        {
+            glm::vec3 p = positionOf(*it);
+            bounds.min = glm::min(bounds.min, p);
+            bounds.max = glm::max(bounds.max, p);
+        }
+        if (first == last)
+            return bounds;
+
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        float radiusSq = 0.0f;
+        for (Iterator it = first; it != last; ++it)
+        {
+            glm::vec3 d = positionOf(*it) - bounds.center;
+            radiusSq = std::max(radiusSq, glm::dot(d, d));
+        }
+        bounds.radius = std::sqrt(radiusSq);
+        return bounds;
+    }
+
+    static Bounds FromBox(const glm::vec3& min, const glm::vec3& max)
+    {
+        Bounds bounds;
+        bounds.min    = min;
+        bounds.max    = max;
+        bounds.center = (min + max) * 0.5f;
+        bounds.radius = glm::length(max - min) * 0.5f;
+        return bounds;
+    }
+
+    // union of two bounds; the sphere stays centred on the merged box and encloses both spheres
+    void Merge(const Bounds& other)
+    {
+        if (!other.IsValid())
+            return;
+        if (!IsValid())
+        {
+            *this = other;
+            return;
+        }
+
+        Bounds a = *this;
+        min    = glm::min(a.min, other.min);
+        max    = glm::max(a.max, other.max);
+        center = (min + max) * 0.5f;
+        radius = std::max(glm::length(a.center - center) + a.radius,
+                          glm::length(other.center - center) + other.radius);
+    }
+};
+
+#endif
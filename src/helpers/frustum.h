@@ -0,0 +1,38 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Six planes (xyz = inward normal, w = distance) extracted from a view-projection matrix.
+// A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+    enum { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+    glm::vec4 planes[PLANE_COUNT];
+
+    // Gribb/Hartmann plane extraction; works for any projection * view
+    static Frustum FromMatrix(const glm::mat4& viewProjection)
+    {
+        // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[PLANE_LEFT]   = row3 + row0;
+        frustum.planes[PLANE_RIGHT]  = row3 - row0;
+        frustum.planes[PLANE_BOTTOM] = row3 + row1;
+        frustum.planes[PLANE_TOP]    = row3 - row1;
+        frustum.planes[PLANE_NEAR]   = row3 + row2;
+        frustum.planes[PLANE_FAR]    = row3 - row2;
+
+        for (glm::vec4& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+};
+
+#endif
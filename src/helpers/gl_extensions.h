@@ -0,0 +1,22 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// whether the current context advertises extension (e.g. "GL_KHR_parallel_shader_compile");
+// glad only loads what it was generated with, so anything else is checked by name
+inline bool hasExtension(const char* extension)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PARALLEL_COMPILE_H
+#define PARALLEL_COMPILE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_extensions.h"
+
+// KHR_parallel_shader_compile (or its ARB twin), which the glad loader does not cover
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Lets the driver compile and link shaders on its own threads. glCompileShader and
+// glLinkProgram then return at once and GL_COMPLETION_STATUS_KHR says, without
+// blocking, whether a program is done; Shader uses that to keep going while its
+// programs build. Without the extension isComplete() always answers true, and the
+// first query on a program waits for it as before.
+class ParallelCompile
+{
+public:
+    // once, after glad is loaded; threads 0xFFFFFFFF lets the driver pick how many
+    static bool enable(unsigned int threads = 0xFFFFFFFFu)
+    {
+        typedef void (APIENTRYP MaxThreadsProc)(GLuint);
+        MaxThreadsProc maxThreads = nullptr;
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            maxThreads = (MaxThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            maxThreads = (MaxThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+        if (maxThreads)
+            maxThreads(threads);
+        enabled() = maxThreads != nullptr;
+        return enabled();
+    }
+    static bool isEnabled() { return enabled(); }
+
+    // whether the program's compile and link have finished; never blocks
+    static bool isComplete(GLuint program)
+    {
+        if (!enabled())
+            return true;
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+private:
+    static bool& enabled()
+    {
+        static bool on = false;
+        return on;
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// A binary is filed under a 64-bit FNV-1a hash of every stage's final source (defines
+// included) and the GL vendor, renderer and version strings, so editing a shader,
+// asking for another variant or updating the driver simply misses and compiles
+// again. A binary the driver refuses is ignored the same way. File names start with
+// a hash of the program's identity (its files and define set), and storing a binary
+// deletes the ones that identity had before, so stale binaries never pile up. Needs a
+// GL 4.1 context and at least one binary format; otherwise every program is compiled
+// from source as before.
+class ProgramCache
+{
+public:
+    struct Stats
+    {
+        unsigned int loaded;   // programs restored from a binary
+        unsigned int compiled; // programs compiled from source
+        double       ms;       // time spent submitting them and waiting for them to finish
+    };
+
+    // directory the binaries live in, created on first store; empty turns the cache off
+    static void setDirectory(const std::string& directory) { state().directory = directory; }
+    static bool isEnabled()
+    {
+        State& s = state();
+        if (s.supported < 0)
+        {
+            GLint formats = 0;
+            if (GLAD_GL_VERSION_4_1 && glGetProgramBinary && glProgramBinary)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            s.supported = formats > 0 ? 1 : 0;
+        }
+        return s.supported == 1 && !s.directory.empty();
+    }
+    static const Stats& stats() { return state().stats; }
+
+    // which program a binary belongs to, whatever its contents: e.g. its file names and defines
+    static uint64_t identity(const std::string& name)
+    {
+        uint64_t hash = FNV_OFFSET;
+        mix(hash, name);
+        return hash;
+    }
+
+    // hash of the stage sources and the driver that would build them
+    static uint64_t key(const std::string* sources, size_t count)
+    {
+        uint64_t hash = FNV_OFFSET;
+        const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : strings)
+        {
+            const char* value = (const char*)glGetString(name);
+            mix(hash, value ? value : "");
+        }
+        for (size_t i = 0; i < count; ++i)
+            mix(hash, sources[i]);
+        return hash;
+    }
+
+    // links program from the binary filed under key; false if there is none or the driver refused it
+    static bool load(GLuint program, uint64_t identity, uint64_t key)
+    {
+        std::ifstream file(path(identity, key), std::ios::binary);
+        if (!file)
+            return false;
+        Header header = {};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.magic != MAGIC || header.key != key || header.length == 0)
+            return false;
+        std::vector<char> binary(header.length);
+        file.read(binary.data(), binary.size());
+        if (!file)
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // set before glLinkProgram, so the driver keeps the binary around for store()
+    static void prepare(GLuint program)
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // files the linked program's binary under key, in place of any the same identity had;
+    // written aside and renamed, so a crash mid-write never leaves a truncated binary behind
+    static void store(GLuint program, uint64_t identity, uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        Header header = { MAGIC, 0, key, (uint32_t)length };
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(state().directory, error);
+        evict(identity);
+        std::string target = path(identity, key);
+        std::string temporary = target + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), binary.size());
+            if (!file)
+                return;
+        }
+        std::filesystem::rename(temporary, target, error);
+    }
+
+    // called by Shader once each program is complete
+    static void record(bool loaded, double ms)
+    {
+        Stats& stats = state().stats;
+        (loaded ? stats.loaded : stats.compiled)++;
+        stats.ms += ms;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x50524243; // "PRBC"
+    static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+
+    struct Header
+    {
+        uint32_t magic;
+        GLenum   format;
+        uint64_t key;
+        uint32_t length;
+    };
+
+    struct State
+    {
+        std::string directory;
+        int         supported = -1; // unknown until the first isEnabled() with a context
+        Stats       stats = {};
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // FNV-1a, then a separator so "ab" + "c" != "a" + "bc"
+    static void mix(uint64_t& hash, const std::string& text)
+    {
+        for (unsigned char c : text)
+            hash = (hash ^ c) * 1099511628211ull;
+        hash = (hash ^ 0xff) * 1099511628211ull;
+    }
+
+    static std::string prefix(uint64_t identity)
+    {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx-", (unsigned long long)identity);
+        return name;
+    }
+
+    static std::string path(uint64_t identity, uint64_t key)
+    {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return state().directory + "/" + prefix(identity) + name;
+    }
+
+    // deletes every binary filed for identity: they were built from other sources or drivers
+    static void evict(uint64_t identity)
+    {
+        std::error_code error;
+        std::string start = prefix(identity);
+        std::vector<std::filesystem::path> stale;
+        for (std::filesystem::directory_iterator it(state().directory, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->path().filename().string().compare(0, start.size(), start) == 0)
+                stale.push_back(it->path());
+        }
+        for (const std::filesystem::path& file : stale)
+            std::filesystem::remove(file, error);
+    }
+};
+
+#endif
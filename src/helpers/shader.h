@@ -5,22 +5,111 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <chrono>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include "parallel_compile.h"
+#include "program_cache.h"
+
+// Compile-time features of a shader variant: each name -> value becomes "#define name value"
+// right after the #version line. Ordered, so equal sets always make the same cache key.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// typed glUniform* dispatch used by the uniform handles below
+// ------------------------------------------------------------------------
+inline void setUniformValue(int location, bool value)             { glUniform1i(location, (int)value); }
+inline void setUniformValue(int location, int value)              { glUniform1i(location, value); }
+inline void setUniformValue(int location, unsigned int value)     { glUniform1ui(location, value); }
+inline void setUniformValue(int location, float value)            { glUniform1f(location, value); }
+inline void setUniformValue(int location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void setUniformValue(int location, const glm::mat3 &mat)   { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void setUniformValue(int location, const glm::mat4 &mat)   { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
+inline void setUniformValues(int location, const int *values, int count)       { glUniform1iv(location, count, values); }
+inline void setUniformValues(int location, const float *values, int count)     { glUniform1fv(location, count, values); }
+inline void setUniformValues(int location, const glm::vec3 *values, int count) { glUniform3fv(location, count, &values[0][0]); }
+inline void setUniformValues(int location, const glm::vec4 *values, int count) { glUniform4fv(location, count, &values[0][0]); }
+inline void setUniformValues(int location, const glm::mat4 *values, int count) { glUniformMatrix4fv(location, count, GL_FALSE, &values[0][0][0]); }
+
+// pre-resolved uniform location; fetch once from Shader::getUniform and reuse every frame.
+// like the set* functions, Set() writes to whichever program is currently in use.
+// ------------------------------------------------------------------------
+template <typename T>
+class Uniform
+{
+public:
+    Uniform() = default;
+    explicit Uniform(int location) : location(location) {}
+
+    void Set(const T &value) const
+    {
+        if (location >= 0)
+            setUniformValue(location, value);
+    }
+    bool IsValid() const { return location >= 0; }
+    int Location() const { return location; }
+
+private:
+    int location = -1;
+};
+
+// handles for every element of a uniform array ("name[i]") or of one member of a
+// struct array ("name[i].member"), resolved at fetch time so indexing builds no strings.
+// ------------------------------------------------------------------------
+template <typename T>
+class UniformArray
+{
+public:
+    UniformArray() = default;
+    UniformArray(std::vector<int> locations, bool contiguous)
+        : locations(std::move(locations)), contiguous(contiguous) {}
+
+    Uniform<T> operator[](size_t index) const
+    {
+        return index < locations.size() ? Uniform<T>(locations[index]) : Uniform<T>();
+    }
+    size_t Size() const { return locations.size(); }
+
+    // uploads values[0..count) starting at element 0; plain arrays go out in a single call
+    void Set(const T *values, size_t count) const
+    {
+        count = count < locations.size() ? count : locations.size();
+        if (count == 0)
+            return;
+        if (contiguous && locations[0] >= 0)
+        {
+            setUniformValues(locations[0], values, (int)count);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+            (*this)[i].Set(values[i]);
+    }
+
+private:
+    std::vector<int> locations;
+    bool contiguous = false;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly; defines are injected as for variant()
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const ShaderDefines& defines = ShaderDefines())
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -57,114 +146,375 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        hasGeometry = geometryPath != nullptr;
+        sourceName = std::string(vertexPath) + "|" + fragmentPath + "|" + (geometryPath ? geometryPath : "");
+        // 2. start the compile and link; complete() waits for them and reflects the uniforms
+        build(defines);
+    }
+    // whether the compile and link have finished, asked without waiting for them
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        return !pending || ParallelCompile::isComplete(ID);
+    }
+    // waits for the program if it is still building, reports compile/link errors and
+    // reflects the uniforms. Every lookup and use() does this first, so calling it is
+    // only needed to choose when the wait happens.
+    // ------------------------------------------------------------------------
+    void complete() const
+    {
+        if (!pending)
+            return;
+        pending = false;
+        auto start = std::chrono::steady_clock::now();
+        static const char* stageNames[3] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+        for (int i = 0; i < 3; ++i)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            if (stages[i] == 0)
+                continue;
+            checkCompileErrors(stages[i], stageNames[i]);
+            // linked into our program now and no longer necessary
+            glDeleteShader(stages[i]);
+            stages[i] = 0;
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        if (!fromCache)
+        {
+            checkCompileErrors(ID, "PROGRAM");
+            GLint status = GL_FALSE;
+            glGetProgramiv(ID, GL_LINK_STATUS, &status);
+            linked = status == GL_TRUE;
+            if (storeBinary && linked)
+                ProgramCache::store(ID, cacheIdentity, cacheKey);
+        }
+        // reflect the active uniforms once so lookups never hit the driver again
+        reflectUniforms();
+        buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ProgramCache::record(fromCache, buildMs);
+    }
+    // the program built from the same sources with these defines; compiled the first
+    // time a define set is asked for, then cached. Every setup (addSetup) has run on it.
+    // A variant that failed to compile or link is never returned: this program stands in.
+    // ------------------------------------------------------------------------
+    Shader& variant(const ShaderDefines& defines)
+    {
+        Shader& entry = submitVariant(defines);
+        completeVariant(entry);
+        return entry.linked ? entry : *this;
+    }
+    // as variant(), but never waits: while that variant is still building in the driver
+    // (or if it failed) this program stands in for it, so the frame draws the default permutation
+    // ------------------------------------------------------------------------
+    Shader& variantIfReady(const ShaderDefines& defines)
+    {
+        Shader& entry = submitVariant(defines);
+        if (!entry.isReady())
+            return *this;
+        completeVariant(entry);
+        return entry.linked ? entry : *this;
+    }
+    // starts building a variant ahead of its first use
+    // ------------------------------------------------------------------------
+    void precompile(const ShaderDefines& defines)
+    {
+        submitVariant(defines);
+    }
+    // runs setup on this program and every variant, now and when later ones are compiled:
+    // sampler units, block bindings, anything set once per program
+    // ------------------------------------------------------------------------
+    void addSetup(const std::function<void(Shader&)>& setup)
+    {
+        setup(*this);
+        for (auto& entry : variants)
+        {
+            // still building ones get every setup when completeVariant() takes them
+            if (!entry.second->setupsPending)
+                setup(*entry.second);
+        }
+        setups.push_back(setup);
     }
+    size_t variantCount() const { return variants.size(); }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+        complete();
         glUseProgram(ID); 
     }
+    // uniform lookup through the table filled at link time (-1 if not active)
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string &name) const
+    {
+        complete();
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> getUniform(const std::string &name) const
+    {
+        return Uniform<T>(getUniformLocation(name));
+    }
+    // "name" alone resolves name[0..N); with a member it resolves name[0..N).member
+    // ------------------------------------------------------------------------
+    template <typename T>
+    UniformArray<T> getUniformArray(const std::string &name, const std::string &member = "") const
+    {
+        complete();
+        std::vector<int> locations;
+        for (int i = 0; ; ++i)
+        {
+            std::string element = name + "[" + std::to_string(i) + "]";
+            if (!member.empty())
+                element += "." + member;
+            auto it = uniformLocations.find(element);
+            if (it == uniformLocations.end())
+                break;
+            locations.push_back(it->second);
+        }
+        return UniformArray<T>(std::move(locations), member.empty());
+    }
+    // connects a uniform block (if the program uses it) to a shared binding point
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &blockName, unsigned int bindingPoint) const
+    {
+        complete();
+        GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, bindingPoint);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getUniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getUniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getUniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getUniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // name -> location for every active uniform, including each array element
+    mutable std::unordered_map<std::string, int> uniformLocations;
+
+    // a build in flight: its stage objects, and what complete() still has to do
+    mutable bool pending = false;
+    mutable unsigned int stages[3] = { 0, 0, 0 };
+    mutable double buildMs = 0.0;
+    mutable bool linked = true; // false once complete() finds the link failed
+    bool fromCache = false;
+    bool storeBinary = false;
+    uint64_t cacheKey = 0;
+    uint64_t cacheIdentity = 0;
+    std::string sourceName; // the stage files, which with the defines identify a cached program
+    bool setupsPending = false; // variants: the addSetup functions wait for completeVariant()
+
+    // sources as read, so variants compile without touching the files again
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+    bool hasGeometry = false;
+    std::string variantKey; // definesKey() of the defines this program was built with
+    std::map<std::string, std::unique_ptr<Shader>> variants;
+    std::vector<std::function<void(Shader&)>> setups;
+
+    Shader() : ID(0) {}
+
+    static std::string definesKey(const ShaderDefines& defines)
+    {
+        std::string key;
+        for (const auto& define : defines)
+            key += define.first + "=" + define.second + ";";
+        return key;
+    }
+
+    // the defines go after #version, which must come first; #line keeps error lines matching the file
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string& source, const ShaderDefines& defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return source;
+        std::string lines;
+        for (const auto& define : defines)
+            lines += "#define " + define.first + " " + define.second + "\n";
+        size_t versionLine = 1 + std::count(source.begin(), source.begin() + lineEnd, '\n');
+        lines += "#line " + std::to_string(versionLine + 1) + "\n";
+        return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+    }
+
+    // the variant for these defines, its build started if this is the first time they are asked for
+    // ------------------------------------------------------------------------
+    Shader& submitVariant(const ShaderDefines& defines)
+    {
+        std::string key = definesKey(defines);
+        if (key == variantKey)
+            return *this;
+        std::unique_ptr<Shader>& entry = variants[key];
+        if (!entry)
+        {
+            entry.reset(new Shader());
+            entry->vertexCode   = vertexCode;
+            entry->fragmentCode = fragmentCode;
+            entry->geometryCode = geometryCode;
+            entry->hasGeometry  = hasGeometry;
+            entry->sourceName   = sourceName;
+            entry->setupsPending = true;
+            entry->build(defines);
+        }
+        return *entry;
+    }
+
+    void completeVariant(Shader& entry)
+    {
+        entry.complete();
+        if (!entry.setupsPending)
+            return;
+        entry.setupsPending = false;
+        for (const std::function<void(Shader&)>& setup : setups)
+            setup(entry);
+    }
+
+    // starts building the stored sources with the defines: restored from the program binary
+    // cache when it has them, otherwise compiled and linked, without waiting for either
+    // ------------------------------------------------------------------------
+    void build(const ShaderDefines& defines)
+    {
+        auto start = std::chrono::steady_clock::now();
+        variantKey = definesKey(defines);
+        std::string sources[3] = { injectDefines(vertexCode, defines),
+                                   injectDefines(fragmentCode, defines),
+                                   hasGeometry ? injectDefines(geometryCode, defines) : std::string() };
+        ID = glCreateProgram();
+        bool cached = ProgramCache::isEnabled();
+        cacheKey = cached ? ProgramCache::key(sources, 3) : 0;
+        cacheIdentity = cached ? ProgramCache::identity(sourceName + "|" + variantKey) : 0;
+        fromCache = cached && ProgramCache::load(ID, cacheIdentity, cacheKey);
+        storeBinary = cached && !fromCache;
+        if (!fromCache)
+        {
+            // a refused binary leaves the program unlinked, so start again from source
+            if (cached)
+            {
+                glDeleteProgram(ID);
+                ID = glCreateProgram();
+                ProgramCache::prepare(ID);
+            }
+            submit(sources);
+        }
+        pending = true;
+        buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // queues the compile of each stage and the link into ID; errors are read in complete()
+    // ------------------------------------------------------------------------
+    void submit(const std::string sources[3])
+    {
+        static const GLenum stageTypes[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+        for (int i = 0; i < 3; ++i)
+        {
+            if (i == 2 && !hasGeometry)
+                continue;
+            const char* code = sources[i].c_str();
+            stages[i] = glCreateShader(stageTypes[i]);
+            glShaderSource(stages[i], 1, &code, NULL);
+            glCompileShader(stages[i]);
+            glAttachShader(ID, stages[i]);
+        }
+        glLinkProgram(ID);
+    }
+
+    // fills uniformLocations from glGetActiveUniform right after linking
+    // ------------------------------------------------------------------------
+    void reflectUniforms() const
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            int location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue; // lives in a uniform block
+            uniformLocations[name] = location;
+
+            // arrays are reported once as "name[0]"; register the bare name and every element
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = location;
+                for (GLint element = 1; element < size; ++element)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
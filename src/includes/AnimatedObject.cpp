@@ -1,13 +1,9 @@
 #include "AnimatedObject.h"
 
-// Suppose we rely on these externs as you do for Object:
-extern int SCR_WIDTH;
-extern int SCR_HEIGHT;
-extern float far_plane;
-
 AnimatedObject::AnimatedObject(
     Shader&           shader,
     const std::string modelPath,
+    SceneNode&        parent,
     const glm::vec3&  position,
     const glm::vec3&  rotation,
     const glm::vec3&  scale
@@ -16,9 +12,7 @@ AnimatedObject::AnimatedObject(
     , m_Model(nullptr)
     , m_Animation(nullptr)
     , m_Animator(nullptr)
-    , m_Position(position)
-    , m_Rotation(rotation)
-    , m_Scale(scale)
+    , m_Node(parent.AddChild(position, rotation, scale))
 {
     // Load the bone-capable Model
     m_Model = new Model(modelPath);
@@ -27,6 +21,12 @@ AnimatedObject::AnimatedObject(
     // (You could pass a separate .dae for animation if desired.)
     m_Animation = new Animation(modelPath, m_Model);
     m_Animator  = new Animator(m_Animation);
+
+    m_ModelUniform = m_Shader.getUniform<glm::mat4>("model");
+    m_BoneMatrices = m_Shader.getUniformArray<glm::mat4>("finalBonesMatrices");
+
+    std::cout << "Animation keyframes: " << m_Animation->GetRawFootprint() / 1024 << " KB raw -> "
+              << m_Animation->GetCompressedFootprint() / 1024 << " KB compressed" << std::endl;
 }
 
 AnimatedObject::~AnimatedObject()
@@ -39,17 +39,17 @@ AnimatedObject::~AnimatedObject()
 
 void AnimatedObject::SetPosition(const glm::vec3& pos)
 {
-    m_Position = pos;
+    m_Node->SetPosition(pos);
 }
 
 void AnimatedObject::SetRotation(const glm::vec3& rot)
 {
-    m_Rotation = rot;
+    m_Node->SetRotation(rot);
 }
 
 void AnimatedObject::SetScale(const glm::vec3& scl)
 {
-    m_Scale = scl;
+    m_Node->SetScale(scl);
 }
 
 // Optionally call in your Scene::Update to step animation with deltaTime
@@ -59,53 +59,23 @@ void AnimatedObject::Update(float dt)
         m_Animator->UpdateAnimation(dt);
 }
 
-void AnimatedObject::Render(Camera& camera,
-                            const std::vector<glm::vec3>& lightPositions,
-                            const std::vector<glm::vec3>& lightColors)
+void AnimatedObject::Render()
 {
     // 1) Use the assigned shader
     m_Shader.use();
 
-    // 2) Camera projection & view (like your Object)
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-                                            (float)SCR_WIDTH / (float)SCR_HEIGHT,
-                                            0.1f, far_plane);
-    glm::mat4 view = camera.GetViewMatrix();
-    m_Shader.setMat4("projection", projection);
-    m_Shader.setMat4("view",       view);
-
-    // 3) Model matrix
-    glm::mat4 modelMat(1.0f);
-    modelMat = glm::translate(modelMat, m_Position);
-
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.x), glm::vec3(1,0,0));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.y), glm::vec3(0,1,0));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.z), glm::vec3(0,0,1));
-
-    modelMat = glm::scale(modelMat, m_Scale);
-    m_Shader.setMat4("model", modelMat);
+    // 2) Model matrix (camera & lights live in the shared uniform blocks)
+    const glm::mat4& modelMat = m_Node->GetWorldMatrix();
+    m_ModelUniform.Set(modelMat);
 
-    // 4) Update lighting uniforms (like your Object)
-    for (unsigned int i = 0; i < lightPositions.size(); i++)
-    {
-        m_Shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-        m_Shader.setVec3("lights[" + std::to_string(i) + "].Color",    lightColors[i]);
-    }
-    m_Shader.setVec3("viewPos", camera.Position);
-    m_Shader.setFloat("far_plane", far_plane);
-
-    // 5) Pass bone transforms from m_Animator
+    // 3) Pass bone transforms from m_Animator (one upload for the whole array)
     if (m_Animator)
     {
-        auto finalBones = m_Animator->GetFinalBoneMatrices();
-        for (int i = 0; i < (int)finalBones.size(); i++)
-        {
-            std::string uniformName = "finalBonesMatrices[" + std::to_string(i) + "]";
-            m_Shader.setMat4(uniformName.c_str(), finalBones[i]);
-        }
+        const auto& finalBones = m_Animator->GetFinalBoneMatrices();
+        m_BoneMatrices.Set(finalBones.data(), finalBones.size());
     }
 
-    // 6) Draw the model
+    // 4) Draw the model
     if (m_Model)
         m_Model->Draw(m_Shader);
 }
@@ -116,15 +86,8 @@ void AnimatedObject::RenderDepth(Shader& depthShader)
     // do the same approach, possibly with a skeletal depth shader:
     depthShader.use();
 
-    // Build model matrix
-    glm::mat4 modelMat(1.0f);
-    modelMat = glm::translate(modelMat, m_Position);
-
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.x), glm::vec3(1,0,0));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.y), glm::vec3(0,1,0));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.z), glm::vec3(0,0,1));
-
-    modelMat = glm::scale(modelMat, m_Scale);
+    // World matrix cached by the scene graph
+    const glm::mat4& modelMat = m_Node->GetWorldMatrix();
     depthShader.setMat4("model", modelMat);
 
     // If your depth shader also has finalBonesMatrices[], set them here similarly:
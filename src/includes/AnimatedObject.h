@@ -6,10 +6,11 @@
 #include <string>
 #include <vector>
 
-#include "../helpers/shader_m.h"
+#include "../helpers/shader.h"
 #include "../helpers/camera.h"
 #include "../helpers/model_animation.h"
 #include "../helpers/animator.h"
+#include "SceneGraph.h"
 
 /**
  * AnimatedObject: parallels your "Object" class,
@@ -21,6 +22,7 @@ public:
     AnimatedObject(
         Shader&           shader,
         const std::string modelPath,
+        SceneNode&        parent,
         const glm::vec3&  position  = glm::vec3(0.f),
         const glm::vec3&  rotation  = glm::vec3(0.f),
         const glm::vec3&  scale     = glm::vec3(1.f)
@@ -28,7 +30,7 @@ public:
 
     ~AnimatedObject();
 
-    // Transform setters, parallel to Object
+    // Transform setters (relative to the parent node), parallel to Object
     void SetPosition(const glm::vec3& pos);
     void SetRotation(const glm::vec3& rot);
     void SetScale   (const glm::vec3& scl);
@@ -36,23 +38,21 @@ public:
     // (Optional) We add Update so we can do m_Animator->UpdateAnimation(dt)
     void Update(float dt);
 
-    // Render the animated model with the given camera & lights
-    void Render(Camera& camera,
-                const std::vector<glm::vec3>& lightPositions,
-                const std::vector<glm::vec3>& lightColors);
+    // Render the animated model (camera & lights come from the per-frame uniform buffers)
+    void Render();
 
     // Render a depth-only pass if you want the animated model to cast shadows
     void RenderDepth(Shader& depthShader);
 
 private:
     Shader&       m_Shader;      // The render shader to use (like your Object uses m_Shader)
+    Uniform<glm::mat4>      m_ModelUniform;
+    UniformArray<glm::mat4> m_BoneMatrices;
     Model*        m_Model;       // The bone-capable model
     Animation*    m_Animation;   // The animation data
     Animator*     m_Animator;    // Updates bone transforms each frame
 
-    // Transforms
-    glm::vec3     m_Position;
-    glm::vec3     m_Rotation;
-    glm::vec3     m_Scale;
+    // Transforms, owned by the scene graph
+    SceneNode*    m_Node;
 };
 
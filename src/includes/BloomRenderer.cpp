@@ -1,40 +1,17 @@
 #include "BloomRenderer.h"
 #include "../helpers/shader.h"
+#include "Primitives.h"
 #include <vector>
 
 
 
 
 
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
+// renderQuad() covers the viewport with the shared fullscreen triangle
+// ---------------------------------------------------------------------
 void BloomRenderer::renderQuad()
 {
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    Primitives::Draw(PRIMITIVE_FULLSCREEN_TRIANGLE);
 }
 
 
@@ -70,6 +47,11 @@ bool BloomRenderer::Init(unsigned int windowWidth, unsigned int windowHeight)
     mUpsampleShader->setInt("srcTexture", 0);
     glUseProgram(0);
 
+    // Resolve per-frame uniforms once
+    mSrcResolution = mDownsampleShader->getUniform<glm::vec2>("srcResolution");
+    mMipLevel      = mDownsampleShader->getUniform<int>("mipLevel");
+    mFilterRadius  = mUpsampleShader->getUniform<float>("filterRadius");
+
     return true;
 }
 
@@ -84,9 +66,9 @@ void BloomRenderer::RenderDownsamples(unsigned int srcTexture)
     const std::vector<BloomMip>& mipChain = mFBO.MipChain();
 
     mDownsampleShader->use();
-    mDownsampleShader->setVec2("srcResolution", mSrcViewportSizeFloat);
+    mSrcResolution.Set(mSrcViewportSizeFloat);
     if (mKarisAverageOnDownsample) {
-        mDownsampleShader->setInt("mipLevel", 0);
+        mMipLevel.Set(0);
     }
 
     // Bind srcTexture as initial texture input
@@ -105,11 +87,11 @@ void BloomRenderer::RenderDownsamples(unsigned int srcTexture)
         renderQuad();
 
         // Update shader uniforms for next mip
-        mDownsampleShader->setVec2("srcResolution", mip.size);
+        mSrcResolution.Set(mip.size);
         glBindTexture(GL_TEXTURE_2D, mip.texture);
 
         // Disable Karis average for subsequent mips
-        if (i == 0) { mDownsampleShader->setInt("mipLevel", 1); }
+        if (i == 0) { mMipLevel.Set(1); }
     }
 
     glUseProgram(0);
@@ -120,7 +102,7 @@ void BloomRenderer::RenderUpsamples(float filterRadius)
     const std::vector<BloomMip>& mipChain = mFBO.MipChain();
 
     mUpsampleShader->use();
-    mUpsampleShader->setFloat("filterRadius", filterRadius);
+    mFilterRadius.Set(filterRadius);
 
     // Enable additive blending
     glEnable(GL_BLEND);
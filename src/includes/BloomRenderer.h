@@ -27,6 +27,9 @@ private:
 	glm::vec2 mSrcViewportSizeFloat;
 	Shader* mDownsampleShader;
 	Shader* mUpsampleShader;
+	Uniform<glm::vec2> mSrcResolution;
+	Uniform<int> mMipLevel;
+	Uniform<float> mFilterRadius;
 
 	bool mKarisAverageOnDownsample = true;
 };
\ No newline at end of file
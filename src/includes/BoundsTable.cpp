@@ -0,0 +1,206 @@
+#include "BoundsTable.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BOUNDS_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOUNDS_SIMD_WIDTH 4
+#else
+#define BOUNDS_SIMD_WIDTH 1
+#endif
+
+// Bounds that never cull (empty local bounds) get this half extent / radius.
+// Squared it still fits in a float, so the sphere test stays finite.
+static const float UNBOUNDED = 1e18f;
+
+void BoundsTable::Clear()
+{
+    mCenterX.clear(); mCenterY.clear(); mCenterZ.clear();
+    mExtentX.clear(); mExtentY.clear(); mExtentZ.clear();
+    mRadius.clear();
+}
+
+void BoundsTable::Reserve(size_t count)
+{
+    mCenterX.reserve(count); mCenterY.reserve(count); mCenterZ.reserve(count);
+    mExtentX.reserve(count); mExtentY.reserve(count); mExtentZ.reserve(count);
+    mRadius.reserve(count);
+}
+
+size_t BoundsTable::Add(const Bounds& local, const glm::mat4& transform)
+{
+    glm::vec3 center, extent;
+    float radius;
+    if (local.IsValid())
+    {
+        // Arvo: the world box of a transformed box has half extent |M| * e
+        glm::mat3 linear(transform);
+        glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        glm::vec3 localCenter = (local.min + local.max) * 0.5f;
+        glm::vec3 localExtent = (local.max - local.min) * 0.5f;
+
+        center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+        extent = absLinear * localExtent;
+
+        float maxScale = std::sqrt(std::max(glm::dot(linear[0], linear[0]),
+                                   std::max(glm::dot(linear[1], linear[1]), glm::dot(linear[2], linear[2]))));
+        // keep the sphere centred with the box so one centre serves both tests
+        radius = glm::length(glm::vec3(transform * glm::vec4(local.center, 1.0f)) - center) + local.radius * maxScale;
+    }
+    else
+    {
+        center = glm::vec3(transform[3]);
+        extent = glm::vec3(UNBOUNDED);
+        radius = UNBOUNDED;
+    }
+
+    mCenterX.push_back(center.x); mCenterY.push_back(center.y); mCenterZ.push_back(center.z);
+    mExtentX.push_back(extent.x); mExtentY.push_back(extent.y); mExtentZ.push_back(extent.z);
+    mRadius.push_back(radius);
+    return mCenterX.size() - 1;
+}
+
+Bounds BoundsTable::GetBounds(size_t i) const
+{
+    if (mRadius[i] >= UNBOUNDED)
+        return Bounds();
+    glm::vec3 center(mCenterX[i], mCenterY[i], mCenterZ[i]);
+    glm::vec3 extent(mExtentX[i], mExtentY[i], mExtentZ[i]);
+    return Bounds::FromBox(center - extent, center + extent);
+}
+
+bool BoundsTable::InFrustum(size_t i, const Frustum& frustum) const
+{
+    for (const glm::vec4& p : frustum.planes)
+    {
+        float d = p.x * mCenterX[i] + p.y * mCenterY[i] + p.z * mCenterZ[i] + p.w;
+        float r = std::fabs(p.x) * mExtentX[i] + std::fabs(p.y) * mExtentY[i] + std::fabs(p.z) * mExtentZ[i];
+        if (d + r < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void BoundsTable::CullFrustumScalar(const Frustum& frustum, size_t first, uint8_t* visible) const
+{
+    for (size_t i = first; i < Size(); ++i)
+        visible[i] = InFrustum(i, frustum) ? 1 : 0;
+}
+
+void BoundsTable::CullSphereScalar(const glm::vec3& center, float radius, size_t first, uint8_t* visible) const
+{
+    for (size_t i = first; i < Size(); ++i)
+    {
+        float dx = mCenterX[i] - center.x;
+        float dy = mCenterY[i] - center.y;
+        float dz = mCenterZ[i] - center.z;
+        float reach = mRadius[i] + radius;
+        visible[i] = (dx * dx + dy * dy + dz * dz <= reach * reach) ? 1 : 0;
+    }
+}
+
+size_t BoundsTable::CullFrustum(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+    const size_t count = Size();
+    visible.resize(count);
+    size_t i = 0;
+
+#if BOUNDS_SIMD_WIDTH == 8
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(&mCenterX[i]), cy = _mm256_loadu_ps(&mCenterY[i]), cz = _mm256_loadu_ps(&mCenterZ[i]);
+        __m256 ex = _mm256_loadu_ps(&mExtentX[i]), ey = _mm256_loadu_ps(&mExtentY[i]), ez = _mm256_loadu_ps(&mExtentZ[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& p : frustum.planes)
+        {
+            __m256 nx = _mm256_set1_ps(p.x), ny = _mm256_set1_ps(p.y), nz = _mm256_set1_ps(p.z);
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                                     _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(p.w)));
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+                                                   _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+                                     _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int k = 0; k < 8; ++k)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#elif BOUNDS_SIMD_WIDTH == 4
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&mCenterX[i]), cy = _mm_loadu_ps(&mCenterY[i]), cz = _mm_loadu_ps(&mCenterZ[i]);
+        __m128 ex = _mm_loadu_ps(&mExtentX[i]), ey = _mm_loadu_ps(&mExtentY[i]), ez = _mm_loadu_ps(&mExtentZ[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& p : frustum.planes)
+        {
+            __m128 nx = _mm_set1_ps(p.x), ny = _mm_set1_ps(p.y), nz = _mm_set1_ps(p.z);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                  _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(p.w)));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                                             _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                  _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; ++k)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#endif
+
+    CullFrustumScalar(frustum, i, visible.data());
+
+    size_t visibleCount = 0;
+    for (uint8_t v : visible)
+        visibleCount += v;
+    return visibleCount;
+}
+
+size_t BoundsTable::CullSphere(const glm::vec3& center, float radius, std::vector<uint8_t>& visible) const
+{
+    const size_t count = Size();
+    visible.resize(count);
+    size_t i = 0;
+
+#if BOUNDS_SIMD_WIDTH == 8
+    __m256 sx = _mm256_set1_ps(center.x), sy = _mm256_set1_ps(center.y), sz = _mm256_set1_ps(center.z);
+    __m256 sr = _mm256_set1_ps(radius);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&mCenterX[i]), sx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&mCenterY[i]), sy);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&mCenterZ[i]), sz);
+        __m256 reach = _mm256_add_ps(_mm256_loadu_ps(&mRadius[i]), sr);
+        __m256 distSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(distSq, _mm256_mul_ps(reach, reach), _CMP_LE_OQ));
+        for (int k = 0; k < 8; ++k)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#elif BOUNDS_SIMD_WIDTH == 4
+    __m128 sx = _mm_set1_ps(center.x), sy = _mm_set1_ps(center.y), sz = _mm_set1_ps(center.z);
+    __m128 sr = _mm_set1_ps(radius);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&mCenterX[i]), sx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&mCenterY[i]), sy);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&mCenterZ[i]), sz);
+        __m128 reach = _mm_add_ps(_mm_loadu_ps(&mRadius[i]), sr);
+        __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_mul_ps(reach, reach)));
+        for (int k = 0; k < 4; ++k)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#endif
+
+    CullSphereScalar(center, radius, i, visible.data());
+
+    size_t visibleCount = 0;
+    for (uint8_t v : visible)
+        visibleCount += v;
+    return visibleCount;
+}
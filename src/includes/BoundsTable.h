@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/bounds.h"
+#include "../helpers/frustum.h"
+
+/**
+ * World-space bounds stored as a structure of arrays (box centre/half extent
+ * and sphere radius per component), so the culling kernels can test 4 (SSE)
+ * or 8 (AVX) bounds per iteration. The AVX path is used when the compiler
+ * targets AVX (-mavx / /arch:AVX), SSE on any other x86 build, scalar elsewhere.
+ */
+class BoundsTable
+{
+public:
+    void Clear();
+    void Reserve(size_t count);
+
+    // Transforms local bounds by the model matrix and appends them; returns their index
+    size_t Add(const Bounds& local, const glm::mat4& transform);
+
+    size_t Size() const { return mCenterX.size(); }
+    // World box of entry i; empty (invalid) for entries added with empty local bounds
+    Bounds GetBounds(size_t i) const;
+
+    // Whether box i is inside or crosses the frustum
+    bool InFrustum(size_t i, const Frustum& frustum) const;
+    // visible[i] = 1 when box i is inside or crosses the frustum. Returns the visible count.
+    size_t CullFrustum(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+    // visible[i] = 1 when sphere i touches the given sphere. Returns the visible count.
+    size_t CullSphere(const glm::vec3& center, float radius, std::vector<uint8_t>& visible) const;
+
+private:
+    void CullFrustumScalar(const Frustum& frustum, size_t first, uint8_t* visible) const;
+    void CullSphereScalar(const glm::vec3& center, float radius, size_t first, uint8_t* visible) const;
+
+    std::vector<float> mCenterX, mCenterY, mCenterZ;
+    std::vector<float> mExtentX, mExtentY, mExtentZ;
+    std::vector<float> mRadius;
+};
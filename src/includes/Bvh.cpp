@@ -0,0 +1,302 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <future>
+#include <thread>
+
+// Subtrees smaller than this are not worth a thread
+static const uint32_t PARALLEL_MIN_PRIMITIVES = 4096;
+
+// Half the surface area of a box; only ever compared, so the factor 2 is dropped
+static float HalfArea(const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void Bvh::Clear()
+{
+    mNodes.clear();
+    mIndices.clear();
+    mBoxes.clear();
+    mNodeCount = 0;
+}
+
+void Bvh::Build(const std::vector<Bounds>& bounds, unsigned int threadCount)
+{
+    Clear();
+
+    BuildContext ctx;
+    ctx.bounds = &bounds;
+    ctx.centroids.resize(bounds.size());
+    for (uint32_t i = 0; i < bounds.size(); ++i)
+    {
+        if (!bounds[i].IsValid())
+            continue;
+        mIndices.push_back(i);
+        ctx.centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+    }
+    if (mIndices.empty())
+        return;
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    ctx.parallelDepth = 0;
+    while ((1u << ctx.parallelDepth) < threadCount)
+        ctx.parallelDepth++;
+
+    // a binary tree with n leaves or fewer never has more than 2n - 1 nodes
+    mNodes.resize(2 * mIndices.size() - 1);
+    ctx.nextNode = 1;
+    BuildNode(ctx, 0, 0, (uint32_t)mIndices.size(), 0);
+    mNodeCount = ctx.nextNode;
+
+    mBoxes.resize(mIndices.size());
+    for (size_t i = 0; i < mIndices.size(); ++i)
+        mBoxes[i] = { bounds[mIndices[i]].min, bounds[mIndices[i]].max };
+}
+
+void Bvh::BuildNode(BuildContext& ctx, uint32_t nodeIndex, uint32_t first, uint32_t count, unsigned int depth)
+{
+    const std::vector<Bounds>& bounds = *ctx.bounds;
+    Node& node = mNodes[nodeIndex];
+
+    glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    node.min = glm::vec3(FLT_MAX);
+    node.max = glm::vec3(-FLT_MAX);
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        const Bounds& b = bounds[mIndices[i]];
+        node.min = glm::min(node.min, b.min);
+        node.max = glm::max(node.max, b.max);
+        centroidMin = glm::min(centroidMin, ctx.centroids[mIndices[i]]);
+        centroidMax = glm::max(centroidMax, ctx.centroids[mIndices[i]]);
+    }
+
+    node.leftOrFirst = first;
+    node.count = count;
+    if (count <= MAX_LEAF_SIZE || depth + 1 >= MAX_DEPTH)
+        return;
+
+    glm::vec3 centroidExtent = centroidMax - centroidMin;
+    int axis = 0;
+    if (centroidExtent.y > centroidExtent[axis]) axis = 1;
+    if (centroidExtent.z > centroidExtent[axis]) axis = 2;
+
+    uint32_t leftCount = 0;
+    if (centroidExtent[axis] > 0.0f)
+    {
+        // Bin centroids along the axis, then sweep both ways for the cheapest plane
+        uint32_t  binCount[BIN_COUNT] = {};
+        glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+        std::fill(binMin, binMin + BIN_COUNT, glm::vec3(FLT_MAX));
+        std::fill(binMax, binMax + BIN_COUNT, glm::vec3(-FLT_MAX));
+
+        const float origin = centroidMin[axis];
+        const float scale  = BIN_COUNT / centroidExtent[axis];
+        auto binOf = [&](uint32_t primitive) {
+            int bin = (int)((ctx.centroids[primitive][axis] - origin) * scale);
+            return (uint32_t)std::min(bin, (int)BIN_COUNT - 1);
+        };
+
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            uint32_t bin = binOf(mIndices[i]);
+            binCount[bin]++;
+            binMin[bin] = glm::min(binMin[bin], bounds[mIndices[i]].min);
+            binMax[bin] = glm::max(binMax[bin], bounds[mIndices[i]].max);
+        }
+
+        // rightCost[i]: cost of bins i.. on the right side of plane i
+        float rightCost[BIN_COUNT];
+        glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+        uint32_t sweepCount = 0;
+        for (int i = BIN_COUNT - 1; i > 0; --i)
+        {
+            sweepCount += binCount[i];
+            sweepMin = glm::min(sweepMin, binMin[i]);
+            sweepMax = glm::max(sweepMax, binMax[i]);
+            rightCost[i] = sweepCount ? sweepCount * HalfArea(sweepMin, sweepMax) : 0.0f;
+        }
+
+        float    bestCost  = FLT_MAX;
+        uint32_t bestPlane = 0;
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for (uint32_t i = 1; i < BIN_COUNT; ++i)
+        {
+            sweepCount += binCount[i - 1];
+            sweepMin = glm::min(sweepMin, binMin[i - 1]);
+            sweepMax = glm::max(sweepMax, binMax[i - 1]);
+            if (sweepCount == 0 || sweepCount == count)
+                continue;
+            float cost = sweepCount * HalfArea(sweepMin, sweepMax) + rightCost[i];
+            if (cost < bestCost)
+            {
+                bestCost  = cost;
+                bestPlane = i;
+            }
+        }
+
+        // A small node that no plane improves on stays a leaf
+        float leafCost = count * HalfArea(node.min, node.max);
+        if (bestCost >= leafCost && count <= 4 * MAX_LEAF_SIZE)
+            return;
+
+        if (bestPlane != 0)
+        {
+            uint32_t* middle = std::partition(&mIndices[first], &mIndices[first] + count,
+                                              [&](uint32_t primitive) { return binOf(primitive) < bestPlane; });
+            leftCount = (uint32_t)(middle - &mIndices[first]);
+        }
+    }
+
+    // Centroids too close to bin apart: split at the median so the tree stays balanced
+    if (leftCount == 0 || leftCount == count)
+    {
+        leftCount = count / 2;
+        std::nth_element(&mIndices[first], &mIndices[first] + leftCount, &mIndices[first] + count,
+                         [&](uint32_t a, uint32_t b) { return ctx.centroids[a][axis] < ctx.centroids[b][axis]; });
+    }
+
+    const uint32_t children = ctx.nextNode.fetch_add(2);
+    node.leftOrFirst = children;
+    node.count = 0;
+
+    if (depth < ctx.parallelDepth && count >= PARALLEL_MIN_PRIMITIVES)
+    {
+        std::future<void> left = std::async(std::launch::async, [&, children, first, leftCount, depth] {
+            BuildNode(ctx, children, first, leftCount, depth + 1);
+        });
+        BuildNode(ctx, children + 1, first + leftCount, count - leftCount, depth + 1);
+        left.get();
+    }
+    else
+    {
+        BuildNode(ctx, children, first, leftCount, depth + 1);
+        BuildNode(ctx, children + 1, first + leftCount, count - leftCount, depth + 1);
+    }
+}
+
+void Bvh::Refit(const std::vector<Bounds>& bounds)
+{
+    for (size_t i = 0; i < mIndices.size(); ++i)
+        mBoxes[i] = { bounds[mIndices[i]].min, bounds[mIndices[i]].max };
+
+    // Children are always allocated after their parent, so a reverse sweep sees them first
+    for (uint32_t n = mNodeCount; n-- > 0;)
+    {
+        Node& node = mNodes[n];
+        if (node.count > 0)
+        {
+            node.min = glm::vec3(FLT_MAX);
+            node.max = glm::vec3(-FLT_MAX);
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+            {
+                node.min = glm::min(node.min, mBoxes[i].min);
+                node.max = glm::max(node.max, mBoxes[i].max);
+            }
+        }
+        else
+        {
+            const Node& left  = mNodes[node.leftOrFirst];
+            const Node& right = mNodes[node.leftOrFirst + 1];
+            node.min = glm::min(left.min, right.min);
+            node.max = glm::max(left.max, right.max);
+        }
+    }
+}
+
+template <typename Test, typename Visit>
+void Bvh::Traverse(Test test, Visit visit) const
+{
+    if (mNodeCount == 0)
+        return;
+
+    uint32_t stack[MAX_DEPTH];
+    unsigned int size = 0;
+    stack[size++] = 0;
+    while (size > 0)
+    {
+        const Node& node = mNodes[stack[--size]];
+        if (!test(node.min, node.max))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                if (test(mBoxes[i].min, mBoxes[i].max))
+                    visit(i);
+        }
+        else
+        {
+            stack[size++] = node.leftOrFirst + 1;
+            stack[size++] = node.leftOrFirst;
+        }
+    }
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const
+{
+    Traverse([&](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 center = (min + max) * 0.5f;
+        glm::vec3 extent = (max - min) * 0.5f;
+        for (const glm::vec4& p : frustum.planes)
+        {
+            glm::vec3 n(p);
+            if (glm::dot(n, center) + glm::dot(glm::abs(n), extent) + p.w < 0.0f)
+                return false;
+        }
+        return true;
+    }, [&](uint32_t slot) { out.push_back(mIndices[slot]); });
+}
+
+void Bvh::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const
+{
+    const float radiusSq = radius * radius;
+    Traverse([&](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 d = center - glm::clamp(center, min, max);
+        return glm::dot(d, d) <= radiusSq;
+    }, [&](uint32_t slot) { out.push_back(mIndices[slot]); });
+}
+
+void Bvh::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const
+{
+    Traverse([&](const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        return glm::all(glm::lessThanEqual(boxMin, max)) && glm::all(glm::lessThanEqual(min, boxMax));
+    }, [&](uint32_t slot) { out.push_back(mIndices[slot]); });
+}
+
+bool Bvh::Raycast(const Ray& ray, Hit& hit) const
+{
+    // IEEE division gives +-inf for axis-parallel rays, which the slab test handles
+    const glm::vec3 invDir = 1.0f / ray.direction;
+    float nearest = ray.tMax;
+    bool found = false;
+
+    // Entry distance of the ray into a box, or FLT_MAX if it misses (or enters past the nearest hit)
+    auto enter = [&](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 t0 = (min - ray.origin) * invDir;
+        glm::vec3 t1 = (max - ray.origin) * invDir;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit  = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, nearest));
+        return entry <= exit ? entry : FLT_MAX;
+    };
+
+    Traverse([&](const glm::vec3& min, const glm::vec3& max) {
+        return enter(min, max) != FLT_MAX;
+    }, [&](uint32_t slot) {
+        float t = enter(mBoxes[slot].min, mBoxes[slot].max);
+        if (t < nearest || !found)
+        {
+            nearest = t;
+            hit.primitive = mIndices[slot];
+            hit.t = t;
+            found = true;
+        }
+    });
+    return found;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/bounds.h"
+#include "../helpers/frustum.h"
+
+/**
+ * Bounding volume hierarchy over world-space boxes, for the queries that would
+ * otherwise scan every object: view and shadow culling, light assignment and
+ * ray picking.
+ *
+ * Build() splits with a binned surface area heuristic (16 bins on the longest
+ * centroid axis) and hands large subtrees to worker threads. When objects move
+ * but the set stays the same, Refit() recomputes the boxes bottom-up in one
+ * pass without touching the topology. Queries walk the tree with a fixed
+ * 64-entry stack; the build caps depth so the stack can never overflow.
+ *
+ * Primitives are referred to by their index in the array given to Build().
+ * Invalid (empty) bounds are left out of the tree and never reported.
+ */
+class Bvh
+{
+public:
+    static const unsigned int MAX_DEPTH     = 64;
+    static const unsigned int MAX_LEAF_SIZE = 4;
+    static const unsigned int BIN_COUNT     = 16;
+
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 direction; // need not be normalized; t is in units of direction
+        float     tMax;
+    };
+
+    struct Hit
+    {
+        uint32_t primitive;
+        float    t; // where the ray enters the primitive's box
+    };
+
+    // threadCount 0 uses every hardware thread
+    void Build(const std::vector<Bounds>& bounds, unsigned int threadCount = 0);
+    // Same primitives, new boxes: recomputes node bounds, keeps the topology
+    void Refit(const std::vector<Bounds>& bounds);
+    void Clear();
+
+    bool   Empty() const { return mNodeCount == 0; }
+    size_t NodeCount() const { return mNodeCount; }
+    size_t PrimitiveCount() const { return mIndices.size(); }
+
+    // Append the index of every primitive whose box passes the test to out
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+    void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const;
+    // Nearest primitive box along the ray; false if nothing is hit before tMax
+    bool Raycast(const Ray& ray, Hit& hit) const;
+
+private:
+    // 32 bytes. Leaves (count > 0) own mIndices[first, first + count);
+    // interior nodes have their two children at leftOrFirst and leftOrFirst + 1.
+    struct Node
+    {
+        glm::vec3 min;
+        uint32_t  leftOrFirst;
+        glm::vec3 max;
+        uint32_t  count;
+    };
+
+    struct BuildContext
+    {
+        const std::vector<Bounds>* bounds;
+        std::vector<glm::vec3>     centroids;
+        std::atomic<uint32_t>      nextNode;
+        unsigned int               parallelDepth; // subtrees above this depth may go to another thread
+    };
+
+    // Primitive boxes in leaf order, so leaf tests read memory sequentially
+    struct Box
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    void BuildNode(BuildContext& ctx, uint32_t nodeIndex, uint32_t first, uint32_t count, unsigned int depth);
+
+    // Calls visit(i) for every primitive slot whose box passes test(min, max)
+    template <typename Test, typename Visit>
+    void Traverse(Test test, Visit visit) const;
+
+    std::vector<Node>     mNodes;
+    std::vector<uint32_t> mIndices; // primitive index per slot
+    std::vector<Box>      mBoxes;   // primitive box per slot
+    uint32_t              mNodeCount = 0;
+};
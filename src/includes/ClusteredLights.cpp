@@ -0,0 +1,254 @@
+#include "ClusteredLights.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// Inverse-square contribution below which a light is treated as out of reach
+static const float LIGHT_CUTOFF = 0.01f;
+
+bool ClusteredLights::Init()
+{
+    auto createBuffer = [](unsigned int& buffer, unsigned int& texture, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    };
+
+    createBuffer(mLightsBuffer,  mLightsTexture,  GL_RGBA32F);
+    createBuffer(mRangesBuffer,  mRangesTexture,  GL_RG32UI);
+    createBuffer(mIndicesBuffer, mIndicesTexture, GL_R16UI);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    return mLightsTexture != 0;
+}
+
+void ClusteredLights::Destroy()
+{
+    unsigned int textures[] = { mLightsTexture, mRangesTexture, mIndicesTexture };
+    unsigned int buffers[]  = { mLightsBuffer, mRangesBuffer, mIndicesBuffer };
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+    mLightsTexture = mRangesTexture = mIndicesTexture = 0;
+    mLightsBuffer = mRangesBuffer = mIndicesBuffer = 0;
+}
+
+void ClusteredLights::Attach(Shader& shader) const
+{
+    shader.use();
+    shader.setInt("clusterLights",  LIGHTS_TEXTURE_UNIT);
+    shader.setInt("clusterRanges",  RANGES_TEXTURE_UNIT);
+    shader.setInt("clusterIndices", INDICES_TEXTURE_UNIT);
+}
+
+float ClusteredLights::LightRadius(const glm::vec3& color)
+{
+    // 1 / d^2 * intensity = cutoff
+    float intensity = std::max(color.r, std::max(color.g, color.b));
+    return std::sqrt(std::max(intensity, 0.0f) / LIGHT_CUTOFF);
+}
+
+int ClusteredLights::SliceOf(float viewDepth) const
+{
+    int slice = (int)std::floor(std::log(viewDepth) * mBlock.scale.z + mBlock.scale.w);
+    return std::min(std::max(slice, 0), (int)CLUSTERS_Z - 1);
+}
+
+void ClusteredLights::SetProjection(const glm::mat4& projection, float nearPlane, float farPlane,
+                                    unsigned int width, unsigned int height)
+{
+    if (projection == mProjection && width == mWidth && height == mHeight &&
+        nearPlane == mNear && farPlane == mFar)
+        return;
+    mProjection = projection;
+    mNear = nearPlane;
+    mFar = farPlane;
+    mWidth = width;
+    mHeight = height;
+
+    // slice k starts at near * (far / near)^(k / Z)
+    float logRatio = std::log(farPlane / nearPlane);
+    mBlock.grid  = glm::ivec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, mBlock.grid.w);
+    mBlock.scale = glm::vec4((float)CLUSTERS_X / width, (float)CLUSTERS_Y / height,
+                             CLUSTERS_Z / logRatio, -(float)CLUSTERS_Z * std::log(nearPlane) / logRatio);
+
+    // Tile corners on the near plane give the view rays; each froxel is the box of
+    // its four rays cut at the slice's two depths
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    auto rayThrough = [&](float ndcX, float ndcY)
+    {
+        glm::vec4 p = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+        glm::vec3 v = glm::vec3(p) / p.w;
+        return v / -v.z; // at view depth 1
+    };
+
+    mClusterBounds.resize(CLUSTER_COUNT);
+    for (unsigned int z = 0; z < CLUSTERS_Z; ++z)
+    {
+        float depth0 = nearPlane * std::exp(logRatio * z / CLUSTERS_Z);
+        float depth1 = nearPlane * std::exp(logRatio * (z + 1) / CLUSTERS_Z);
+        for (unsigned int y = 0; y < CLUSTERS_Y; ++y)
+        {
+            for (unsigned int x = 0; x < CLUSTERS_X; ++x)
+            {
+                float ndcX0 = -1.0f + 2.0f * x / CLUSTERS_X, ndcX1 = -1.0f + 2.0f * (x + 1) / CLUSTERS_X;
+                float ndcY0 = -1.0f + 2.0f * y / CLUSTERS_Y, ndcY1 = -1.0f + 2.0f * (y + 1) / CLUSTERS_Y;
+                glm::vec3 rays[4] = { rayThrough(ndcX0, ndcY0), rayThrough(ndcX1, ndcY0),
+                                      rayThrough(ndcX0, ndcY1), rayThrough(ndcX1, ndcY1) };
+                glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+                for (const glm::vec3& ray : rays)
+                {
+                    boxMin = glm::min(boxMin, glm::min(ray * depth0, ray * depth1));
+                    boxMax = glm::max(boxMax, glm::max(ray * depth0, ray * depth1));
+                }
+                mClusterBounds[x + y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y] = Bounds::FromBox(boxMin, boxMax);
+            }
+        }
+    }
+}
+
+void ClusteredLights::Bin(const glm::mat4& view, const std::vector<glm::vec3>& positions,
+                          const std::vector<glm::vec3>& colors)
+{
+    const size_t count = std::min<size_t>(std::min(positions.size(), colors.size()), MAX_CLUSTERED_LIGHTS);
+    mStats = {};
+    mStats.lights = (unsigned int)count;
+    mBlock.grid.w = (int)count;
+
+    mLights.resize(count * 2);
+    mScreenRects.assign(count, glm::ivec4(0));
+    mPairs.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+        float radius = LightRadius(colors[i]);
+        mLights[i * 2]     = glm::vec4(positions[i], radius);
+        mLights[i * 2 + 1] = glm::vec4(colors[i], 0.0f);
+
+        glm::vec3 center = glm::vec3(view * glm::vec4(positions[i], 1.0f));
+        float depth = -center.z;
+        if (depth + radius < mNear || depth - radius > mFar)
+            continue;
+        int z0 = SliceOf(std::max(depth - radius, mNear));
+        int z1 = SliceOf(std::min(depth + radius, mFar));
+
+        // Screen tiles covered by the projected box around the sphere. A sphere that
+        // reaches the near plane can cover any part of the screen, so test every tile.
+        int x0 = 0, x1 = CLUSTERS_X - 1, y0 = 0, y1 = CLUSTERS_Y - 1;
+        glm::ivec4 rect(0, 0, mWidth, mHeight);
+        if (depth - radius > mNear)
+        {
+            glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius,
+                                 (corner & 4) ? radius : -radius);
+                glm::vec4 clip = mProjection * glm::vec4(center + offset, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+                continue;
+            x0 = std::max(0, (int)std::floor((ndcMin.x * 0.5f + 0.5f) * CLUSTERS_X));
+            x1 = std::min((int)CLUSTERS_X - 1, (int)std::floor((ndcMax.x * 0.5f + 0.5f) * CLUSTERS_X));
+            y0 = std::max(0, (int)std::floor((ndcMin.y * 0.5f + 0.5f) * CLUSTERS_Y));
+            y1 = std::min((int)CLUSTERS_Y - 1, (int)std::floor((ndcMax.y * 0.5f + 0.5f) * CLUSTERS_Y));
+
+            glm::vec2 size((float)mWidth, (float)mHeight);
+            glm::vec2 windowMin = glm::clamp((ndcMin * 0.5f + 0.5f) * size, glm::vec2(0.0f), size);
+            glm::vec2 windowMax = glm::clamp((ndcMax * 0.5f + 0.5f) * size, glm::vec2(0.0f), size);
+            rect = glm::ivec4(glm::floor(windowMin), glm::ceil(windowMax));
+        }
+        mScreenRects[i] = rect;
+
+        size_t before = mPairs.size();
+        for (int z = z0; z <= z1; ++z)
+        {
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    uint32_t cluster = x + y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y;
+                    const Bounds& box = mClusterBounds[cluster];
+                    glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+                    if (glm::dot(d, d) <= radius * radius)
+                        mPairs.push_back((cluster << 16) | (uint32_t)i);
+                }
+            }
+        }
+        mStats.binnedLights += mPairs.size() > before ? 1 : 0;
+    }
+
+    // Counting sort by froxel; lights were visited in order, so each froxel's list
+    // stays in light order and the shadow-casting lights come first
+    mRanges.assign(CLUSTER_COUNT, glm::uvec2(0));
+    for (uint32_t pair : mPairs)
+        mRanges[pair >> 16].y++;
+    uint32_t offset = 0;
+    for (glm::uvec2& range : mRanges)
+    {
+        range.x = offset;
+        offset += range.y;
+        mStats.maxPerCluster = std::max(mStats.maxPerCluster, range.y);
+        mStats.occupiedClusters += range.y > 0 ? 1 : 0;
+        range.y = 0;
+    }
+    mIndices.resize(mPairs.size());
+    for (uint32_t pair : mPairs)
+    {
+        glm::uvec2& range = mRanges[pair >> 16];
+        mIndices[range.x + range.y++] = (uint16_t)(pair & 0xFFFF);
+    }
+    mStats.indices = (unsigned int)mIndices.size();
+}
+
+bool ClusteredLights::ClusterHasLight(unsigned int cluster, unsigned int light) const
+{
+    const glm::uvec2& range = mRanges[cluster];
+    return std::find(mIndices.begin() + range.x, mIndices.begin() + range.x + range.y, light)
+        != mIndices.begin() + range.x + range.y;
+}
+
+glm::ivec4 ClusteredLights::GetScreenRect(size_t count) const
+{
+    glm::ivec2 low(INT_MAX), high(INT_MIN);
+    for (size_t i = 0; i < std::min(count, mScreenRects.size()); ++i)
+    {
+        const glm::ivec4& rect = mScreenRects[i];
+        if (rect.z <= rect.x || rect.w <= rect.y)
+            continue;
+        low  = glm::min(low, glm::ivec2(rect.x, rect.y));
+        high = glm::max(high, glm::ivec2(rect.z, rect.w));
+    }
+    if (low.x > high.x)
+        return glm::ivec4(0);
+    return glm::ivec4(low, high - low);
+}
+
+void ClusteredLights::Upload()
+{
+    // orphan each buffer; empty lists still get a texel so the textures stay complete
+    auto upload = [](unsigned int buffer, const void* data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+        if (size)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    };
+    upload(mLightsBuffer,  mLights.data(),  mLights.size() * sizeof(glm::vec4));
+    upload(mRangesBuffer,  mRanges.data(),  mRanges.size() * sizeof(glm::uvec2));
+    upload(mIndicesBuffer, mIndices.data(), mIndices.size() * sizeof(uint16_t));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::Bind(GLStateCache& cache) const
+{
+    cache.BindTexture(LIGHTS_TEXTURE_UNIT,  GL_TEXTURE_BUFFER, mLightsTexture);
+    cache.BindTexture(RANGES_TEXTURE_UNIT,  GL_TEXTURE_BUFFER, mRangesTexture);
+    cache.BindTexture(INDICES_TEXTURE_UNIT, GL_TEXTURE_BUFFER, mIndicesTexture);
+}
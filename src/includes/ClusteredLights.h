@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/shader.h"
+#include "../helpers/bounds.h"
+#include "GLStateCache.h"
+#include "UniformBuffers.h"
+
+/**
+ * Clustered forward lighting. The view frustum is cut into a 16 x 9 x 24 grid
+ * of froxels: screen tiles, by depth slices spaced exponentially between the
+ * near and far planes so a froxel is about as deep as it is wide. Each frame
+ * every light's bounding sphere is binned on the CPU into the froxels it
+ * touches. The lights, the per-froxel ranges and the light index lists go up
+ * as texture buffers, and the lit shader loops over its own froxel's lights
+ * only, so per-pixel cost follows local light density, not the scene total.
+ *
+ * A light's sphere ends where its inverse-square falloff drops below
+ * LIGHT_CUTOFF (LightRadius()). The shaders window the falloff to reach zero
+ * there, and the same radius bounds the light's shadow range and casters.
+ * Binning also keeps each light's window rectangle, for scissoring passes
+ * that only matter where some lights reach.
+ */
+class ClusteredLights
+{
+public:
+    static const unsigned int CLUSTERS_X    = 16;
+    static const unsigned int CLUSTERS_Y    = 9;
+    static const unsigned int CLUSTERS_Z    = 24;
+    static const unsigned int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+    static const unsigned int MAX_CLUSTERED_LIGHTS = 4096;
+
+    // Above the shadow map units the lit shader uses, below the Hi-Z unit
+    static const unsigned int LIGHTS_TEXTURE_UNIT  = 12;
+    static const unsigned int RANGES_TEXTURE_UNIT  = 13;
+    static const unsigned int INDICES_TEXTURE_UNIT = 14;
+
+    struct Stats
+    {
+        unsigned int lights;           // handed to Bin()
+        unsigned int binnedLights;     // touching at least one froxel
+        unsigned int indices;          // froxel-light pairs
+        unsigned int maxPerCluster;
+        unsigned int occupiedClusters;
+    };
+
+    bool Init();
+    void Destroy();
+
+    // Points the program's cluster samplers at their units
+    void Attach(Shader& shader) const;
+
+    // Distance at which a light of this colour falls below LIGHT_CUTOFF
+    static float LightRadius(const glm::vec3& color);
+
+    // Rebuilds the view-space froxel boxes when the projection or viewport changed
+    void SetProjection(const glm::mat4& projection, float nearPlane, float farPlane,
+                       unsigned int width, unsigned int height);
+    // Bins the lights (world space) into froxels; CPU only
+    void Bin(const glm::mat4& view, const std::vector<glm::vec3>& positions,
+             const std::vector<glm::vec3>& colors);
+    // Sends the binned lists to the texture buffers
+    void Upload();
+    void Bind(GLStateCache& cache) const;
+
+    // Header for UniformBuffers::UpdateClusters
+    const ClusterBlock& GetBlock() const { return mBlock; }
+    const Stats& GetStats() const { return mStats; }
+
+    // View-space box of froxel (x + y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y)
+    const Bounds& GetClusterBounds(unsigned int cluster) const { return mClusterBounds[cluster]; }
+    bool ClusterHasLight(unsigned int cluster, unsigned int light) const;
+    // Window rectangle (x, y, width, height) around the spheres of the first count
+    // lights binned; zero size when none of them reaches the screen
+    glm::ivec4 GetScreenRect(size_t count) const;
+
+private:
+    int SliceOf(float viewDepth) const;
+
+    unsigned int mLightsBuffer  = 0, mLightsTexture  = 0; // RGBA32F: position + radius, colour
+    unsigned int mRangesBuffer  = 0, mRangesTexture  = 0; // RG32UI per froxel: first index, count
+    unsigned int mIndicesBuffer = 0, mIndicesTexture = 0; // R16UI light indices
+
+    glm::mat4 mProjection = glm::mat4(0.0f);
+    float mNear = 0.0f, mFar = 0.0f;
+    unsigned int mWidth = 0, mHeight = 0;
+    std::vector<Bounds> mClusterBounds;
+
+    ClusterBlock mBlock = {};
+    Stats mStats = {};
+
+    std::vector<glm::vec4>  mLights;  // two texels per light
+    std::vector<glm::ivec4> mScreenRects; // per light: pixel min xy, max xy (exclusive); empty off screen
+    std::vector<uint32_t>   mPairs;   // froxel << 16 | light, in light order
+    std::vector<glm::uvec2> mRanges;
+    std::vector<uint16_t>   mIndices;
+};
@@ -5,15 +5,20 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <vector>
 
 #include "../helpers/shader.h"
 #include "../helpers/camera.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "Primitives.h"
 
 class Cube
 {
 public:
     // Constructor
-    Cube(Shader& shader, unsigned int texture, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+    // The cube hangs under the given scene node; the transform is relative to it
+    Cube(Shader& shader, unsigned int texture, SceneNode& parent, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
 
     // Destructor
     ~Cube();
@@ -23,28 +28,24 @@ public:
     void SetRotation(const glm::vec3& rot);
     void SetScale(const glm::vec3& scl);
 
-    // Render methods
-    void Render(Camera& camera, const std::vector<glm::vec3>& lightPositions, 
-                const std::vector<glm::vec3>& lightColors);
+    // Queue a draw packet; cubes sharing a texture are drawn as one instanced batch,
+    // in both the main and the shadow pass
+    void Submit(RenderQueue& queue) const;
 
-    // Add this function
-    void RenderDepth(Shader& depthShader);
+    // World matrix cached by the scene graph
+    const glm::mat4& GetModelMatrix() const;
 
 private:
-    // Render data
-    unsigned int VAO, VBO;
+    // One material per texture, so the queue batches every cube that uses it
+    static const Material& SharedMaterial(unsigned int texture);
 
     // Shader and texture
     Shader& shader;
     unsigned int texture;
+    const Material* material;
 
-    // Transformations
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
-
-    // Initializes the cube's buffer and vertex attributes
-    void InitRenderData();
+    // Transformations, owned by the scene graph
+    SceneNode* node;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "DeferredRenderer.h"
+
+#include <iostream>
+
+#include "Primitives.h"
+#include "ShadowMaps.h"
+
+static unsigned int CreateTarget(GLenum internalFormat, GLenum format, GLenum type,
+                                 unsigned int width, unsigned int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// One 2D array layer per colour attachment, for the temporal shadow passes
+static unsigned int CreateLayeredTarget(GLenum internalFormat, GLenum type, GLenum filter, unsigned int width,
+                                        unsigned int height, unsigned int layers, unsigned int& framebuffer)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, layers,
+                 0, GL_RGBA, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    unsigned int attachments[DeferredRenderer::HISTORY_LAYERS];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    for (unsigned int layer = 0; layer < layers; ++layer)
+    {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + layer, texture, 0, layer);
+        attachments[layer] = GL_COLOR_ATTACHMENT0 + layer;
+    }
+    glDrawBuffers(layers, attachments);
+    return texture;
+}
+
+static void DrawFullscreen(GLStateCache& cache)
+{
+    cache.BindVertexArray(Primitives::VertexArray(PRIMITIVE_FULLSCREEN_TRIANGLE));
+    GeometryArena::Range triangle = GeometryArena::Get().GetRange(Primitives::Get(PRIMITIVE_FULLSCREEN_TRIANGLE));
+    glDrawElementsBaseVertex(GL_TRIANGLES, triangle.indexCount, GL_UNSIGNED_INT,
+                             (void*)(sizeof(unsigned int) * triangle.firstIndex), triangle.baseVertex);
+    cache.CountDraw();
+}
+
+// Frames the per-pixel tap rotation takes to cover the disk (TAP_SETS in deferred_shadow_sample.fs)
+static const unsigned int SHADOW_TAP_SETS = 7;
+
+bool DeferredRenderer::Init(unsigned int width, unsigned int height, Shader& geometryShader,
+                            Shader& lightShader, Shader& compositeShader,
+                            Shader& shadowSampleShader, Shader& shadowResolveShader)
+{
+    mWidth  = width;
+    mHeight = height;
+
+    mAlbedoTexture = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    mNormalTexture = CreateTarget(GL_RG16F, GL_RG, GL_FLOAT, width, height);
+    // same format as the resolved scene depth, so it can be blitted
+    mDepthTexture  = CreateTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+
+    glGenFramebuffers(1, &mGBufferFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, mGBufferFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAlbedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+    unsigned int gBufferAttachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, gBufferAttachments);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    mLightTexture      = CreateTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    mLightDepthTexture = CreateTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+
+    glGenFramebuffers(1, &mLightFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, mLightFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mLightTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mLightDepthTexture, 0);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (!complete)
+        std::cout << "Deferred G-buffer not complete!" << std::endl;
+
+    mGeometryProgram  = geometryShader.ID;
+    mCompositeProgram = compositeShader.ID;
+    mShadowResolveProgram = shadowResolveShader.ID;
+    mLightShader        = &lightShader;
+    mShadowSampleShader = &shadowSampleShader;
+
+    geometryShader.use();
+    geometryShader.setInt("diffuseTexture", 0);
+
+    lightShader.addSetup([](Shader& light)
+    {
+        light.use();
+        light.setInt("gAlbedo", ALBEDO_TEXTURE_UNIT);
+        light.setInt("gNormal", NORMAL_TEXTURE_UNIT);
+        light.setInt("gDepth",  DEPTH_TEXTURE_UNIT);
+        ShadowMaps::SetSamplers(light);
+        light.use();
+        light.setInt("shadowHistory", SHADOW_HISTORY_TEXTURE_UNIT);
+    });
+    UseLightProgram(lightShader);
+
+    compositeShader.use();
+    compositeShader.setInt("gAlbedo", ALBEDO_TEXTURE_UNIT);
+    compositeShader.setInt("gDepth",  DEPTH_TEXTURE_UNIT);
+    compositeShader.setInt("lightAccumulation", LIGHT_TEXTURE_UNIT);
+
+    shadowSampleShader.addSetup([](Shader& sample)
+    {
+        ShadowMaps::SetSamplers(sample);
+        sample.use();
+        sample.setInt("gDepth", DEPTH_TEXTURE_UNIT);
+    });
+    UseShadowSampleProgram(shadowSampleShader);
+
+    shadowResolveShader.use();
+    shadowResolveShader.setInt("gDepth",         DEPTH_TEXTURE_UNIT);
+    shadowResolveShader.setInt("previousDepth",  PREVIOUS_DEPTH_TEXTURE_UNIT);
+    shadowResolveShader.setInt("shadowSamples",  SHADOW_SAMPLES_TEXTURE_UNIT);
+    shadowResolveShader.setInt("shadowHistory",  SHADOW_HISTORY_TEXTURE_UNIT);
+    mResolveInverseViewProjection  = shadowResolveShader.getUniform<glm::mat4>("inverseViewProjection");
+    mPreviousViewProjectionUniform = shadowResolveShader.getUniform<glm::mat4>("previousViewProjection");
+    mInversePreviousViewProjection = shadowResolveShader.getUniform<glm::mat4>("inversePreviousViewProjection");
+    mHistoryValidUniform           = shadowResolveShader.getUniform<int>("historyValid");
+    glUseProgram(0);
+
+    glGenQueries(1, &mSamplesQuery);
+
+    // the light volumes and the composite triangle
+    Primitives::Get(PRIMITIVE_SPHERE);
+    Primitives::Get(PRIMITIVE_FULLSCREEN_TRIANGLE);
+    return complete;
+}
+
+void DeferredRenderer::Destroy()
+{
+    unsigned int textures[] = { mAlbedoTexture, mNormalTexture, mDepthTexture, mLightTexture, mLightDepthTexture };
+    unsigned int framebuffers[] = { mGBufferFBO, mLightFBO };
+    glDeleteTextures(5, textures);
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteQueries(1, &mSamplesQuery);
+    mAlbedoTexture = mNormalTexture = mDepthTexture = mLightTexture = mLightDepthTexture = 0;
+    mGBufferFBO = mLightFBO = mSamplesQuery = 0;
+
+    unsigned int shadowTextures[] = { mShadowSamplesTexture, mShadowHistoryTextures[0], mShadowHistoryTextures[1],
+                                      mPreviousDepthTexture };
+    unsigned int shadowFramebuffers[] = { mShadowSamplesFBO, mShadowHistoryFBOs[0], mShadowHistoryFBOs[1],
+                                          mPreviousDepthFBO };
+    glDeleteTextures(4, shadowTextures);
+    glDeleteFramebuffers(4, shadowFramebuffers);
+    mShadowSamplesTexture = mShadowHistoryTextures[0] = mShadowHistoryTextures[1] = mPreviousDepthTexture = 0;
+    mShadowSamplesFBO = mShadowHistoryFBOs[0] = mShadowHistoryFBOs[1] = mPreviousDepthFBO = 0;
+    mTemporalShadows = mHistoryValid = false;
+}
+
+void DeferredRenderer::CreateShadowTargets()
+{
+    // A three-tap mean fits RGBA8; the history blends in small steps that 8 bits would round away,
+    // and its last layer counts the frames it holds
+    mShadowSamplesTexture = CreateLayeredTarget(GL_RGBA8, GL_UNSIGNED_BYTE, GL_NEAREST, mWidth, mHeight,
+                                                SHADOW_LAYERS, mShadowSamplesFBO);
+    for (int i = 0; i < 2; ++i)
+        mShadowHistoryTextures[i] = CreateLayeredTarget(GL_RGBA16F, GL_FLOAT, GL_LINEAR, mWidth, mHeight,
+                                                        HISTORY_LAYERS, mShadowHistoryFBOs[i]);
+
+    mPreviousDepthTexture = CreateTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, mWidth, mHeight);
+    glGenFramebuffers(1, &mPreviousDepthFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, mPreviousDepthFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mPreviousDepthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DeferredRenderer::SetTemporalShadows(bool enabled)
+{
+    if (enabled && !mTemporalShadows)
+    {
+        if (!mShadowSamplesTexture)
+            CreateShadowTargets();
+        mHistoryValid = false;
+    }
+    mTemporalShadows = enabled;
+}
+
+ShaderDefines DeferredRenderer::LightDefines(bool shadows, bool temporal, ShadowMaps::Filter filter,
+                                             ShadowMaps::Quality quality)
+{
+    if (shadows && temporal)
+        return { { "SHADOWS", "1" }, { "TEMPORAL_SHADOWS", "1" } };
+    return ShadowMaps::LitDefines(shadows, filter, quality);
+}
+
+ShaderDefines DeferredRenderer::SampleDefines(ShadowMaps::Filter filter)
+{
+    return { { "SHADOW_FILTER", std::to_string(filter) } };
+}
+
+void DeferredRenderer::SetShadowVariant(bool shadows, ShadowMaps::Filter filter, ShadowMaps::Quality quality)
+{
+    UseLightProgram(mLightShader->variantIfReady(LightDefines(shadows, mTemporalShadows, filter, quality)));
+    // the taps are only sampled while temporal shadows are on
+    if (mTemporalShadows)
+        UseShadowSampleProgram(mShadowSampleShader->variantIfReady(SampleDefines(filter)));
+}
+
+void DeferredRenderer::UseLightProgram(const Shader& shader)
+{
+    if (shader.ID == mLightProgram)
+        return;
+    mLightProgram = shader.ID;
+    mInverseViewProjection  = shader.getUniform<glm::mat4>("inverseViewProjection");
+    mTemporalShadowsUniform = shader.getUniform<int>("temporalShadows");
+}
+
+void DeferredRenderer::UseShadowSampleProgram(const Shader& shader)
+{
+    if (shader.ID == mShadowSampleProgram)
+        return;
+    mShadowSampleProgram = shader.ID;
+    mSampleInverseViewProjection = shader.getUniform<glm::mat4>("inverseViewProjection");
+    mFrameIndex                  = shader.getUniform<int>("frameIndex");
+}
+
+void DeferredRenderer::BeginGeometry()
+{
+    glViewport(0, 0, mWidth, mHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, mGBufferFBO);
+    // alpha 1 on empty pixels, as the forward pass clears to
+    glClearColor(0.f, 0.f, 0.f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::Light(GLStateCache& cache, const glm::mat4& viewProjection, unsigned int lightCount,
+                             const glm::ivec4& shadowRect)
+{
+    if (mTemporalShadows && lightCount > 0)
+        ResolveShadows(cache, viewProjection, shadowRect);
+    else
+        mHistoryValid = false;
+
+    // the volumes test against a copy of the depth, since the G-buffer depth is also read
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mGBufferFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mLightFBO);
+    glBlitFramebuffer(0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, mLightFBO);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (mQueryPending)
+    {
+        GLuint available = 0;
+        glGetQueryObjectuiv(mSamplesQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            glGetQueryObjectuiv(mSamplesQuery, GL_QUERY_RESULT, &mStats.litSamples);
+            mQueryPending = false;
+        }
+    }
+    mStats.lights = lightCount;
+    if (lightCount == 0)
+        return;
+
+    cache.UseProgram(mLightProgram);
+    mInverseViewProjection.Set(glm::inverse(viewProjection));
+    mTemporalShadowsUniform.Set(mTemporalShadows ? 1 : 0);
+    cache.BindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D, mAlbedoTexture);
+    cache.BindTexture(NORMAL_TEXTURE_UNIT, GL_TEXTURE_2D, mNormalTexture);
+    cache.BindTexture(DEPTH_TEXTURE_UNIT,  GL_TEXTURE_2D, mDepthTexture);
+    if (mTemporalShadows)
+        cache.BindTexture(SHADOW_HISTORY_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, mShadowHistoryTextures[mHistoryIndex]);
+
+    // Back faces behind (or on) the surface: the surface lies in front of the far side of
+    // the volume. Works with the camera inside the volume, where front faces are clipped.
+    // Surfaces in front of the volume pass as well; the shader discards them by distance.
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glDepthFunc(GL_GEQUAL);
+    glDepthMask(GL_FALSE);
+
+    cache.BindVertexArray(Primitives::VertexArray(PRIMITIVE_SPHERE));
+    GeometryArena::Range sphere = GeometryArena::Get().GetRange(Primitives::Get(PRIMITIVE_SPHERE));
+    if (!mQueryPending)
+        glBeginQuery(GL_SAMPLES_PASSED, mSamplesQuery);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, sphere.indexCount, GL_UNSIGNED_INT,
+                                      (void*)(sizeof(unsigned int) * sphere.firstIndex),
+                                      lightCount, sphere.baseVertex);
+    if (!mQueryPending)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        mQueryPending = true;
+    }
+    cache.CountDraw(lightCount);
+
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glCullFace(GL_BACK);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+}
+
+void DeferredRenderer::ResolveShadows(GLStateCache& cache, const glm::mat4& viewProjection, const glm::ivec4& shadowRect)
+{
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+
+    // this frame's taps, only where a shadowed light reaches; unshadowed elsewhere
+    glBindFramebuffer(GL_FRAMEBUFFER, mShadowSamplesFBO);
+    const float unshadowed[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (unsigned int layer = 0; layer < SHADOW_LAYERS; ++layer)
+        glClearBufferfv(GL_COLOR, layer, unshadowed);
+    if (shadowRect.z > 0 && shadowRect.w > 0)
+    {
+        cache.UseProgram(mShadowSampleProgram);
+        mSampleInverseViewProjection.Set(inverseViewProjection);
+        mFrameIndex.Set(static_cast<int>(mFrame));
+        cache.BindTexture(DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, mDepthTexture);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(shadowRect.x, shadowRect.y, shadowRect.z, shadowRect.w);
+        DrawFullscreen(cache);
+        glDisable(GL_SCISSOR_TEST);
+    }
+    mFrame = (mFrame + 1) % SHADOW_TAP_SETS;
+
+    // blended with last frame's history into the other history target
+    unsigned int previous = mHistoryIndex;
+    mHistoryIndex ^= 1;
+    glBindFramebuffer(GL_FRAMEBUFFER, mShadowHistoryFBOs[mHistoryIndex]);
+    cache.UseProgram(mShadowResolveProgram);
+    mResolveInverseViewProjection.Set(inverseViewProjection);
+    mPreviousViewProjectionUniform.Set(mPreviousViewProjection);
+    mInversePreviousViewProjection.Set(glm::inverse(mPreviousViewProjection));
+    mHistoryValidUniform.Set(mHistoryValid ? 1 : 0);
+    cache.BindTexture(SHADOW_SAMPLES_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, mShadowSamplesTexture);
+    cache.BindTexture(SHADOW_HISTORY_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, mShadowHistoryTextures[previous]);
+    cache.BindTexture(PREVIOUS_DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, mPreviousDepthTexture);
+    DrawFullscreen(cache);
+
+    // this frame's depth is what the next frame reprojects against
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mGBufferFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mPreviousDepthFBO);
+    glBlitFramebuffer(0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    mPreviousViewProjection = viewProjection;
+    mHistoryValid = true;
+}
+
+void DeferredRenderer::Composite(GLStateCache& cache, unsigned int targetFBO)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    cache.UseProgram(mCompositeProgram);
+    cache.BindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D, mAlbedoTexture);
+    cache.BindTexture(DEPTH_TEXTURE_UNIT,  GL_TEXTURE_2D, mDepthTexture);
+    cache.BindTexture(LIGHT_TEXTURE_UNIT,  GL_TEXTURE_2D, mLightTexture);
+
+    // every pixel is written, depth included
+    glDepthFunc(GL_ALWAYS);
+    DrawFullscreen(cache);
+    glDepthFunc(GL_LESS);
+}
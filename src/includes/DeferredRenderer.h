@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../helpers/shader.h"
+#include "GLStateCache.h"
+#include "GeometryArena.h"
+#include "ShadowMaps.h"
+#include "UniformBuffers.h"
+
+/**
+ * Deferred shading path, an alternative to lighting every fragment in bloom.fs.
+ *
+ * The geometry pass writes a compact G-buffer: RGBA8 albedo, an octahedral
+ * normal in RG16F and 24-bit depth (12 bytes a pixel, no MSAA). Lighting then
+ * draws one sphere per light (instanced, sized to the light's bounded radius,
+ * read from the clustered lights buffer) with additive blending. Back faces are
+ * drawn with a GL_GEQUAL depth test against a copy of the G-buffer depth, which
+ * rejects the surfaces behind the volume. The test is one-sided: surfaces in
+ * front of the volume pass it too, and the light shader discards them, with
+ * everything else outside the light's radius, before any shading. There is no
+ * front-face stencil pass, since the volumes are drawn in one instanced call and
+ * a stencil mark cannot tell one light's volume from another's. Every light in
+ * the light block (up to MAX_LIGHTS) that has a shadow atlas slice is shadowed.
+ * Composite() adds ambient, writes the same colour and bright targets as the
+ * forward pass, and restores the scene depth so emissive geometry can be drawn
+ * forward on top.
+ *
+ * With temporal shadows on, the light volumes stop filtering shadows
+ * themselves. A full-screen pass first takes three of the 21 PCF taps per
+ * shadowed light, rotated per frame and per pixel. A second pass reprojects
+ * last frame's result through the camera motion, drops it where the depth
+ * disagrees, clamps it to the 3x3 neighbourhood of this frame's taps and
+ * blends. Four lights share an RGBA layer, so MAX_LIGHTS / 4 layers cover them.
+ *
+ * The light and sampling shaders are specialised per shadow setup like the
+ * forward lit shader: SetShadowVariant() picks the variant each frame, and the
+ * programs given to Init() stand in while it builds.
+ */
+class DeferredRenderer
+{
+public:
+    // Above the shadow map units; the G-buffer is read only during Light() and Composite()
+    static const unsigned int ALBEDO_TEXTURE_UNIT = 5;
+    static const unsigned int NORMAL_TEXTURE_UNIT = 6;
+    static const unsigned int DEPTH_TEXTURE_UNIT  = 7;
+    static const unsigned int LIGHT_TEXTURE_UNIT  = 8;
+    // Temporal shadows. The previous depth is only read by the resolve, before Composite() needs unit 8.
+    static const unsigned int SHADOW_HISTORY_TEXTURE_UNIT = 2;
+    static const unsigned int SHADOW_SAMPLES_TEXTURE_UNIT = 3;
+    static const unsigned int PREVIOUS_DEPTH_TEXTURE_UNIT = LIGHT_TEXTURE_UNIT;
+    static const unsigned int SHADOW_LAYERS = MAX_LIGHTS / 4;
+    // the shadow layers plus one counting the frames in each pixel's running mean
+    static const unsigned int HISTORY_LAYERS = SHADOW_LAYERS + 1;
+
+    struct Stats
+    {
+        unsigned int lights;     // volumes drawn this frame
+        unsigned int litSamples; // samples that passed the volume depth test (previous result)
+    };
+
+    // geometryShader: bloom.vs + deferred_geometry.fs; lightShader: deferred_light.vs/.fs;
+    // compositeShader: deferred_composite.vs/.fs; shadowSampleShader and shadowResolveShader:
+    // deferred_composite.vs + deferred_shadow_sample.fs / deferred_shadow_resolve.fs.
+    // All with the uniform blocks attached, and the light and sampling shaders with the
+    // clustered lights; for those two through Shader::addSetup, so their variants get them too.
+    bool Init(unsigned int width, unsigned int height, Shader& geometryShader,
+              Shader& lightShader, Shader& compositeShader,
+              Shader& shadowSampleShader, Shader& shadowResolveShader);
+    void Destroy();
+
+    // Binds and clears the G-buffer; draw the opaque packets with GeometryProgram() next
+    void BeginGeometry();
+    unsigned int GeometryProgram() const { return mGeometryProgram; }
+
+    // Accumulate shadows over frames (PCF and compare filters). The shadow maps must be
+    // bound while it is on. Turning it on starts from fresh history.
+    void SetTemporalShadows(bool enabled);
+    bool GetTemporalShadows() const { return mTemporalShadows; }
+
+    // Defines of the light and sampling shader variants for a shadow setup (deferred_light.fs,
+    // deferred_shadow_sample.fs); temporal light volumes only read the history, whatever the filter
+    static ShaderDefines LightDefines(bool shadows, bool temporal, ShadowMaps::Filter filter, ShadowMaps::Quality quality);
+    static ShaderDefines SampleDefines(ShadowMaps::Filter filter);
+    // Picks this frame's variants, after SetTemporalShadows(); until one has built, the program
+    // given to Init() draws in its place. Sets up new variants directly, so call it outside a
+    // state cache frame.
+    void SetShadowVariant(bool shadows, ShadowMaps::Filter filter, ShadowMaps::Quality quality);
+
+    // Adds lightCount light volumes into the light buffer. The lights are the
+    // clustered lights' texture buffer, which must be bound on its unit. shadowRect
+    // (x, y, width, height) bounds the shadowed lights on screen; temporal shadow
+    // taps are only taken inside it.
+    void Light(GLStateCache& cache, const glm::mat4& viewProjection, unsigned int lightCount,
+               const glm::ivec4& shadowRect);
+    // Writes ambient + lights into targetFBO's two colour attachments and its depth
+    void Composite(GLStateCache& cache, unsigned int targetFBO);
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    void CreateShadowTargets();
+    // Switch to a light / sampling program, resolving its uniform handles when it changes
+    void UseLightProgram(const Shader& shader);
+    void UseShadowSampleProgram(const Shader& shader);
+    // Few-tap shadow terms, then the reprojected history blended in; leaves the new history
+    void ResolveShadows(GLStateCache& cache, const glm::mat4& viewProjection, const glm::ivec4& shadowRect);
+
+    unsigned int mWidth = 0, mHeight = 0;
+
+    unsigned int mGBufferFBO = 0;
+    unsigned int mAlbedoTexture = 0, mNormalTexture = 0, mDepthTexture = 0;
+    // light accumulation, depth tested against a copy of the G-buffer depth
+    unsigned int mLightFBO = 0;
+    unsigned int mLightTexture = 0, mLightDepthTexture = 0;
+
+    Shader*      mLightShader        = nullptr;
+    Shader*      mShadowSampleShader = nullptr;
+    unsigned int mGeometryProgram  = 0;
+    unsigned int mLightProgram     = 0;
+    unsigned int mCompositeProgram = 0;
+    Uniform<glm::mat4> mInverseViewProjection;
+    Uniform<int>       mTemporalShadowsUniform; // the stand-in's; variants fix it at compile time
+
+    // Temporal shadows: this frame's taps, ping-ponged history and the depth it was made at
+    bool         mTemporalShadows = false;
+    bool         mHistoryValid    = false;
+    unsigned int mHistoryIndex    = 0;
+    unsigned int mFrame           = 0;
+    glm::mat4    mPreviousViewProjection = glm::mat4(1.0f);
+    unsigned int mShadowSamplesTexture = 0, mShadowSamplesFBO = 0;
+    unsigned int mShadowHistoryTextures[2] = {}, mShadowHistoryFBOs[2] = {};
+    unsigned int mPreviousDepthTexture = 0, mPreviousDepthFBO = 0;
+
+    unsigned int mShadowSampleProgram  = 0;
+    unsigned int mShadowResolveProgram = 0;
+    Uniform<glm::mat4> mSampleInverseViewProjection;
+    Uniform<int>       mFrameIndex;
+    Uniform<glm::mat4> mResolveInverseViewProjection;
+    Uniform<glm::mat4> mPreviousViewProjectionUniform;
+    Uniform<glm::mat4> mInversePreviousViewProjection;
+    Uniform<int>       mHistoryValidUniform;
+
+    unsigned int mSamplesQuery = 0;
+    bool         mQueryPending = false;
+    Stats        mStats = {};
+};
@@ -0,0 +1,100 @@
+#include "DepthPrepass.h"
+
+bool DepthPrepass::Init(const Shader& prepassShader)
+{
+    mProgram = prepassShader.ID;
+    glGenQueries(1, &mDepthQuery);
+    glGenQueries(1, &mShadingQuery);
+    return mProgram != 0;
+}
+
+void DepthPrepass::Destroy()
+{
+    glDeleteQueries(1, &mDepthQuery);
+    glDeleteQueries(1, &mShadingQuery);
+    mDepthQuery = mShadingQuery = 0;
+    mDepthPending = mShadingPending = false;
+}
+
+// Reads a query's result if it is ready; true once it was read
+static bool ReadQuery(unsigned int query, bool& pending, unsigned int& result)
+{
+    if (!pending)
+        return false;
+    GLuint available = 0;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+    pending = false;
+    return true;
+}
+
+bool DepthPrepass::Begin(Mode mode, unsigned int screenSamples)
+{
+    mScreenSamples = screenSamples > 0 ? screenSamples : 1;
+
+    // both queries of a measured frame finish in issue order, depth first
+    ReadQuery(mDepthQuery, mDepthPending, mStats.depthSamples);
+    if (!mDepthPending && ReadQuery(mShadingQuery, mShadingPending, mStats.shadedSamples))
+    {
+        // without a pre-pass the shading pass itself is the overdraw measurement
+        if (!mMeasuredActive)
+            mStats.depthSamples = mStats.shadedSamples;
+        mStats.overdraw = (float)mStats.depthSamples / mScreenSamples;
+        mStats.savedSamples = mStats.depthSamples > mStats.shadedSamples
+                            ? mStats.depthSamples - mStats.shadedSamples : 0;
+    }
+
+    if (mStats.overdraw > ENABLE_OVERDRAW)
+        mAutoActive = true;
+    else if (mStats.overdraw < DISABLE_OVERDRAW)
+        mAutoActive = false;
+
+    mStats.active = mode == MODE_ON || (mode == MODE_AUTO && mAutoActive);
+    // a new measurement starts only once the last one is read, so the two counts pair up
+    mMeasuring = !mDepthPending && !mShadingPending;
+    if (mMeasuring)
+        mMeasuredActive = mStats.active;
+    return mStats.active;
+}
+
+void DepthPrepass::BeginDepth()
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    if (mMeasuring)
+        glBeginQuery(GL_SAMPLES_PASSED, mDepthQuery);
+}
+
+void DepthPrepass::EndDepth()
+{
+    if (mMeasuring)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        mDepthPending = true;
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void DepthPrepass::BeginShading()
+{
+    if (mStats.active)
+    {
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+    }
+    if (mMeasuring)
+        glBeginQuery(GL_SAMPLES_PASSED, mShadingQuery);
+}
+
+void DepthPrepass::EndShading()
+{
+    if (mMeasuring)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        mShadingPending = true;
+        mMeasuring = false;
+    }
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
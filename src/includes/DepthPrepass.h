@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "../helpers/shader.h"
+#include "GLStateCache.h"
+
+/**
+ * Optional depth-only pass ahead of forward shading. Every packet is first
+ * drawn with a position-only program and colour writes off; the shading pass
+ * then runs with GL_LEQUAL and depth writes off, so bloom.fs (and its shadow
+ * PCF) runs once per visible sample instead of once per overdrawn layer.
+ *
+ * Samples-passed queries around both passes measure the win: the pre-pass
+ * count is what forward shading would have cost, the shading pass count is
+ * what it costs now. In MODE_AUTO the pre-pass is switched on when the
+ * measured overdraw (samples shaded per screen sample) rises above
+ * ENABLE_OVERDRAW and off again below DISABLE_OVERDRAW. Results are read a
+ * frame or more late, only once GL has them.
+ */
+class DepthPrepass
+{
+public:
+    enum Mode
+    {
+        MODE_AUTO = 0,
+        MODE_ON,
+        MODE_OFF,
+        MODE_COUNT
+    };
+
+    static constexpr float ENABLE_OVERDRAW  = 2.0f;
+    static constexpr float DISABLE_OVERDRAW = 1.5f;
+
+    struct Stats
+    {
+        unsigned int depthSamples;  // passed the pre-pass (= forward shading without it)
+        unsigned int shadedSamples; // passed the shading pass
+        unsigned int savedSamples;  // shading runs the pre-pass removed
+        float        overdraw;      // shaded samples per screen sample, without the pre-pass
+        bool         active;        // pre-pass ran this frame
+    };
+
+    // prepassShader is depth_prepass.vs/.fs with the frame uniform block attached
+    bool Init(const Shader& prepassShader);
+    void Destroy();
+
+    // Reads finished queries and decides whether the pre-pass runs this frame.
+    // screenSamples is width * height * MSAA samples of the target.
+    bool Begin(Mode mode, unsigned int screenSamples);
+    unsigned int Program() const { return mProgram; }
+
+    // Around the pre-pass draws: colour writes off, depth as usual
+    void BeginDepth();
+    void EndDepth();
+    // Around the shading pass; with the pre-pass, depth is tested GL_LEQUAL and not written
+    void BeginShading();
+    void EndShading();
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    unsigned int mProgram = 0;
+    unsigned int mDepthQuery = 0, mShadingQuery = 0;
+    bool mDepthPending = false, mShadingPending = false;
+    bool mMeasuring = false;     // this frame's passes are being counted
+    bool mMeasuredActive = false; // the counted frame ran the pre-pass
+    bool mAutoActive = false;
+    unsigned int mScreenSamples = 1;
+    Stats mStats = {};
+};
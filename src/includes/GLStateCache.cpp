@@ -0,0 +1,103 @@
+#include "GLStateCache.h"
+
+#include <cstring>
+
+unsigned int GLStateCache::Stats::TotalIssued() const
+{
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < CALL_COUNT; ++i)
+        total += issued[i];
+    return total;
+}
+
+unsigned int GLStateCache::Stats::TotalSkipped() const
+{
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < CALL_COUNT; ++i)
+        total += skipped[i];
+    return total;
+}
+
+GLStateCache::GLStateCache()
+{
+    BeginFrame();
+}
+
+void GLStateCache::BeginFrame()
+{
+    Invalidate();
+    std::memset(&mStats, 0, sizeof(mStats));
+}
+
+void GLStateCache::Invalidate()
+{
+    mProgram     = UNKNOWN;
+    mVertexArray = UNKNOWN;
+    mActiveUnit  = UNKNOWN;
+    for (unsigned int i = 0; i < MAX_TRACKED_UNITS; ++i)
+        mTextures[i][0] = mTextures[i][1] = UNKNOWN;
+}
+
+int GLStateCache::TargetSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:       return 0;
+    case GL_TEXTURE_CUBE_MAP: return 1;
+    default:                  return -1;
+    }
+}
+
+void GLStateCache::UseProgram(unsigned int program)
+{
+    if (mProgram == program)
+    {
+        mStats.skipped[USE_PROGRAM]++;
+        return;
+    }
+    glUseProgram(program);
+    mProgram = program;
+    mStats.issued[USE_PROGRAM]++;
+}
+
+void GLStateCache::BindVertexArray(unsigned int vao)
+{
+    if (mVertexArray == vao)
+    {
+        mStats.skipped[BIND_VERTEX_ARRAY]++;
+        return;
+    }
+    glBindVertexArray(vao);
+    mVertexArray = vao;
+    mStats.issued[BIND_VERTEX_ARRAY]++;
+}
+
+void GLStateCache::ActiveTexture(unsigned int unit)
+{
+    if (mActiveUnit == unit)
+    {
+        mStats.skipped[ACTIVE_TEXTURE]++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    mActiveUnit = unit;
+    mStats.issued[ACTIVE_TEXTURE]++;
+}
+
+void GLStateCache::BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    int slot = TargetSlot(target);
+    bool tracked = slot >= 0 && unit < MAX_TRACKED_UNITS;
+    if (tracked && mTextures[unit][slot] == texture)
+    {
+        // the unit switch we would have needed is saved as well
+        mStats.skipped[BIND_TEXTURE]++;
+        return;
+    }
+
+    ActiveTexture(unit);
+    glBindTexture(target, texture);
+    if (tracked)
+        mTextures[unit][slot] = texture;
+    mStats.issued[BIND_TEXTURE]++;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/**
+ * Shadows the bits of GL binding state the render queue touches and drops
+ * calls that would not change anything. Code that talks to GL directly
+ * (bloom, framebuffer setup) bypasses the cache, so call BeginFrame() before
+ * the scene passes to forget whatever it left behind.
+ */
+class GLStateCache
+{
+public:
+    enum Call
+    {
+        USE_PROGRAM = 0,
+        BIND_VERTEX_ARRAY,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        CALL_COUNT
+    };
+
+    struct Stats
+    {
+        unsigned int issued[CALL_COUNT];
+        unsigned int skipped[CALL_COUNT];
+        unsigned int drawCalls;
+        unsigned int instances;
+
+        unsigned int TotalIssued() const;
+        unsigned int TotalSkipped() const;
+    };
+
+    GLStateCache();
+
+    // Forgets all cached bindings and resets the per-frame counters
+    void BeginFrame();
+    // Forgets all cached bindings (after GL was driven behind the cache's back)
+    void Invalidate();
+
+    void UseProgram(unsigned int program);
+    void BindVertexArray(unsigned int vao);
+    void ActiveTexture(unsigned int unit);
+    // Binds on the given unit, switching the active unit only if the binding changes
+    void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+    void CountDraw(unsigned int instanceCount = 1)
+    {
+        mStats.drawCalls++;
+        mStats.instances += instanceCount;
+    }
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    static const unsigned int MAX_TRACKED_UNITS = 32;
+    static const unsigned int UNKNOWN = ~0u;
+
+    // Only the targets this renderer uses are tracked; anything else goes straight to GL
+    static int TargetSlot(GLenum target);
+
+    unsigned int mProgram;
+    unsigned int mVertexArray;
+    unsigned int mActiveUnit;
+    unsigned int mTextures[MAX_TRACKED_UNITS][2];
+
+    Stats mStats;
+};
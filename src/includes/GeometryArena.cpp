@@ -0,0 +1,258 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Starting capacities, in vertices and indices; buffers double when they run out
+static const uint32_t INITIAL_VERTICES[VERTEX_LAYOUT_COUNT] = { 1u << 16, 1u << 6 };
+static const uint32_t INITIAL_INDICES[VERTEX_LAYOUT_COUNT]  = { 1u << 18, 1u << 6 };
+
+GeometryArena& GeometryArena::Get()
+{
+    static GeometryArena arena;
+    return arena;
+}
+
+size_t GeometryArena::Stride(VertexLayout layout)
+{
+    return layout == VERTEX_LAYOUT_MESH ? sizeof(Vertex) : 4 * sizeof(float);
+}
+
+// Expects the layout's VAO and vertex buffer to be bound
+void GeometryArena::SetAttributes(VertexLayout layout)
+{
+    const GLsizei stride = (GLsizei)Stride(layout);
+    if (layout == VERTEX_LAYOUT_SCREEN)
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+        return;
+    }
+
+    // same locations the per-mesh VAOs used
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+}
+
+GeometryArena::Pool& GeometryArena::GetPool(VertexLayout layout)
+{
+    Pool& pool = mPools[layout];
+    if (pool.vao == 0)
+    {
+        glGenVertexArrays(1, &pool.vao);
+        Repack(layout, INITIAL_VERTICES[layout], INITIAL_INDICES[layout]);
+    }
+    return pool;
+}
+
+GeometryArena::Handle GeometryArena::Allocate(VertexLayout layout, const void* vertices, uint32_t vertexCount,
+                                              const unsigned int* indices, uint32_t indexCount)
+{
+    if (vertexCount == 0 || indexCount == 0)
+        return INVALID_HANDLE;
+
+    Pool& pool = GetPool(layout);
+    uint32_t baseVertex = pool.vertices.Allocate(vertexCount);
+    uint32_t firstIndex = pool.indices.Allocate(indexCount);
+    if (baseVertex == RangeAllocator::INVALID || firstIndex == RangeAllocator::INVALID)
+    {
+        if (baseVertex != RangeAllocator::INVALID)
+            pool.vertices.Free(baseVertex, vertexCount);
+        if (firstIndex != RangeAllocator::INVALID)
+            pool.indices.Free(firstIndex, indexCount);
+
+        // Packing puts all free space in one block at the end; grow only if that is still too small
+        uint32_t vertexCapacity = pool.vertices.Capacity();
+        while (vertexCapacity - pool.vertices.UsedSize() < vertexCount)
+            vertexCapacity *= 2;
+        uint32_t indexCapacity = pool.indices.Capacity();
+        while (indexCapacity - pool.indices.UsedSize() < indexCount)
+            indexCapacity *= 2;
+        Repack(layout, vertexCapacity, indexCapacity);
+
+        baseVertex = pool.vertices.Allocate(vertexCount);
+        firstIndex = pool.indices.Allocate(indexCount);
+    }
+
+    const size_t stride = Stride(layout);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * stride, vertexCount * stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Handle handle;
+    if (!mFreeSlots.empty())
+    {
+        handle = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        handle = (Handle)mSlots.size();
+        mSlots.emplace_back();
+    }
+    mSlots[handle] = { layout, baseVertex, vertexCount, firstIndex, indexCount, true };
+    return handle;
+}
+
+void GeometryArena::Free(Handle handle)
+{
+    if (handle >= mSlots.size() || !mSlots[handle].live)
+        return;
+
+    Slot& slot = mSlots[handle];
+    Pool& pool = mPools[slot.layout];
+    pool.vertices.Free(slot.baseVertex, slot.vertexCount);
+    pool.indices.Free(slot.firstIndex, slot.indexCount);
+    slot.live = false;
+    mFreeSlots.push_back(handle);
+}
+
+GeometryArena::Range GeometryArena::GetRange(Handle handle) const
+{
+    if (handle >= mSlots.size() || !mSlots[handle].live)
+        return { 0, 0, 0, 0 };
+    const Slot& slot = mSlots[handle];
+    return { (int)slot.baseVertex, slot.firstIndex, slot.indexCount, slot.vertexCount };
+}
+
+unsigned int GeometryArena::VertexArray(VertexLayout layout)
+{
+    return GetPool(layout).vao;
+}
+
+bool GeometryArena::Defragment(unsigned int maxFreeBlocks)
+{
+    bool moved = false;
+    for (unsigned int layout = 0; layout < VERTEX_LAYOUT_COUNT; ++layout)
+    {
+        Pool& pool = mPools[layout];
+        if (pool.vao == 0)
+            continue;
+        if (pool.vertices.FreeBlockCount() > maxFreeBlocks || pool.indices.FreeBlockCount() > maxFreeBlocks)
+        {
+            Repack((VertexLayout)layout, pool.vertices.Capacity(), pool.indices.Capacity());
+            moved = true;
+        }
+    }
+    return moved;
+}
+
+void GeometryArena::Repack(VertexLayout layout, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    Pool& pool = mPools[layout];
+    const size_t stride = Stride(layout);
+    const bool copying = pool.vbo != 0;
+
+    unsigned int vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * stride, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+    std::vector<Handle> live;
+    for (Handle h = 0; h < mSlots.size(); ++h)
+        if (mSlots[h].live && mSlots[h].layout == layout)
+            live.push_back(h);
+
+    // Copy in offset order so ranges keep their relative placement. Indices are
+    // relative to the base vertex, so moving vertices never rewrites them.
+    uint32_t packedVertices = 0;
+    std::sort(live.begin(), live.end(), [this](Handle a, Handle b) { return mSlots[a].baseVertex < mSlots[b].baseVertex; });
+    glBindBuffer(GL_COPY_READ_BUFFER, pool.vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    for (Handle h : live)
+    {
+        Slot& slot = mSlots[h];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            slot.baseVertex * stride, packedVertices * stride, slot.vertexCount * stride);
+        slot.baseVertex = packedVertices;
+        packedVertices += slot.vertexCount;
+    }
+
+    uint32_t packedIndices = 0;
+    std::sort(live.begin(), live.end(), [this](Handle a, Handle b) { return mSlots[a].firstIndex < mSlots[b].firstIndex; });
+    glBindBuffer(GL_COPY_READ_BUFFER, pool.ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    for (Handle h : live)
+    {
+        Slot& slot = mSlots[h];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            slot.firstIndex * sizeof(unsigned int), packedIndices * sizeof(unsigned int),
+                            slot.indexCount * sizeof(unsigned int));
+        slot.firstIndex = packedIndices;
+        packedIndices += slot.indexCount;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    pool.vertices.Reset(vertexCapacity, packedVertices);
+    pool.indices.Reset(indexCapacity, packedIndices);
+
+    if (copying)
+    {
+        glDeleteBuffers(1, &pool.vbo);
+        glDeleteBuffers(1, &pool.ebo);
+        mRepacks++;
+    }
+    pool.vbo = vbo;
+    pool.ebo = ebo;
+
+    // Re-point the shared VAO; instance attributes attached by the render queue are left alone
+    glBindVertexArray(pool.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+    SetAttributes(layout);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.ebo);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::Stats GeometryArena::GetStats() const
+{
+    Stats stats = {};
+    for (const Slot& slot : mSlots)
+        stats.allocations += slot.live ? 1 : 0;
+    for (unsigned int layout = 0; layout < VERTEX_LAYOUT_COUNT; ++layout)
+    {
+        const Pool& pool = mPools[layout];
+        const size_t stride = Stride((VertexLayout)layout);
+        stats.usedBytes     += pool.vertices.UsedSize() * stride + pool.indices.UsedSize() * sizeof(unsigned int);
+        stats.capacityBytes += pool.vertices.Capacity() * stride + pool.indices.Capacity() * sizeof(unsigned int);
+        stats.freeBlocks    += (unsigned int)(pool.vertices.FreeBlockCount() + pool.indices.FreeBlockCount());
+    }
+    stats.repacks = mRepacks;
+    return stats;
+}
+
+void GeometryArena::Destroy()
+{
+    for (Pool& pool : mPools)
+    {
+        if (pool.vao == 0)
+            continue;
+        glDeleteVertexArrays(1, &pool.vao);
+        glDeleteBuffers(1, &pool.vbo);
+        glDeleteBuffers(1, &pool.ebo);
+        pool = Pool();
+    }
+    mSlots.clear();
+    mFreeSlots.clear();
+    mRepacks = 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/vertex.h"
+#include "RangeAllocator.h"
+
+// Vertex formats the arena keeps buffers for; each gets one VAO
+enum VertexLayout
+{
+    VERTEX_LAYOUT_MESH     = 0, // Vertex: position, normal, uv, tangent frame, bones (locations 0..6)
+    VERTEX_LAYOUT_SCREEN   = 1, // vec2 position, vec2 uv (locations 0, 1): fullscreen passes
+    VERTEX_LAYOUT_COUNT
+};
+
+/**
+ * Global store for static geometry. Per vertex layout there is one large
+ * vertex buffer, one large index buffer and one VAO; meshes sub-allocate
+ * ranges from them and draw with a base vertex and a first index, so every
+ * mesh of a layout binds the same VAO and can share a multi-draw.
+ *
+ * Ranges come from a best-fit free list per buffer. Allocations are named by
+ * handle rather than offset: when a buffer runs out, or Defragment() is asked
+ * to, the live ranges are packed to the front of a new buffer with
+ * glCopyBufferSubData and only the handle table changes. Look ranges up with
+ * GetRange() when drawing rather than keeping the offsets.
+ */
+class GeometryArena
+{
+public:
+    typedef uint32_t Handle;
+    static const Handle INVALID_HANDLE = 0xFFFFFFFFu;
+
+    // Where an allocation currently lives in its layout's buffers
+    struct Range
+    {
+        int          baseVertex;
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        unsigned int vertexCount;
+    };
+
+    struct Stats
+    {
+        unsigned int allocations;
+        size_t       usedBytes;
+        size_t       capacityBytes;
+        unsigned int freeBlocks;     // summed over all buffers; 1 per buffer when fully packed
+        unsigned int repacks;        // grows and defragmentations since start
+    };
+
+    // The arena every mesh allocates from; needs a current GL context on first allocation
+    static GeometryArena& Get();
+
+    // Copies the vertices and indices into the layout's buffers. Indices are relative
+    // to the allocation's first vertex, as they come from the model loader.
+    Handle Allocate(VertexLayout layout, const void* vertices, uint32_t vertexCount,
+                    const unsigned int* indices, uint32_t indexCount);
+    // Returns the ranges to the free lists; handles from before Destroy() are ignored
+    void Free(Handle handle);
+
+    Range GetRange(Handle handle) const;
+    // Shared VAO of the layout, with its element buffer bound
+    unsigned int VertexArray(VertexLayout layout);
+
+    // Packs every layout whose free space is split over more than maxFreeBlocks blocks.
+    // Returns true if anything moved. Call between frames: the packed buffers replace
+    // the old ones.
+    bool Defragment(unsigned int maxFreeBlocks = 1);
+
+    Stats GetStats() const;
+
+    // Deletes every buffer and VAO; outstanding handles become invalid
+    void Destroy();
+
+private:
+    struct Pool
+    {
+        unsigned int   vao = 0;
+        unsigned int   vbo = 0;
+        unsigned int   ebo = 0;
+        RangeAllocator vertices;
+        RangeAllocator indices;
+    };
+
+    struct Slot
+    {
+        VertexLayout layout;
+        uint32_t     baseVertex;
+        uint32_t     vertexCount;
+        uint32_t     firstIndex;
+        uint32_t     indexCount;
+        bool         live;
+    };
+
+    static size_t Stride(VertexLayout layout);
+    static void SetAttributes(VertexLayout layout);
+
+    Pool& GetPool(VertexLayout layout);
+    // Moves the layout's live ranges to the front of new buffers of the given capacities
+    void Repack(VertexLayout layout, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+    Pool mPools[VERTEX_LAYOUT_COUNT];
+    std::vector<Slot>   mSlots;
+    std::vector<Handle> mFreeSlots;
+    unsigned int mRepacks = 0;
+};
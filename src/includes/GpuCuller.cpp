@@ -0,0 +1,183 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+#include <cstddef>
+
+static_assert(sizeof(InstanceData) == 28 * sizeof(float), "gpu_cull.cs writes 28 packed floats per instance");
+
+// Units out of the way of the material (0) and shadow map (1..) units
+static const unsigned int HIZ_TEXTURE_UNIT = 15;
+static const unsigned int CULL_GROUP_SIZE  = 64; // local_size_x in gpu_cull.cs
+static const unsigned int REDUCE_TILE_SIZE = 8;  // local_size_x/y in hiz_reduce.cs
+
+bool GpuCuller::IsSupported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+bool GpuCuller::Init(unsigned int width, unsigned int height)
+{
+    mCullShader = std::make_unique<ComputeShader>("shaders/gpu_cull.cs");
+    mHiZShader  = std::make_unique<ComputeShader>("shaders/hiz_reduce.cs");
+
+    mObjectCountUniform       = Uniform<unsigned int>(glGetUniformLocation(mCullShader->ID, "objectCount"));
+    mFrustumPlanesLocation    = glGetUniformLocation(mCullShader->ID, "frustumPlanes");
+    mHiZEnabledUniform        = Uniform<bool>(glGetUniformLocation(mCullShader->ID, "hiZEnabled"));
+    mHiZViewProjectionUniform = Uniform<glm::mat4>(glGetUniformLocation(mCullShader->ID, "hiZViewProjection"));
+    mHiZSizeUniform           = Uniform<glm::vec2>(glGetUniformLocation(mCullShader->ID, "hiZSize"));
+    mHiZSamplerUniform        = Uniform<int>(glGetUniformLocation(mCullShader->ID, "hiZ"));
+    mReduceSourceUniform      = Uniform<int>(glGetUniformLocation(mHiZShader->ID, "source"));
+    mReduceLevelUniform       = Uniform<int>(glGetUniformLocation(mHiZShader->ID, "sourceLevel"));
+
+    glGenBuffers(1, &mObjectBuffer);
+    glGenBuffers(1, &mCommandBuffer);
+    mInstances.Init();
+
+    mWidth  = width;
+    mHeight = height;
+    mHiZLevels = 1;
+    while ((std::max(mWidth, mHeight) >> mHiZLevels) > 0)
+        mHiZLevels++;
+
+    glGenTextures(1, &mHiZTexture);
+    glBindTexture(GL_TEXTURE_2D, mHiZTexture);
+    glTexStorage2D(GL_TEXTURE_2D, mHiZLevels, GL_R32F, mWidth, mHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return mCullShader->ID != 0 && mHiZShader->ID != 0;
+}
+
+void GpuCuller::Destroy()
+{
+    glDeleteTextures(1, &mHiZTexture);
+    glDeleteBuffers(1, &mCommandBuffer);
+    glDeleteBuffers(1, &mObjectBuffer);
+    mInstances.Destroy();
+    if (mCullShader) glDeleteProgram(mCullShader->ID);
+    if (mHiZShader)  glDeleteProgram(mHiZShader->ID);
+    mCullShader.reset();
+    mHiZShader.reset();
+    mHiZTexture = mCommandBuffer = mObjectBuffer = 0;
+    mObjectCapacity = mCommandCapacity = 0;
+    mHiZValid = false;
+}
+
+void GpuCuller::Begin(uint64_t layoutHash)
+{
+    mObjects.clear();
+    mCommands.clear();
+    mLayoutHash = layoutHash;
+    mStats = {};
+}
+
+void GpuCuller::AddGroup(unsigned int indexCount, unsigned int firstIndex, int baseVertex)
+{
+    // each group's instances start where the previous group's objects end
+    mCommands.push_back({ indexCount, 0, firstIndex, baseVertex, (uint32_t)mObjects.size() });
+}
+
+void GpuCuller::AddObject(const glm::mat4& model, const Bounds& worldBounds, const glm::vec3& color)
+{
+    GpuObject object = {};
+    object.model = model;
+    object.color = glm::vec4(color, 1.0f);
+    if (worldBounds.IsValid())
+    {
+        object.center = glm::vec4((worldBounds.min + worldBounds.max) * 0.5f, 0.0f);
+        object.extent = glm::vec4((worldBounds.max - worldBounds.min) * 0.5f, 0.0f);
+    }
+    else
+    {
+        // no bounds: never culled
+        object.center = glm::vec4(glm::vec3(model[3]), 0.0f);
+        object.extent = glm::vec4(glm::vec3(1e18f), 0.0f);
+    }
+    object.group = (uint32_t)mCommands.size() - 1;
+    mObjects.push_back(object);
+}
+
+void GpuCuller::Cull(GLStateCache& cache, const Frustum& frustum)
+{
+    mStats.objects = (unsigned int)mObjects.size();
+    mStats.groups  = (unsigned int)mCommands.size();
+    if (mObjects.empty())
+        return;
+
+    // orphan and refill; both are rewritten every frame
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectBuffer);
+    mObjectCapacity = std::max(mObjectCapacity, mObjects.size());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mObjectCapacity * sizeof(GpuObject), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mObjects.size() * sizeof(GpuObject), mObjects.data());
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+    mCommandCapacity = std::max(mCommandCapacity, mCommands.size());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mCommandCapacity * sizeof(DrawCommand), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mCommands.size() * sizeof(DrawCommand), mCommands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    mInstances.Reserve(mObjects.size());
+    // the shadow passes pointed the mesh VAOs at the queue's own instance buffer
+    mInstances.Invalidate();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mObjectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mInstances.Buffer());
+
+    // only the previous frame's depth, and only for the same set of objects
+    bool useHiZ = mHiZValid && mHiZLayoutHash == mLayoutHash;
+    mHiZValid = false;
+
+    cache.UseProgram(mCullShader->ID);
+    cache.BindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, mHiZTexture);
+    mObjectCountUniform.Set((unsigned int)mObjects.size());
+    glUniform4fv(mFrustumPlanesLocation, Frustum::PLANE_COUNT, &frustum.planes[0][0]);
+    mHiZEnabledUniform.Set(useHiZ);
+    mHiZViewProjectionUniform.Set(mHiZViewProjection);
+    mHiZSizeUniform.Set(glm::vec2((float)mWidth, (float)mHeight));
+    mHiZSamplerUniform.Set((int)HIZ_TEXTURE_UNIT);
+
+    glDispatchCompute(((unsigned int)mObjects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::Draw(unsigned int vao, GLenum mode, uint32_t firstGroup, uint32_t groupCount)
+{
+    // base instance does the per-command offset, so every VAO points at instance 0
+    mInstances.Attach(vao, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+    glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)(firstGroup * sizeof(DrawCommand)),
+                                (GLsizei)groupCount, sizeof(DrawCommand));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    mStats.multiDraws++;
+}
+
+void GpuCuller::BuildHiZ(unsigned int depthTexture, const glm::mat4& viewProjection)
+{
+    glUseProgram(mHiZShader->ID);
+    glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+    mReduceSourceUniform.Set((int)HIZ_TEXTURE_UNIT);
+
+    for (unsigned int level = 0; level < mHiZLevels; ++level)
+    {
+        unsigned int width  = std::max(1u, mWidth >> level);
+        unsigned int height = std::max(1u, mHeight >> level);
+
+        // level 0 copies the depth buffer, every other level reduces the one above it
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : mHiZTexture);
+        mReduceLevelUniform.Set((int)level - 1);
+        glBindImageTexture(0, mHiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + REDUCE_TILE_SIZE - 1) / REDUCE_TILE_SIZE,
+                          (height + REDUCE_TILE_SIZE - 1) / REDUCE_TILE_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    mHiZViewProjection = viewProjection;
+    mHiZLayoutHash = mLayoutHash;
+    mHiZValid = true;
+}
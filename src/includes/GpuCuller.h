@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../helpers/shader.h"
+#include "../helpers/shader_c.h"
+#include "../helpers/bounds.h"
+#include "../helpers/frustum.h"
+#include "GLStateCache.h"
+#include "InstanceBuffer.h"
+
+/**
+ * GL 4.3 GPU-driven path for indexed geometry. The render queue hands over its
+ * instanced batches as draw groups (one indirect command each) and every object
+ * with its world box. A compute shader tests each object against the frustum
+ * and against a Hi-Z pyramid built from last frame's depth, appends survivors
+ * to their command's instance count and writes their instance data in place.
+ * Runs of groups that share program, material and VAO are then drawn with a
+ * single glMultiDrawElementsIndirect; nothing is read back to the CPU.
+ *
+ * Needs compute shaders, SSBOs and base-instance draws; IsSupported() checks
+ * the context version and the queue keeps its CPU path otherwise.
+ */
+class GpuCuller
+{
+public:
+    struct Stats
+    {
+        unsigned int objects;
+        unsigned int groups;
+        unsigned int multiDraws;
+    };
+
+    static bool IsSupported();
+
+    // width/height: size of the depth buffer the Hi-Z pyramid is built from
+    bool Init(unsigned int width, unsigned int height);
+    void Destroy();
+
+    // layoutHash identifies the packet set; Hi-Z from a different one is not trusted
+    void Begin(uint64_t layoutHash);
+    // Opens a draw group (one indirect command); objects added next belong to it
+    void AddGroup(unsigned int indexCount, unsigned int firstIndex, int baseVertex);
+    void AddObject(const glm::mat4& model, const Bounds& worldBounds, const glm::vec3& color);
+
+    // Uploads this frame's objects and commands and runs the culling shader
+    void Cull(GLStateCache& cache, const Frustum& frustum);
+    // One multi-draw over groups [firstGroup, firstGroup + groupCount) of the bound VAO
+    void Draw(unsigned int vao, GLenum mode, uint32_t firstGroup, uint32_t groupCount);
+
+    // Reduces the resolved depth texture into the Hi-Z pyramid for next frame's Cull.
+    // Drives GL directly, so call it after the passes that use the state cache.
+    void BuildHiZ(unsigned int depthTexture, const glm::mat4& viewProjection);
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    // std430 mirrors of the structs in gpu_cull.cs
+    struct GpuObject
+    {
+        glm::mat4 model;
+        glm::vec4 center;
+        glm::vec4 extent;
+        glm::vec4 color;
+        uint32_t  group;
+        uint32_t  pad[3];
+    };
+
+    struct DrawCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t  baseVertex;
+        uint32_t baseInstance;
+    };
+
+    std::unique_ptr<ComputeShader> mCullShader;
+    std::unique_ptr<ComputeShader> mHiZShader;
+
+    Uniform<unsigned int> mObjectCountUniform;
+    int                mFrustumPlanesLocation = -1; // vec4[6]
+    Uniform<bool>      mHiZEnabledUniform;
+    Uniform<glm::mat4> mHiZViewProjectionUniform;
+    Uniform<glm::vec2> mHiZSizeUniform;
+    Uniform<int>       mHiZSamplerUniform;
+    Uniform<int>       mReduceSourceUniform;
+    Uniform<int>       mReduceLevelUniform;
+
+    unsigned int mObjectBuffer  = 0;
+    unsigned int mCommandBuffer = 0;
+    size_t mObjectCapacity  = 0;
+    size_t mCommandCapacity = 0;
+    InstanceBuffer mInstances; // written by the compute shader, read as instanced attributes
+
+    unsigned int mHiZTexture = 0;
+    unsigned int mWidth = 0, mHeight = 0, mHiZLevels = 0;
+    glm::mat4 mHiZViewProjection = glm::mat4(1.0f);
+    bool      mHiZValid = false;
+    uint64_t  mHiZLayoutHash = 0;
+    uint64_t  mLayoutHash = 0;
+
+    std::vector<GpuObject>   mObjects;
+    std::vector<DrawCommand> mCommands;
+    Stats mStats = {};
+};
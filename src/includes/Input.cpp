@@ -1,8 +1,11 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include "../helpers/camera.h"
 
 #include "Input.h"
+#include "DepthPrepass.h"
+#include "ShadowMaps.h"
 
 extern float exposure;
 extern Camera camera;
@@ -15,6 +18,14 @@ extern float lastX;
 extern float lastY;
 
 extern bool showShadow;
+extern float shadowBudgetMs;
+extern int shadowFilter;
+extern int shadowQuality;
+extern bool temporalShadows;
+extern bool occlusionCulling;
+extern bool gpuDrivenCulling;
+extern bool deferredShading[4];
+extern int depthPrepassMode[4];
 
 extern int currentSceneIndex;
 
@@ -62,6 +73,59 @@ if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
         showShadow = !showShadow;
     }
 
+    // Shadow time budget, 1 ms per second held
+    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+        shadowBudgetMs = std::max(shadowBudgetMs - deltaTime, 0.1f);
+    else if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+        shadowBudgetMs = std::min(shadowBudgetMs + deltaTime, 16.0f);
+
+    // Toggle on the key press only, not every frame the key is held
+    static bool occlusionKeyDown = false;
+    bool occlusionKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKey && !occlusionKeyDown)
+        occlusionCulling = !occlusionCulling;
+    occlusionKeyDown = occlusionKey;
+
+    static bool gpuKeyDown = false;
+    bool gpuKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gpuKey && !gpuKeyDown)
+        gpuDrivenCulling = !gpuDrivenCulling;
+    gpuKeyDown = gpuKey;
+
+    // Forward / deferred, for the current scene only
+    static bool deferredKeyDown = false;
+    bool deferredKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (deferredKey && !deferredKeyDown)
+        deferredShading[currentSceneIndex - 1] = !deferredShading[currentSceneIndex - 1];
+    deferredKeyDown = deferredKey;
+
+    // Shadow filter: PCF -> hardware compare -> moments, and its quality: low -> medium -> high
+    static bool filterKeyDown = false;
+    bool filterKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (filterKey && !filterKeyDown)
+        shadowFilter = (shadowFilter + 1) % ShadowMaps::FILTER_COUNT;
+    filterKeyDown = filterKey;
+
+    static bool qualityKeyDown = false;
+    bool qualityKey = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    if (qualityKey && !qualityKeyDown)
+        shadowQuality = (shadowQuality + 1) % ShadowMaps::QUALITY_COUNT;
+    qualityKeyDown = qualityKey;
+
+    // Temporal shadow accumulation in the deferred path
+    static bool temporalKeyDown = false;
+    bool temporalKey = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+    if (temporalKey && !temporalKeyDown)
+        temporalShadows = !temporalShadows;
+    temporalKeyDown = temporalKey;
+
+    // Depth pre-pass: auto -> on -> off, for the current scene only
+    static bool prepassKeyDown = false;
+    bool prepassKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (prepassKey && !prepassKeyDown)
+        depthPrepassMode[currentSceneIndex - 1] = (depthPrepassMode[currentSceneIndex - 1] + 1) % DepthPrepass::MODE_COUNT;
+    prepassKeyDown = prepassKey;
+
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) currentSceneIndex = 1;
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) currentSceneIndex = 2;
     if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) currentSceneIndex = 3;
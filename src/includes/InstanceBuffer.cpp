@@ -0,0 +1,99 @@
+#include "InstanceBuffer.h"
+
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer() : mInit(false), mVBO(0), mCapacity(0) {}
+InstanceBuffer::~InstanceBuffer() {}
+
+bool InstanceBuffer::Init()
+{
+    if (mInit) return true;
+    glGenBuffers(1, &mVBO);
+    mInit = true;
+    return true;
+}
+
+void InstanceBuffer::Destroy()
+{
+    glDeleteBuffers(1, &mVBO);
+    mVBO = 0;
+    mCapacity = 0;
+    mAttached.clear();
+    mInit = false;
+}
+
+void InstanceBuffer::Upload(const std::vector<InstanceData>& instances)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    if (instances.size() > mCapacity)
+    {
+        mCapacity = instances.size() * 2;
+        glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    }
+    else
+    {
+        // orphan so we don't wait on last frame's draws still reading the buffer
+        glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    }
+    if (!instances.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // VAO names may have been recycled since last frame, so re-attach everything
+    mAttached.clear();
+}
+
+void InstanceBuffer::Reserve(size_t count)
+{
+    if (count <= mCapacity)
+        return;
+    mCapacity = count * 2;
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mAttached.clear();
+}
+
+void InstanceBuffer::Attach(unsigned int vao, unsigned int firstInstance)
+{
+    auto it = mAttached.find(vao);
+    if (it != mAttached.end() && it->second == firstInstance)
+        return;
+    bool firstAttach = it == mAttached.end();
+    mAttached[vao] = firstInstance;
+
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t base = firstInstance * sizeof(InstanceData);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    for (unsigned int column = 0; column < 4; ++column)
+    {
+        unsigned int location = MODEL_ATTRIBUTE + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        if (firstAttach)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+    for (unsigned int column = 0; column < 3; ++column)
+    {
+        unsigned int location = NORMAL_ATTRIBUTE + column;
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+        if (firstAttach)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+    glVertexAttribPointer(COLOR_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(base + offsetof(InstanceData, color)));
+    if (firstAttach)
+    {
+        glEnableVertexAttribArray(COLOR_ATTRIBUTE);
+        glVertexAttribDivisor(COLOR_ATTRIBUTE, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Per-instance vertex data. Mirrors the aInstanceModel / aInstanceNormal / aInstanceColor
+// inputs in the vertex shaders.
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::mat3 normalMatrix; // transpose(inverse(mat3(model))), precomputed on the CPU
+    glm::vec3 color;        // DrawPacket::color; light proxies are tinted by it
+};
+
+/**
+ * One streaming vertex buffer holding every instance drawn this frame.
+ * Batches are laid out back to back; since GL 3.3 has no base-instance draw,
+ * Attach() points a VAO's instance attributes at the batch's first instance.
+ */
+class InstanceBuffer
+{
+public:
+    // Attribute locations; mesh vertex attributes use 0..6
+    static const unsigned int MODEL_ATTRIBUTE  = 7;  // mat4, 7..10
+    static const unsigned int NORMAL_ATTRIBUTE = 11; // mat3, 11..13
+    static const unsigned int COLOR_ATTRIBUTE  = 14; // vec3
+
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    bool Init();
+    void Destroy();
+
+    // Replaces the buffer contents (orphaning the old storage) and forgets per-VAO attachments
+    void Upload(const std::vector<InstanceData>& instances);
+
+    // Makes room for count instances without uploading, for buffers the GPU fills itself
+    void Reserve(size_t count);
+    // Forgets per-VAO attachments (after another buffer was attached to the same VAOs)
+    void Invalidate() { mAttached.clear(); }
+
+    // Points the currently bound VAO's instance attributes at firstInstance
+    void Attach(unsigned int vao, unsigned int firstInstance);
+
+    unsigned int Buffer() const { return mVBO; }
+
+private:
+    bool mInit;
+    unsigned int mVBO;
+    size_t mCapacity; // in instances
+
+    // VAO -> first instance its attributes currently point at; shadow passes replay
+    // the same batches per light, so most attaches after the first are skipped
+    std::unordered_map<unsigned int, unsigned int> mAttached;
+};
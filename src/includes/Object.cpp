@@ -1,27 +1,46 @@
 #include "Object.h"
 
-// Forward-declare any globals you need from your main app if you follow
-// the same pattern as your Cube.cpp (e.g., extern int SCR_WIDTH, SCR_HEIGHT; etc.)
-extern int SCR_WIDTH;
-extern int SCR_HEIGHT;
-extern float far_plane;
+#include <map>
 
 // Constructor
 Object::Object(Shader& shader,
                const std::string& modelPath,
+               SceneNode& parent,
                const glm::vec3& position,
                const glm::vec3& rotation,
                const glm::vec3& scale)
     : m_Shader(shader),
-      m_Model(modelPath),   // Load the model once
-      m_Position(position),
-      m_Rotation(rotation),
-      m_Scale(scale)
+      m_Shared(Acquire(modelPath, shader)),   // Load the model once per file
+      m_Node(parent.AddChild(position, rotation, scale))
 {
     // If you need to flip textures or do other one-time config, do it here
     // e.g.: stbi_set_flip_vertically_on_load(true);
 }
 
+std::shared_ptr<Object::SharedModel> Object::Acquire(const std::string& modelPath, const Shader& shader)
+{
+    static std::map<std::pair<std::string, unsigned int>, std::weak_ptr<SharedModel>> cache;
+
+    std::weak_ptr<SharedModel>& slot = cache[{ modelPath, shader.ID }];
+    if (std::shared_ptr<SharedModel> shared = slot.lock())
+        return shared;
+
+    auto shared = std::make_shared<SharedModel>(modelPath);
+
+    // Same unit assignment as Mesh::Draw: texture i on unit i. The sampler locations
+    // wait for the first Submit, so loading never waits for the shader to finish building.
+    shared->materials.resize(shared->model.meshes.size());
+    for (size_t m = 0; m < shared->model.meshes.size(); ++m)
+    {
+        const Mesh& mesh = shared->model.meshes[m];
+        for (unsigned int i = 0; i < mesh.textures.size(); ++i)
+            shared->materials[m].textures.push_back({ i, GL_TEXTURE_2D, mesh.textures[i].id, -1 });
+    }
+
+    slot = shared;
+    return shared;
+}
+
 // Destructor
 Object::~Object()
 {
@@ -32,86 +51,57 @@ Object::~Object()
 // Setters
 void Object::SetPosition(const glm::vec3& pos)
 {
-    m_Position = pos;
+    m_Node->SetPosition(pos);
 }
 
 void Object::SetRotation(const glm::vec3& rot)
 {
-    m_Rotation = rot;
+    m_Node->SetRotation(rot);
 }
 
 void Object::SetScale(const glm::vec3& scl)
 {
-    m_Scale = scl;
+    m_Node->SetScale(scl);
 }
 
 /**
- * Renders the object normally, with your main scene shader that includes
- * lighting and possibly shadows (you'll bind shadow maps externally).
+ * Queues one packet per mesh. The queue sorts them by program/material/mesh,
+ * so every object sharing this model collapses into one instanced draw per mesh.
  */
-void Object::Render(Camera& camera,
-                    const std::vector<glm::vec3>& lightPositions,
-                    const std::vector<glm::vec3>& lightColors)
+void Object::Submit(RenderQueue& queue) const
 {
-    // 1. Activate the shader
-    m_Shader.use();
-
-    // 2. Compute view/projection
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-                                            (float)SCR_WIDTH / (float)SCR_HEIGHT,
-                                            0.1f, far_plane);
-    glm::mat4 view = camera.GetViewMatrix();
-
-    m_Shader.setMat4("projection", projection);
-    m_Shader.setMat4("view", view);
-
-    // 3. Compute the model transform
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, m_Position);
-    model = glm::rotate(model, glm::radians(m_Rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(m_Rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(m_Rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::scale(model, m_Scale);
-
-    m_Shader.setMat4("model", model);
-
-    // 4. Update lighting uniforms (mimic what you did in your Cube class).
-    //    If you have an array of Lights in your shader, update them here:
-    for (unsigned int i = 0; i < lightPositions.size(); i++)
+    if (!m_Shared->resolved)
     {
-        m_Shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-        m_Shader.setVec3("lights[" + std::to_string(i) + "].Color",    lightColors[i]);
+        for (size_t m = 0; m < m_Shared->model.meshes.size(); ++m)
+        {
+            const Mesh& mesh = m_Shared->model.meshes[m];
+            for (MaterialTexture& texture : m_Shared->materials[m].textures)
+                texture.samplerLocation = m_Shader.getUniformLocation(mesh.samplerNames[texture.unit]);
+        }
+        m_Shared->resolved = true;
     }
-    
-    // View position, and far_plane if your fragment shader uses it
-    m_Shader.setVec3("viewPos", camera.Position);
-    m_Shader.setFloat("far_plane", far_plane); // relevant for point shadows
 
-    // 5. Draw the model
-    m_Model.Draw(m_Shader);
+    const glm::mat4& model = GetModelMatrix();
+    for (size_t m = 0; m < m_Shared->model.meshes.size(); ++m)
+    {
+        const Mesh& mesh = m_Shared->model.meshes[m];
+        GeometryArena::Range range = GeometryArena::Get().GetRange(mesh.geometry);
+
+        DrawPacket packet;
+        packet.program       = m_Shader.ID;
+        packet.material      = &m_Shared->materials[m];
+        packet.vao           = mesh.VAO;
+        packet.indexed       = true;
+        packet.first         = range.firstIndex;
+        packet.count         = range.indexCount;
+        packet.baseVertex    = range.baseVertex;
+        packet.transform     = model;
+        packet.bounds        = mesh.bounds;
+        queue.Submit(RENDER_PASS_OPAQUE, packet);
+    }
 }
 
-/**
- * Renders the object to a depth buffer for shadow mapping
- * (similar to your Cube::RenderDepth). 
- * Typically used with a simpler depth-only shader.
- */
-void Object::RenderDepth(Shader& depthShader)
+const glm::mat4& Object::GetModelMatrix() const
 {
-    depthShader.use();
-
-    // Compute the model matrix with the same position/rotation/scale
-    glm::mat4 modelMat = glm::mat4(1.0f);
-    modelMat = glm::translate(modelMat, m_Position);
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    modelMat = glm::rotate(modelMat, glm::radians(m_Rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    modelMat = glm::scale(modelMat, m_Scale);
-
-    depthShader.setMat4("model", modelMat);
-
-    // If your depth shader also needs other uniforms (like "far_plane", "lightPos", etc.), set them too
-
-    // Draw the model with the depth shader
-    m_Model.Draw(depthShader);
+    return m_Node->GetWorldMatrix();
 }
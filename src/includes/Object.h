@@ -3,13 +3,16 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
-#include "../helpers/shader_m.h"
+#include "../helpers/shader.h"
 #include "../helpers/camera.h"
 
 #include "model.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
 
 
 /**
@@ -22,9 +25,11 @@ class Object
 {
 public:
     // Constructor: accepts the shader that will be used to render,
-    // the path to the model file, and optional transforms.
+    // the path to the model file, the scene node to hang the object under,
+    // and optional local transforms.
     Object(Shader& shader,
            const std::string& modelPath,
+           SceneNode& parent,
            const glm::vec3& position  = glm::vec3(0.0f),
            const glm::vec3& rotation  = glm::vec3(0.0f),
            const glm::vec3& scale     = glm::vec3(1.0f));
@@ -32,29 +37,38 @@ public:
     // Destructor
     ~Object();
 
-    // Setters for transformation
+    // Setters for transformation (relative to the parent node)
     void SetPosition(const glm::vec3& pos);
     void SetRotation(const glm::vec3& rot);
     void SetScale   (const glm::vec3& scl);
 
-    // Render the model with lighting
-    void Render(Camera& camera,
-                const std::vector<glm::vec3>& lightPositions,
-                const std::vector<glm::vec3>& lightColors);
+    // Queue one draw packet per mesh. Objects loaded from the same file with the
+    // same shader share meshes and materials, so the queue draws them instanced.
+    void Submit(RenderQueue& queue) const;
 
-    // Render only the depth information (for shadow mapping)
-    void RenderDepth(Shader& depthShader);
+    // World matrix cached by the scene graph
+    const glm::mat4& GetModelMatrix() const;
 
 private:
+    // A loaded model (via Assimp / Model from LearnOpenGL) plus one material per mesh
+    struct SharedModel
+    {
+        explicit SharedModel(const std::string& path) : model(path) {}
+
+        Model                 model;
+        std::vector<Material> materials;
+        bool                  resolved = false; // sampler locations looked up yet
+    };
+
+    // Loads each (file, shader) pair once; later objects reuse it
+    static std::shared_ptr<SharedModel> Acquire(const std::string& modelPath, const Shader& shader);
+
     // Reference to the shader used for normal drawing
     Shader&       m_Shader;
 
-    // The loaded model (via Assimp / Model from LearnOpenGL)
-    Model         m_Model;
+    std::shared_ptr<SharedModel> m_Shared;
 
-    // Transform data
-    glm::vec3     m_Position;
-    glm::vec3     m_Rotation;
-    glm::vec3     m_Scale;
+    // Transform data, owned by the scene graph
+    SceneNode*    m_Node;
 };
 
@@ -0,0 +1,127 @@
+#include "OcclusionCuller.h"
+
+#include "Primitives.h"
+
+// Boxes the camera is in (or nearly, so the near plane clips them) can't be tested
+static const float CAMERA_MARGIN = 0.5f;
+
+bool OcclusionCuller::Init(const Shader& proxyShader)
+{
+    mProgram = proxyShader.ID;
+    mBoxMin = proxyShader.getUniform<glm::vec3>("boxMin");
+    mBoxMax = proxyShader.getUniform<glm::vec3>("boxMax");
+
+    // the proxy box is the shared primitive cube
+    Primitives::Get(PRIMITIVE_CUBE);
+    return mProgram != 0;
+}
+
+void OcclusionCuller::Destroy()
+{
+    Reset();
+}
+
+void OcclusionCuller::Reset()
+{
+    for (PacketState& state : mStates)
+        if (state.query)
+            glDeleteQueries(1, &state.query);
+    mStates.clear();
+}
+
+void OcclusionCuller::BeginFrame(size_t packetCount, uint64_t layoutHash)
+{
+    mFrame++;
+    mStats.tested = mStats.conditional = mStats.skipped = 0;
+
+    if (layoutHash != mLayoutHash || packetCount != mStates.size())
+    {
+        Reset();
+        mStates.resize(packetCount);
+        mLayoutHash = layoutHash;
+        return;
+    }
+
+    for (PacketState& state : mStates)
+    {
+        if (!state.pending)
+            continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint anySamples = 0;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamples);
+        state.occluded = anySamples == 0;
+        state.pending  = false;
+        if (state.gated && state.occluded)
+            mStats.skipped++;
+    }
+}
+
+OcclusionCuller::Decision OcclusionCuller::Classify(uint32_t packet, const Bounds& worldBounds, const glm::vec3& viewPos)
+{
+    PacketState& state = mStates[packet];
+    if (!worldBounds.IsValid())
+        return DRAW;
+
+    if (glm::all(glm::greaterThanEqual(viewPos, worldBounds.min - CAMERA_MARGIN)) &&
+        glm::all(glm::lessThanEqual(viewPos, worldBounds.max + CAMERA_MARGIN)))
+    {
+        state.occluded = false;
+        return DRAW;
+    }
+
+    if (state.occluded)
+        return CONDITIONAL;
+    if (!state.pending && (mFrame + packet) % RETEST_INTERVAL == 0)
+        return DRAW_AND_RETEST;
+    return DRAW;
+}
+
+void OcclusionCuller::BeginProxies(GLStateCache& cache)
+{
+    cache.UseProgram(mProgram);
+    cache.BindVertexArray(Primitives::VertexArray(PRIMITIVE_CUBE));
+    mCube = GeometryArena::Get().GetRange(Primitives::Get(PRIMITIVE_CUBE));
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+}
+
+void OcclusionCuller::IssueQuery(uint32_t packet, const Bounds& worldBounds, bool gatesDraw)
+{
+    PacketState& state = mStates[packet];
+    if (!state.query)
+        glGenQueries(1, &state.query);
+
+    mBoxMin.Set(worldBounds.min);
+    mBoxMax.Set(worldBounds.max);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, state.query);
+    glDrawElementsBaseVertex(GL_TRIANGLES, mCube.indexCount, GL_UNSIGNED_INT,
+                             (void*)(sizeof(unsigned int) * mCube.firstIndex), mCube.baseVertex);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    state.pending = true;
+    state.gated   = gatesDraw;
+    mStats.tested++;
+}
+
+void OcclusionCuller::EndProxies()
+{
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+}
+
+void OcclusionCuller::BeginConditional(uint32_t packet)
+{
+    mStats.conditional++;
+    // GL_QUERY_WAIT stalls the GPU's command stream on the result, never the CPU
+    glBeginConditionalRender(mStates[packet].query, GL_QUERY_WAIT);
+}
+
+void OcclusionCuller::EndConditional() const
+{
+    glEndConditionalRender();
+}
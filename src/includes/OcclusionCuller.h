@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/shader.h"
+#include "../helpers/bounds.h"
+#include "GLStateCache.h"
+#include "GeometryArena.h"
+
+/**
+ * Hardware occlusion culling for the render queue's camera pass, with
+ * temporal coherence. Each packet remembers whether its bounding box was
+ * visible the last time it was tested:
+ *
+ *  - visible packets are drawn normally, and every RETEST_INTERVAL frames
+ *    (staggered across packets) their box is re-tested after the main draws;
+ *  - occluded packets have their box drawn inside a GL_ANY_SAMPLES_PASSED
+ *    query against this frame's depth, and are then drawn under
+ *    glBeginConditionalRender, so the GPU drops them if no sample passed.
+ *
+ * Results are only read once GL reports them available (normally the next
+ * frame), so the CPU never waits on a query. State is per packet index and
+ * is thrown away when the queue's packet layout changes.
+ */
+class OcclusionCuller
+{
+public:
+    static const unsigned int RETEST_INTERVAL = 8;
+
+    enum Decision
+    {
+        DRAW,            // draw in the normal batches
+        DRAW_AND_RETEST, // draw normally, then test the box for next frame
+        CONDITIONAL      // test the box, then draw only if it passed
+    };
+
+    struct Stats
+    {
+        unsigned int tested;      // boxes queried this frame
+        unsigned int conditional; // draws issued under conditional render this frame
+        unsigned int skipped;     // conditional draws the GPU dropped (known one frame late)
+    };
+
+    // proxyShader is occlusion_proxy.vs/.fs with the frame uniform block attached
+    bool Init(const Shader& proxyShader);
+    void Destroy();
+
+    // Reads back whatever results have arrived; resets if the packet layout changed
+    void BeginFrame(size_t packetCount, uint64_t layoutHash);
+    Decision Classify(uint32_t packet, const Bounds& worldBounds, const glm::vec3& viewPos);
+
+    // Proxy boxes: colour and depth writes are off between Begin and End
+    void BeginProxies(GLStateCache& cache);
+    void IssueQuery(uint32_t packet, const Bounds& worldBounds, bool gatesDraw);
+    void EndProxies();
+
+    void BeginConditional(uint32_t packet);
+    void EndConditional() const;
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    struct PacketState
+    {
+        GLuint query    = 0;
+        bool   occluded = false;
+        bool   pending  = false; // query issued, result not read yet
+        bool   gated    = false; // the pending query gates a conditional draw
+    };
+
+    void Reset();
+
+    unsigned int mProgram = 0;
+    GeometryArena::Range mCube = {}; // primitive cube range, looked up per BeginProxies
+    Uniform<glm::vec3> mBoxMin, mBoxMax;
+
+    std::vector<PacketState> mStates;
+    uint64_t     mLayoutHash = 0;
+    unsigned int mFrame = 0;
+    Stats        mStats = {};
+};
@@ -0,0 +1,187 @@
+#include "Primitives.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static const unsigned int SPHERE_STACKS = 16;
+static const unsigned int SPHERE_SLICES = 32;
+
+GeometryArena::Handle Primitives::sHandles[PRIMITIVE_COUNT] = {
+    GeometryArena::INVALID_HANDLE, GeometryArena::INVALID_HANDLE, GeometryArena::INVALID_HANDLE
+};
+
+static VertexLayout LayoutOf(Primitive primitive)
+{
+    return primitive == PRIMITIVE_FULLSCREEN_TRIANGLE ? VERTEX_LAYOUT_SCREEN : VERTEX_LAYOUT_MESH;
+}
+
+GeometryArena::Handle Primitives::Get(Primitive primitive)
+{
+    if (sHandles[primitive] == GeometryArena::INVALID_HANDLE)
+        Upload(primitive);
+    return sHandles[primitive];
+}
+
+unsigned int Primitives::VertexArray(Primitive primitive)
+{
+    return GeometryArena::Get().VertexArray(LayoutOf(primitive));
+}
+
+Bounds Primitives::GetBounds(Primitive primitive)
+{
+    if (primitive == PRIMITIVE_FULLSCREEN_TRIANGLE)
+        return Bounds();
+    return Bounds::FromBox(glm::vec3(-1.0f), glm::vec3(1.0f));
+}
+
+void Primitives::Describe(Primitive primitive, DrawPacket& packet)
+{
+    GeometryArena::Range range = GeometryArena::Get().GetRange(Get(primitive));
+    packet.vao        = VertexArray(primitive);
+    packet.indexed    = true;
+    packet.first      = range.firstIndex;
+    packet.count      = range.indexCount;
+    packet.baseVertex = range.baseVertex;
+    packet.bounds     = GetBounds(primitive);
+}
+
+void Primitives::Draw(Primitive primitive)
+{
+    GeometryArena::Range range = GeometryArena::Get().GetRange(Get(primitive));
+    glBindVertexArray(VertexArray(primitive));
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                             (void*)(sizeof(unsigned int) * range.firstIndex), range.baseVertex);
+    glBindVertexArray(0);
+}
+
+void Primitives::Reset()
+{
+    for (GeometryArena::Handle& handle : sHandles)
+        handle = GeometryArena::INVALID_HANDLE;
+}
+
+void Primitives::Upload(Primitive primitive)
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+
+    if (primitive == PRIMITIVE_CUBE)
+    {
+        // The table Cube and Sun used to upload separately, welded to 24 vertices
+        static const float corners[] = {
+            // positions          // normals           // texture coords
+            // back face
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+            // front face
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+            // left face
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+            // right face
+             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+            // bottom face
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+            // top face
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
+        };
+        std::vector<const float*> unique;
+        for (unsigned int i = 0; i < 36; ++i)
+        {
+            const float* corner = &corners[i * 8];
+            unsigned int index = 0;
+            while (index < unique.size() && std::memcmp(unique[index], corner, 8 * sizeof(float)) != 0)
+                index++;
+            if (index == unique.size())
+            {
+                unique.push_back(corner);
+                Vertex vertex = {};
+                vertex.Position  = glm::vec3(corner[0], corner[1], corner[2]);
+                vertex.Normal    = glm::vec3(corner[3], corner[4], corner[5]);
+                vertex.TexCoords = glm::vec2(corner[6], corner[7]);
+                vertices.push_back(vertex);
+            }
+            indices.push_back(index);
+        }
+    }
+    else if (primitive == PRIMITIVE_SPHERE)
+    {
+        const float pi = 3.14159265358979f;
+        for (unsigned int stack = 0; stack <= SPHERE_STACKS; ++stack)
+        {
+            float v = (float)stack / SPHERE_STACKS;
+            float theta = v * pi;
+            for (unsigned int slice = 0; slice <= SPHERE_SLICES; ++slice)
+            {
+                float u = (float)slice / SPHERE_SLICES;
+                float phi = u * 2.0f * pi;
+                Vertex vertex = {};
+                vertex.Position  = glm::vec3(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+                vertex.Normal    = vertex.Position;
+                vertex.TexCoords = glm::vec2(u, 1.0f - v);
+                vertex.Tangent   = glm::vec3(-std::sin(phi), 0.0f, std::cos(phi));
+                vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+                vertices.push_back(vertex);
+            }
+        }
+        const unsigned int row = SPHERE_SLICES + 1;
+        for (unsigned int stack = 0; stack < SPHERE_STACKS; ++stack)
+        {
+            for (unsigned int slice = 0; slice < SPHERE_SLICES; ++slice)
+            {
+                unsigned int a = stack * row + slice;
+                unsigned int b = a + row;
+                // the pole rows collapse to one point, so skip their degenerate halves
+                if (stack != 0)
+                    indices.insert(indices.end(), { a, b, a + 1 });
+                if (stack != SPHERE_STACKS - 1)
+                    indices.insert(indices.end(), { a + 1, b, b + 1 });
+            }
+        }
+    }
+    else
+    {
+        // One oversized triangle instead of a quad: no diagonal seam for the rasterizer to shade twice
+        const float screen[] = {
+            // positions   // texture coords
+            -1.0f, -1.0f,  0.0f, 0.0f,
+             3.0f, -1.0f,  2.0f, 0.0f,
+            -1.0f,  3.0f,  0.0f, 2.0f
+        };
+        const unsigned int screenIndices[] = { 0, 1, 2 };
+        sHandles[primitive] = GeometryArena::Get().Allocate(VERTEX_LAYOUT_SCREEN, screen, 3, screenIndices, 3);
+        return;
+    }
+
+    sHandles[primitive] = GeometryArena::Get().Allocate(VERTEX_LAYOUT_MESH, vertices.data(), (uint32_t)vertices.size(),
+                                                        indices.data(), (uint32_t)indices.size());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "../helpers/bounds.h"
+#include "GeometryArena.h"
+#include "RenderQueue.h"
+
+enum Primitive
+{
+    PRIMITIVE_CUBE = 0,            // [-1, 1]^3, per-face normals and uvs (mesh layout)
+    PRIMITIVE_SPHERE,              // radius 1, 16 stacks x 32 slices (mesh layout)
+    PRIMITIVE_FULLSCREEN_TRIANGLE, // one triangle covering clip space (screen layout)
+    PRIMITIVE_COUNT
+};
+
+/**
+ * Built-in shapes, uploaded to the geometry arena once on first use and shared
+ * by everything that draws them: cubes, light proxies, the skybox, occlusion
+ * proxies and the fullscreen passes. Ranges are looked up on every call, so
+ * they stay right after the arena repacks.
+ */
+class Primitives
+{
+public:
+    static GeometryArena::Handle Get(Primitive primitive);
+    static unsigned int VertexArray(Primitive primitive);
+    static Bounds GetBounds(Primitive primitive);
+
+    // Fills in the geometry of a packet: VAO, index range, base vertex and local bounds
+    static void Describe(Primitive primitive, DrawPacket& packet);
+    // Binds the primitive's VAO and draws it once, outside the render queue
+    static void Draw(Primitive primitive);
+
+    // Forgets the uploaded shapes; call after GeometryArena::Destroy()
+    static void Reset();
+
+private:
+    static void Upload(Primitive primitive);
+
+    static GeometryArena::Handle sHandles[PRIMITIVE_COUNT];
+};
@@ -0,0 +1,87 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+
+void RangeAllocator::Reset(uint32_t capacity, uint32_t used)
+{
+    mFreeByOffset.clear();
+    mFreeBySize.clear();
+    mCapacity = capacity;
+    mFreeSize = 0;
+    if (used < capacity)
+        Insert(used, capacity - used);
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity)
+{
+    if (newCapacity <= mCapacity)
+        return;
+    uint32_t offset = mCapacity;
+    mCapacity = newCapacity;
+    Free(offset, newCapacity - offset);
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+    if (size == 0)
+        return INVALID;
+    auto fit = mFreeBySize.lower_bound(size);
+    if (fit == mFreeBySize.end())
+        return INVALID;
+
+    uint32_t offset = fit->second;
+    uint32_t blockSize = fit->first;
+    Erase(mFreeByOffset.find(offset));
+    // take the front of the block, the remainder stays free
+    if (blockSize > size)
+        Insert(offset + size, blockSize - size);
+    return offset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+        return;
+
+    // merge with the free block that ends where this one starts ...
+    auto next = mFreeByOffset.lower_bound(offset);
+    if (next != mFreeByOffset.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size  += previous->second;
+            Erase(previous);
+        }
+    }
+    // ... and with the one that starts where it ends
+    if (next != mFreeByOffset.end() && offset + size == next->first)
+    {
+        size += next->second;
+        Erase(next);
+    }
+    Insert(offset, size);
+}
+
+void RangeAllocator::Insert(uint32_t offset, uint32_t size)
+{
+    mFreeByOffset.emplace(offset, size);
+    mFreeBySize.emplace(size, offset);
+    mFreeSize += size;
+}
+
+void RangeAllocator::Erase(std::map<uint32_t, uint32_t>::iterator block)
+{
+    auto range = mFreeBySize.equal_range(block->second);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == block->first)
+        {
+            mFreeBySize.erase(it);
+            break;
+        }
+    }
+    mFreeSize -= block->second;
+    mFreeByOffset.erase(block);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+/**
+ * Best-fit free-list allocator over a range of units [0, capacity), for
+ * sub-allocating elements out of one large GPU buffer. Free blocks are kept
+ * twice: by offset, so a freed block merges with its neighbours in O(log n),
+ * and by size, so the smallest block that fits is found in O(log n).
+ *
+ * The allocator only does the bookkeeping; the caller remembers each
+ * allocation's size and hands it back to Free().
+ */
+class RangeAllocator
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    // Forgets every allocation; [0, used) is taken, the rest of capacity is free
+    void Reset(uint32_t capacity, uint32_t used = 0);
+    // Extends the range to newCapacity; the new tail merges with a free block ending at the old capacity
+    void Grow(uint32_t newCapacity);
+
+    // Offset of a block of size units, or INVALID if no free block is large enough
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset, uint32_t size);
+
+    uint32_t Capacity() const { return mCapacity; }
+    uint32_t FreeSize() const { return mFreeSize; }
+    uint32_t UsedSize() const { return mCapacity - mFreeSize; }
+    uint32_t LargestFreeBlock() const { return mFreeBySize.empty() ? 0 : mFreeBySize.rbegin()->first; }
+    size_t   FreeBlockCount() const { return mFreeByOffset.size(); }
+
+private:
+    void Insert(uint32_t offset, uint32_t size);
+    void Erase(std::map<uint32_t, uint32_t>::iterator block);
+
+    std::map<uint32_t, uint32_t>      mFreeByOffset; // offset -> size
+    std::multimap<uint32_t, uint32_t> mFreeBySize;   // size -> offset
+    uint32_t mCapacity = 0;
+    uint32_t mFreeSize = 0;
+};
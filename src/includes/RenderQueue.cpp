@@ -0,0 +1,527 @@
+#include "RenderQueue.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+
+Material::Material()
+{
+    static uint16_t nextId = 0;
+    id = nextId++;
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, unsigned int program, uint16_t material,
+                              uint16_t geometry, float depth)
+{
+    // non-negative IEEE floats order the same as their bit patterns; the top
+    // 16 bits (exponent + 7 mantissa bits) are plenty for front-to-back order
+    uint32_t depthBits;
+    depth = depth > 0.0f ? depth : 0.0f;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    return ((uint64_t)(pass & 0xF) << 60)
+         | ((uint64_t)(program & 0xFFF) << 48)
+         | ((uint64_t)material << 32)
+         | ((uint64_t)geometry << 16)
+         | (uint64_t)(depthBits >> 16);
+}
+
+// Only needs to keep equal geometry adjacent; CanBatch does the exact comparison
+uint16_t RenderQueue::GeometryId(const DrawPacket& packet)
+{
+    uint32_t h = packet.vao * 2654435761u;
+    h ^= (packet.first + 0x9E3779B9u + (h << 6) + (h >> 2));
+    h ^= (packet.count + 0x9E3779B9u + (h << 6) + (h >> 2));
+    h ^= ((uint32_t)packet.baseVertex + 0x9E3779B9u + (h << 6) + (h >> 2));
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+bool RenderQueue::CanBatch(const DrawPacket& a, const DrawPacket& b)
+{
+    return a.program == b.program && a.material == b.material && a.vao == b.vao
+        && a.mode == b.mode && a.indexed == b.indexed && a.first == b.first
+        && a.count == b.count && a.baseVertex == b.baseVertex && a.castsShadow == b.castsShadow;
+}
+
+bool RenderQueue::Init()
+{
+    return mInstanceBuffer.Init();
+}
+
+void RenderQueue::Destroy()
+{
+    mInstanceBuffer.Destroy();
+}
+
+void RenderQueue::Begin(const glm::vec3& viewPos)
+{
+    mViewPos = viewPos;
+    mFrame++;
+    mPackets.clear();
+    mPasses.clear();
+    mKeys.clear();
+    mBounds.Clear();
+    mUnbounded.clear();
+    mLayoutHash = 0;
+    mCameraStats = {};
+    mShadowStats = {};
+}
+
+void RenderQueue::Submit(RenderPass pass, const DrawPacket& packet)
+{
+    float depth = glm::length(glm::vec3(packet.transform[3]) - mViewPos);
+    uint16_t material = packet.material ? packet.material->id : 0;
+
+    uint16_t geometry = GeometryId(packet);
+
+    mKeys.push_back(MakeKey(pass, packet.program, material, geometry, depth));
+    mPackets.push_back(packet);
+    mPasses.push_back((uint8_t)pass);
+    size_t index = mBounds.Add(packet.bounds, packet.transform);
+    if (!packet.bounds.IsValid())
+        mUnbounded.push_back((uint32_t)index);
+
+    // same packets in the same order hash the same, whatever their transforms
+    mLayoutHash = mLayoutHash * 1099511628211ull + (((uint64_t)material << 16) | geometry) + 1;
+}
+
+void RenderQueue::Sort()
+{
+    SortKeys();
+    UpdateSpatialIndex();
+    UpdateMotion();
+}
+
+void RenderQueue::UpdateMotion()
+{
+    if (mLayoutHash != mMotionLayoutHash || mLastTransforms.size() != mPackets.size())
+    {
+        // a new set of packets starts out static; whatever moves becomes dynamic on its own
+        mLastTransforms.resize(mPackets.size());
+        mMovedFrame.assign(mPackets.size(), mFrame - STATIC_AFTER_FRAMES - 1);
+        for (size_t i = 0; i < mPackets.size(); ++i)
+            mLastTransforms[i] = mPackets[i].transform;
+        mMotionLayoutHash = mLayoutHash;
+        return;
+    }
+
+    for (size_t i = 0; i < mPackets.size(); ++i)
+    {
+        if (mPackets[i].transform != mLastTransforms[i])
+        {
+            mLastTransforms[i] = mPackets[i].transform;
+            mMovedFrame[i] = mFrame;
+        }
+    }
+}
+
+void RenderQueue::UpdateSpatialIndex()
+{
+    mWorldBounds.resize(mBounds.Size());
+    for (size_t i = 0; i < mWorldBounds.size(); ++i)
+        mWorldBounds[i] = mBounds.GetBounds(i);
+
+    if (!mBvh.Empty() && mLayoutHash == mBvhLayoutHash)
+    {
+        mBvh.Refit(mWorldBounds);
+    }
+    else
+    {
+        mBvh.Build(mWorldBounds);
+        mBvhLayoutHash = mLayoutHash;
+    }
+}
+
+size_t RenderQueue::CullFrustum(const Frustum& frustum)
+{
+    if (mPackets.size() < BVH_MIN_PACKETS)
+        return mBounds.CullFrustum(frustum, mVisible);
+
+    mQueryResult.clear();
+    mBvh.QueryFrustum(frustum, mQueryResult);
+    mVisible.assign(mPackets.size(), 0);
+    for (uint32_t i : mQueryResult)
+        mVisible[i] = 1;
+    for (uint32_t i : mUnbounded)
+        mVisible[i] = 1;
+    return mQueryResult.size() + mUnbounded.size();
+}
+
+size_t RenderQueue::ApplyPassFilter()
+{
+    if (mFilter.passMask == ~0u)
+        return 0;
+    size_t cleared = 0;
+    for (uint32_t i = 0; i < mPackets.size(); ++i)
+    {
+        if (mVisible[i] && !PassesFilter(i))
+        {
+            mVisible[i] = 0;
+            cleared++;
+        }
+    }
+    return cleared;
+}
+
+size_t RenderQueue::CullSphere(const glm::vec3& center, float radius)
+{
+    if (mPackets.size() < BVH_MIN_PACKETS)
+        return mBounds.CullSphere(center, radius, mVisible);
+
+    mQueryResult.clear();
+    mBvh.QuerySphere(center, radius, mQueryResult);
+    mVisible.assign(mPackets.size(), 0);
+    for (uint32_t i : mQueryResult)
+        mVisible[i] = 1;
+    for (uint32_t i : mUnbounded)
+        mVisible[i] = 1;
+    return mQueryResult.size() + mUnbounded.size();
+}
+
+// LSD radix sort, one byte per pass. Bytes that are the same for every key
+// (usually pass and most of the program bits) are skipped.
+void RenderQueue::SortKeys()
+{
+    const size_t count = mKeys.size();
+    mOrder.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        mOrder[i] = (uint32_t)i;
+    if (count < 2)
+        return;
+
+    mKeysScratch.resize(count);
+    mOrderScratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < count; ++i)
+            histogram[(mKeys[i] >> shift) & 0xFF]++;
+        if (histogram[(mKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (size_t& bucket : histogram)
+        {
+            size_t n = bucket;
+            bucket = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t dst = histogram[(mKeys[i] >> shift) & 0xFF]++;
+            mKeysScratch[dst]  = mKeys[i];
+            mOrderScratch[dst] = mOrder[i];
+        }
+        mKeys.swap(mKeysScratch);
+        mOrder.swap(mOrderScratch);
+    }
+}
+
+// Collapses runs of identical visible packets into batches and lays their transforms
+// out contiguously (in sorted, i.e. front-to-back, order) for one upload per view.
+// Culled packets in the middle of a run don't split it.
+void RenderQueue::BuildBatches(const std::vector<uint8_t>& visible, bool merge)
+{
+    mBatches.clear();
+    mInstances.clear();
+    mInstances.reserve(mOrder.size());
+
+    for (uint32_t i = 0; i < mOrder.size(); ++i)
+    {
+        const DrawPacket& packet = mPackets[mOrder[i]];
+        if (!visible[mOrder[i]])
+            continue;
+        if (mBatches.empty() || !merge || !CanBatch(mPackets[mOrder[mBatches.back().firstPacket]], packet))
+            mBatches.push_back({ i, 0, (uint32_t)mInstances.size() });
+        mBatches.back().instanceCount++;
+
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(packet.transform)));
+        mInstances.push_back({ packet.transform, normalMatrix, packet.color });
+    }
+
+    mInstanceBuffer.Upload(mInstances);
+}
+
+void RenderQueue::Flush(GLStateCache& cache, const Frustum& frustum, OcclusionCuller* occlusion)
+{
+    size_t visibleCount = CullFrustum(frustum);
+    size_t filtered = ApplyPassFilter();
+    visibleCount -= filtered;
+    mCameraStats.visible += (unsigned int)visibleCount;
+    mCameraStats.culled  += (unsigned int)(mPackets.size() - visibleCount - filtered);
+
+    mOccluded.clear();
+    mRetest.clear();
+    if (occlusion)
+        ClassifyOcclusion(*occlusion);
+
+    BuildBatches(mVisible);
+    DrawBatches(cache, nullptr);
+
+    if (occlusion)
+        FlushOccluded(cache, *occlusion);
+}
+
+void RenderQueue::ClassifyOcclusion(OcclusionCuller& occlusion)
+{
+    occlusion.BeginFrame(mPackets.size(), mLayoutHash);
+    for (uint32_t i = 0; i < mPackets.size(); ++i)
+    {
+        if (!mVisible[i])
+            continue;
+        switch (occlusion.Classify(i, mWorldBounds[i], mViewPos))
+        {
+        case OcclusionCuller::CONDITIONAL:
+            mVisible[i] = 0;
+            mOccluded.push_back(i);
+            break;
+        case OcclusionCuller::DRAW_AND_RETEST:
+            mRetest.push_back(i);
+            break;
+        case OcclusionCuller::DRAW:
+            break;
+        }
+    }
+}
+
+// Runs after everything else is in the depth buffer, so the boxes test against
+// the whole visible scene. All boxes go first so the GPU has the results by the
+// time the gated draws reach it.
+void RenderQueue::FlushOccluded(GLStateCache& cache, OcclusionCuller& occlusion)
+{
+    if (mOccluded.empty() && mRetest.empty())
+        return;
+
+    occlusion.BeginProxies(cache);
+    for (uint32_t i : mOccluded)
+        occlusion.IssueQuery(i, mWorldBounds[i], true);
+    for (uint32_t i : mRetest)
+        occlusion.IssueQuery(i, mWorldBounds[i], false);
+    occlusion.EndProxies();
+
+    if (mOccluded.empty())
+        return;
+
+    mVisible.assign(mPackets.size(), 0);
+    for (uint32_t i : mOccluded)
+        mVisible[i] = 1;
+    BuildBatches(mVisible, false);
+    DrawBatches(cache, &occlusion);
+}
+
+void RenderQueue::FlushIndirect(GLStateCache& cache, GpuCuller& culler, const Frustum& frustum)
+{
+    // The CPU only lays the groups out; visibility is decided on the GPU
+    culler.Begin(mLayoutHash);
+    mIndirectGroups.clear();
+    for (uint32_t i = 0; i < mOrder.size(); ++i)
+    {
+        const DrawPacket& packet = mPackets[mOrder[i]];
+        if (!packet.indexed || !PassesFilter(mOrder[i]))
+            continue;
+        if (mIndirectGroups.empty() || !CanBatch(mPackets[mOrder[mIndirectGroups.back()]], packet))
+        {
+            mIndirectGroups.push_back(i);
+            culler.AddGroup(packet.count, packet.first, packet.baseVertex);
+        }
+        culler.AddObject(packet.transform, mWorldBounds[mOrder[i]], packet.color);
+    }
+    culler.Cull(cache, frustum);
+
+    const Material* boundMaterial = nullptr;
+    unsigned int boundProgram = 0;
+    for (uint32_t group = 0; group < mIndirectGroups.size();)
+    {
+        // groups that differ only in mesh range share one multi-draw
+        const DrawPacket& packet = mPackets[mOrder[mIndirectGroups[group]]];
+        uint32_t end = group + 1;
+        while (end < mIndirectGroups.size())
+        {
+            const DrawPacket& next = mPackets[mOrder[mIndirectGroups[end]]];
+            if (next.program != packet.program || next.material != packet.material ||
+                next.vao != packet.vao || next.mode != packet.mode)
+                break;
+            end++;
+        }
+
+        BindMaterial(cache, packet, boundMaterial, boundProgram);
+        cache.BindVertexArray(packet.vao);
+        culler.Draw(packet.vao, packet.mode, group, end - group);
+        group = end;
+    }
+    // the culler re-pointed mesh VAOs at its own instance buffer
+    mInstanceBuffer.Invalidate();
+
+    // non-indexed packets keep the CPU path
+    size_t visibleCount = CullFrustum(frustum);
+    size_t filtered = 0;
+    for (uint32_t i = 0; i < mPackets.size(); ++i)
+    {
+        if (!PassesFilter(i))
+            filtered++;
+        if (mVisible[i] && (mPackets[i].indexed || !PassesFilter(i)))
+        {
+            mVisible[i] = 0;
+            visibleCount--;
+        }
+    }
+    mCameraStats.visible += (unsigned int)visibleCount;
+    mCameraStats.culled  += (unsigned int)(mPackets.size() - culler.GetStats().objects - visibleCount - filtered);
+    BuildBatches(mVisible);
+    DrawBatches(cache, nullptr);
+}
+
+void RenderQueue::BindMaterial(GLStateCache& cache, const DrawPacket& packet,
+                               const Material*& boundMaterial, unsigned int& boundProgram) const
+{
+    // a swapped-in program sets its own samplers; the material's locations belong to packet.program
+    bool swapped = mFilter.replacement != 0 && (mFilter.program == 0 || packet.program == mFilter.program);
+    cache.UseProgram(swapped ? mFilter.replacement : packet.program);
+
+    // sampler and colour uniforms are program state, so rebind on a program change too
+    if (packet.material && (packet.material != boundMaterial || packet.program != boundProgram))
+    {
+        for (const MaterialTexture& texture : packet.material->textures)
+        {
+            cache.BindTexture(texture.unit, texture.target, texture.id);
+            if (texture.samplerLocation >= 0 && !swapped)
+                glUniform1i(texture.samplerLocation, (int)texture.unit);
+        }
+        if (packet.material->colorLocation >= 0 && !swapped)
+            glUniform3fv(packet.material->colorLocation, 1, glm::value_ptr(packet.material->color));
+    }
+    boundMaterial = packet.material;
+    boundProgram  = packet.program;
+}
+
+void RenderQueue::DrawBatches(GLStateCache& cache, OcclusionCuller* conditional)
+{
+    const Material* boundMaterial = nullptr;
+    unsigned int boundProgram = 0;
+
+    for (const Batch& batch : mBatches)
+    {
+        const DrawPacket& packet = mPackets[mOrder[batch.firstPacket]];
+        BindMaterial(cache, packet, boundMaterial, boundProgram);
+
+        if (conditional)
+        {
+            conditional->BeginConditional(mOrder[batch.firstPacket]);
+            Draw(cache, packet, batch);
+            conditional->EndConditional();
+        }
+        else
+        {
+            Draw(cache, packet, batch);
+        }
+    }
+}
+
+size_t RenderQueue::CasterVersions(const glm::vec3& lightPos, float lightRange,
+                                   uint64_t& staticVersion, uint64_t& dynamicVersion)
+{
+    CullSphere(lightPos, lightRange);
+    staticVersion = dynamicVersion = mLayoutHash;
+    size_t dynamicCount = 0;
+    for (uint32_t i = 0; i < mPackets.size(); ++i)
+    {
+        if (!mVisible[i] || !mPackets[i].castsShadow)
+            continue;
+        uint64_t entry = ((uint64_t)i << 32) | mMovedFrame[i];
+        if (IsStatic(i))
+        {
+            staticVersion = staticVersion * 1099511628211ull + entry + 1;
+        }
+        else
+        {
+            dynamicVersion = dynamicVersion * 1099511628211ull + entry + 1;
+            dynamicCount++;
+        }
+    }
+    return dynamicCount;
+}
+
+void RenderQueue::FlushShadowLayered(GLStateCache& cache, const Shader& depthShader,
+                                     const std::vector<ShadowLight>& lights, CasterSet casters)
+{
+    const size_t packetCount = mPackets.size();
+    mFaceMasks.assign(lights.size() * packetCount, 0);
+    size_t requestedFaces = 0;
+    for (size_t l = 0; l < lights.size(); ++l)
+    {
+        Frustum faces[6];
+        for (int face = 0; face < 6; ++face)
+        {
+            faces[face] = Frustum::FromMatrix(lights[l].faceMatrices[face]);
+            requestedFaces += (lights[l].faces >> face) & 1;
+        }
+
+        // the range sphere first, so only casters near the light pay for the face tests
+        CullSphere(lights[l].position, lights[l].range);
+        uint8_t* masks = &mFaceMasks[l * packetCount];
+        for (uint32_t i = 0; i < packetCount; ++i)
+        {
+            if (!mVisible[i] || !mPackets[i].castsShadow)
+                continue;
+            if (casters != CASTERS_ALL && IsStatic(i) != (casters == CASTERS_STATIC))
+                continue;
+            uint8_t mask = 0;
+            for (int face = 0; face < 6; ++face)
+                if ((lights[l].faces >> face) & 1)
+                    mask |= (uint8_t)(mBounds.InFrustum(i, faces[face]) << face);
+            masks[i] = mask;
+        }
+    }
+
+    // One instance per caster, light and face, in sorted order so identical casters
+    // (with all their faces) stay one batch
+    mBatches.clear();
+    mInstances.clear();
+    for (uint32_t i = 0; i < mOrder.size(); ++i)
+    {
+        const DrawPacket& packet = mPackets[mOrder[i]];
+        bool batched = false;
+        for (size_t l = 0; l < lights.size(); ++l)
+        {
+            uint8_t mask = mFaceMasks[l * packetCount + mOrder[i]];
+            for (int face = 0; mask != 0; ++face, mask >>= 1)
+            {
+                if (!(mask & 1))
+                    continue;
+                if (!batched && (mBatches.empty() || !CanBatch(mPackets[mOrder[mBatches.back().firstPacket]], packet)))
+                    mBatches.push_back({ i, 0, (uint32_t)mInstances.size() });
+                batched = true;
+                mBatches.back().instanceCount++;
+
+                // the depth shaders need no normals, so skip the inverse
+                glm::vec3 layer((float)(lights[l].layerBase + face), (float)(lights[l].matrixBase + face), 0.0f);
+                mInstances.push_back({ packet.transform, glm::mat3(1.0f), layer });
+            }
+        }
+    }
+    mShadowStats.visible += (unsigned int)mInstances.size();
+    mShadowStats.culled  += (unsigned int)(requestedFaces * packetCount - mInstances.size());
+    if (mInstances.empty())
+        return;
+    mInstanceBuffer.Upload(mInstances);
+
+    cache.UseProgram(depthShader.ID);
+    for (const Batch& batch : mBatches)
+        Draw(cache, mPackets[mOrder[batch.firstPacket]], batch);
+}
+
+void RenderQueue::Draw(GLStateCache& cache, const DrawPacket& packet, const Batch& batch)
+{
+    cache.BindVertexArray(packet.vao);
+    mInstanceBuffer.Attach(packet.vao, batch.firstInstance);
+
+    if (packet.indexed)
+        glDrawElementsInstancedBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT,
+                                          (void*)(sizeof(unsigned int) * packet.first), batch.instanceCount,
+                                          packet.baseVertex);
+    else
+        glDrawArraysInstanced(packet.mode, packet.first, packet.count, batch.instanceCount);
+    cache.CountDraw(batch.instanceCount);
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/shader.h"
+#include "../helpers/bounds.h"
+#include "../helpers/frustum.h"
+#include "GLStateCache.h"
+#include "InstanceBuffer.h"
+#include "BoundsTable.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "GpuCuller.h"
+
+// Passes are the most significant part of the sort key, so they draw in this order
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE   = 0, // lit geometry, front to back
+    RENDER_PASS_EMISSIVE = 1  // light proxies (suns)
+};
+
+// Which packets the camera flushes draw, and with which program. The deferred
+// G-buffer pass takes the opaque packets only and swaps the lit program for its
+// own; the depth pre-pass swaps every program for its position-only one.
+struct PassFilter
+{
+    uint32_t     passMask    = ~0u; // bit (1 << pass) per RenderPass drawn
+    unsigned int program     = 0;   // packets with this program (0: any)...
+    unsigned int replacement = 0;   // ...are drawn with this one (0: no swap)
+};
+
+struct MaterialTexture
+{
+    unsigned int unit;
+    GLenum       target;
+    unsigned int id;
+    int          samplerLocation; // -1 if the program doesn't name this texture
+};
+
+// Textures and per-material constants bound once for every run of packets that share them
+struct Material
+{
+    Material();
+
+    uint16_t id; // unique per constructed material; copies share it
+    std::vector<MaterialTexture> textures;
+
+    int       colorLocation = -1;
+    glm::vec3 color         = glm::vec3(1.0f);
+};
+
+struct DrawPacket
+{
+    unsigned int    program       = 0;
+    const Material* material      = nullptr;
+    unsigned int    vao           = 0;
+    GLenum          mode          = GL_TRIANGLES;
+    bool            indexed       = false;
+    unsigned int    first         = 0; // first vertex, or first index when indexed
+    unsigned int    count         = 0;
+    int             baseVertex    = 0; // added to every index (geometry arena ranges)
+    bool            castsShadow   = true;
+    glm::mat4       transform     = glm::mat4(1.0f);
+    glm::vec3       color         = glm::vec3(1.0f); // per instance, so it never splits a batch
+    Bounds          bounds;        // local space; left empty the packet is never culled
+};
+
+// Which shadow casters a depth flush draws; see RenderQueue::IsStatic
+enum CasterSet
+{
+    CASTERS_ALL = 0,
+    CASTERS_STATIC,
+    CASTERS_DYNAMIC
+};
+
+// A point light drawn by RenderQueue::FlushShadowLayered
+struct ShadowLight
+{
+    glm::vec3        position;
+    int              layerBase;    // atlas layer of its +X face (slice * 6)
+    uint32_t         matrixBase;   // its +X face in the ShadowData matrices (light * 6)
+    const glm::mat4* faceMatrices; // its six face view-projections, in cube face order
+    float            range;        // its radius; casters beyond it are skipped
+    uint8_t          faces;        // bit per cube face to draw
+};
+
+/**
+ * Per-frame list of draw packets. Scenes submit packets, the queue radix sorts
+ * them on a 64-bit key (pass | program | material | geometry | depth). Each
+ * flush culls the packets' world bounds against its view, merges the visible
+ * runs that differ only in transform into instanced batches and replays the
+ * batches through a GLStateCache so redundant binds are dropped.
+ *
+ * Key layout, most significant first:
+ *   63..60 pass, 59..48 program, 47..32 material, 31..16 geometry, 15..0 view depth
+ *
+ * Sort() also brings a BVH over the packets' world bounds up to date: refit when
+ * the scene submitted the same packets as last frame, rebuilt otherwise. Culling
+ * walks the BVH once the queue holds BVH_MIN_PACKETS packets; below that a SIMD
+ * scan of the bounds table is cheaper.
+ *
+ * While the packet layout stays the same, Sort() also notes the frame each
+ * packet's transform last changed. Casters that have kept still for
+ * STATIC_AFTER_FRAMES frames count as static, which lets shadow maps cache them.
+ */
+class RenderQueue
+{
+public:
+    bool Init();
+    void Destroy();
+
+    // Clears last frame's packets; depth in the key is measured from viewPos
+    void Begin(const glm::vec3& viewPos);
+    void Submit(RenderPass pass, const DrawPacket& packet);
+    // Sorts the keys and updates the spatial index
+    void Sort();
+
+    // Main pass: packets inside the camera frustum, each batch with its own program and material.
+    // With an occlusion culler, packets found hidden last frame are drawn last, one
+    // by one, each gated on a query against its bounding box.
+    void Flush(GLStateCache& cache, const Frustum& frustum, OcclusionCuller* occlusion = nullptr);
+    // Main pass on the GL 4.3 path: indexed packets are culled on the GPU and drawn with
+    // one multi-draw per program/material/VAO run; the rest go through Flush's CPU path.
+    // Meshes in the geometry arena share their layout's VAO, so a run spans every mesh
+    // with the same program and material.
+    void FlushIndirect(GLStateCache& cache, GpuCuller& culler, const Frustum& frustum);
+    // Shadow pass for several point lights at once into a layered (cube map array) target.
+    // Each caster is tested against every requested face frustum of every light whose range it is in and
+    // gets one instance per face it touches; the instance's colour slot carries
+    // (atlas layer, ShadowData matrix index), which depthShader turns into gl_Layer and
+    // the face transform. Every caster and face goes out in one draw per batch.
+    void FlushShadowLayered(GLStateCache& cache, const Shader& depthShader,
+                            const std::vector<ShadowLight>& lights, CasterSet casters = CASTERS_ALL);
+
+    // Versions of the shadow casters within lightRange of the light, one for the static
+    // set and one for the moving set. A version changes when a caster of its set moves,
+    // enters or leaves the range, or changes set. Returns the number of moving casters.
+    size_t CasterVersions(const glm::vec3& lightPos, float lightRange,
+                          uint64_t& staticVersion, uint64_t& dynamicVersion);
+    bool IsStatic(uint32_t packet) const { return mFrame - mMovedFrame[packet] > STATIC_AFTER_FRAMES; }
+
+    struct CullStats
+    {
+        unsigned int visible;
+        unsigned int culled;
+    };
+    // Per frame; shadow counts are light faces, summed over all lights
+    const CullStats& GetCameraCullStats() const { return mCameraStats; }
+    const CullStats& GetShadowCullStats() const { return mShadowStats; }
+
+    // Applies to Flush and FlushIndirect until changed; FlushShadowLayered draws every caster
+    void SetPassFilter(const PassFilter& filter) { mFilter = filter; }
+
+    size_t Size() const { return mPackets.size(); }
+
+    // BVH over this frame's packets (primitive i = i-th submitted packet), valid after Sort()
+    const Bvh& GetSpatialIndex() const { return mBvh; }
+
+    static uint64_t MakeKey(RenderPass pass, unsigned int program, uint16_t material,
+                            uint16_t geometry, float depth);
+
+private:
+    static const size_t BVH_MIN_PACKETS = 256;
+    static const uint32_t STATIC_AFTER_FRAMES = 30;
+
+    // A run of sorted packets drawn with one instanced call
+    struct Batch
+    {
+        uint32_t firstPacket;   // index into mOrder
+        uint32_t instanceCount;
+        uint32_t firstInstance; // into the instance buffer
+    };
+
+    static uint16_t GeometryId(const DrawPacket& packet);
+    static bool CanBatch(const DrawPacket& a, const DrawPacket& b);
+
+    void SortKeys();
+    void UpdateSpatialIndex();
+    // Compares this frame's transforms with the last frame's
+    void UpdateMotion();
+    // Fill mVisible for the view; return the visible count
+    size_t CullFrustum(const Frustum& frustum);
+    size_t CullSphere(const glm::vec3& center, float radius);
+    bool PassesFilter(uint32_t packet) const { return (mFilter.passMask >> mPasses[packet]) & 1; }
+    // Clears mVisible for the packets the pass filter leaves out; returns how many it cleared
+    size_t ApplyPassFilter();
+
+    // Batches the visible packets (in sorted order) and uploads their instances;
+    // without merge every packet gets its own batch
+    void BuildBatches(const std::vector<uint8_t>& visible, bool merge = true);
+    // Binds each batch's program and material, then draws it (conditionally, given a culler)
+    void DrawBatches(GLStateCache& cache, OcclusionCuller* conditional);
+    // Binds the packet's program (after the filter's swap), and its material unless that is already bound
+    void BindMaterial(GLStateCache& cache, const DrawPacket& packet,
+                      const Material*& boundMaterial, unsigned int& boundProgram) const;
+    // Takes the packets the culler wants gated out of mVisible, into mOccluded / mRetest
+    void ClassifyOcclusion(OcclusionCuller& occlusion);
+    void FlushOccluded(GLStateCache& cache, OcclusionCuller& occlusion);
+    void Draw(GLStateCache& cache, const DrawPacket& packet, const Batch& batch);
+
+    glm::vec3 mViewPos = glm::vec3(0.0f);
+    std::vector<DrawPacket> mPackets;
+    std::vector<uint8_t>    mPasses;   // RenderPass per packet
+    PassFilter              mFilter;
+
+    // sort scratch, kept between frames so steady state doesn't allocate
+    std::vector<uint64_t> mKeys, mKeysScratch;
+    std::vector<uint32_t> mOrder, mOrderScratch;
+
+    BoundsTable mBounds; // world bounds, in submission order
+    std::vector<uint8_t> mVisible;
+
+    Bvh mBvh;
+    std::vector<Bounds>   mWorldBounds;
+    std::vector<uint32_t> mUnbounded;   // packets with empty bounds, never culled
+    std::vector<uint32_t> mQueryResult;
+
+    std::vector<uint32_t> mOccluded;    // drawn under conditional render this frame
+    std::vector<uint32_t> mRetest;      // drawn normally, box re-tested after
+
+    std::vector<uint8_t>  mFaceMasks;   // layered shadows: cube faces per (light, packet)
+
+    std::vector<uint32_t> mIndirectGroups; // sorted index of each GPU draw group's first packet
+    uint64_t mLayoutHash      = 0;      // identifies the sequence of packets submitted this frame
+    uint64_t mBvhLayoutHash   = 0;      // ... and the one the BVH was built for
+
+    uint32_t mFrame = 0;
+    std::vector<glm::mat4> mLastTransforms;  // per packet, as of the last Sort()
+    std::vector<uint32_t>  mMovedFrame;      // frame each packet's transform last changed
+    uint64_t mMotionLayoutHash = 0;
+    CullStats mCameraStats = {};
+    CullStats mShadowStats = {};
+
+    std::vector<Batch> mBatches;
+    std::vector<InstanceData> mInstances;
+    InstanceBuffer mInstanceBuffer;
+};
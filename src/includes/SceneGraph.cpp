@@ -0,0 +1,84 @@
+#include "SceneGraph.h"
+
+SceneNode::SceneNode(SceneGraph& graph, SceneNode* parent)
+    : mGraph(graph), mParent(parent), mQueued(false)
+{
+    MarkDirty();
+}
+
+SceneNode* SceneNode::AddChild(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    mChildren.push_back(std::make_unique<SceneNode>(mGraph, this));
+    SceneNode* child = mChildren.back().get();
+    child->mTransform.setLocalPosition(position);
+    child->mTransform.setLocalRotation(rotation);
+    child->mTransform.setLocalScale(scale);
+    return child;
+}
+
+void SceneNode::SetPosition(const glm::vec3& position)
+{
+    mTransform.setLocalPosition(position);
+    MarkDirty();
+}
+
+void SceneNode::SetRotation(const glm::vec3& rotation)
+{
+    mTransform.setLocalRotation(rotation);
+    MarkDirty();
+}
+
+void SceneNode::SetScale(const glm::vec3& scale)
+{
+    mTransform.setLocalScale(scale);
+    MarkDirty();
+}
+
+void SceneNode::MarkDirty()
+{
+    // Transform raises its own flag; the queue only needs each node once per frame
+    if (!mQueued)
+    {
+        mQueued = true;
+        mGraph.mDirty.push_back(this);
+    }
+}
+
+unsigned int SceneNode::UpdateSubtree()
+{
+    if (mParent)
+        mTransform.computeModelMatrix(mParent->GetWorldMatrix());
+    else
+        mTransform.computeModelMatrix();
+
+    unsigned int touched = 1;
+    for (auto& child : mChildren)
+        touched += child->UpdateSubtree();
+    return touched;
+}
+
+SceneGraph::SceneGraph()
+    : mUpdatedCount(0)
+{
+    mRoot = std::make_unique<SceneNode>(*this, nullptr);
+}
+
+void SceneGraph::Update()
+{
+    mUpdatedCount = 0;
+    for (SceneNode* node : mDirty)
+    {
+        // Skip nodes already refreshed as part of a dirty ancestor's subtree,
+        // and nodes under a dirty ancestor that is still to come in the list
+        bool pending = node->mTransform.isDirty();
+        for (SceneNode* p = node->mParent; pending && p; p = p->mParent)
+            pending = !p->mTransform.isDirty();
+
+        if (pending)
+            mUpdatedCount += node->UpdateSubtree();
+    }
+
+    for (SceneNode* node : mDirty)
+        node->mQueued = false;
+    mDirty.clear();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <learnopengl/transform.h>
+
+class SceneGraph;
+
+/**
+ * A node in the scene hierarchy: a local Transform (position, euler rotation in
+ * degrees, scale) plus a cached world matrix = parent world * local. Setting any
+ * local component only marks the node dirty; the world matrix is recomputed on
+ * the next SceneGraph::Update(). Nodes are owned by their parent and live as
+ * long as the graph, so objects can keep plain pointers to them.
+ */
+class SceneNode
+{
+public:
+    SceneNode(SceneGraph& graph, SceneNode* parent);
+
+    // Creates a child with the given local transform
+    SceneNode* AddChild(const glm::vec3& position = glm::vec3(0.0f),
+                        const glm::vec3& rotation = glm::vec3(0.0f),
+                        const glm::vec3& scale    = glm::vec3(1.0f));
+
+    void SetPosition(const glm::vec3& position);
+    void SetRotation(const glm::vec3& rotation);
+    void SetScale   (const glm::vec3& scale);
+
+    const glm::vec3& GetPosition() const { return mTransform.getLocalPosition(); }
+    const glm::vec3& GetRotation() const { return mTransform.getLocalRotation(); }
+    const glm::vec3& GetScale()    const { return mTransform.getLocalScale(); }
+
+    // Cached world matrix; up to date after SceneGraph::Update()
+    const glm::mat4& GetWorldMatrix() const { return mTransform.getModelMatrix(); }
+    glm::vec3 GetWorldPosition() const { return mTransform.getGlobalPosition(); }
+
+    SceneNode* GetParent() const { return mParent; }
+
+private:
+    friend class SceneGraph;
+
+    void MarkDirty();
+    // Recomputes this node and every descendant; returns the number of nodes touched
+    unsigned int UpdateSubtree();
+
+    SceneGraph& mGraph;
+    SceneNode*  mParent;
+    std::list<std::unique_ptr<SceneNode>> mChildren;
+    Transform   mTransform;
+    bool        mQueued;
+};
+
+/**
+ * Owns the root node and the list of nodes changed since the last update.
+ * Update() walks only the subtrees under those nodes, so a frame where a few
+ * lights move costs a few matrix products, whatever the size of the scene.
+ */
+class SceneGraph
+{
+public:
+    SceneGraph();
+
+    SceneNode& Root() { return *mRoot; }
+
+    // Brings every dirty world matrix up to date
+    void Update();
+
+    // Nodes whose world matrix was recomputed by the last Update()
+    unsigned int GetUpdatedCount() const { return mUpdatedCount; }
+
+private:
+    friend class SceneNode;
+
+    std::unique_ptr<SceneNode> mRoot;
+    std::vector<SceneNode*>    mDirty;
+    unsigned int               mUpdatedCount;
+};
@@ -0,0 +1,516 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../helpers/gl_extensions.h"
+#include "GeometryArena.h"
+#include "Primitives.h"
+
+static const unsigned int MIN_CAPACITY = 4;
+
+bool ShadowMaps::IsSupported()
+{
+    return GLAD_GL_VERSION_4_0 != 0;
+}
+
+bool ShadowMaps::HasVertexLayer()
+{
+    return hasExtension("GL_ARB_shader_viewport_layer_array") || hasExtension("GL_AMD_vertex_shader_layer");
+}
+
+bool ShadowMaps::Init(unsigned int size, unsigned int maxLights, Shader& blurShader)
+{
+    mSize = size;
+    mLights.resize(maxLights);
+    mSampledSlices.assign(maxLights, -1);
+    mSampledLods.assign(maxLights, 0.0f);
+    mShadowLod = hasExtension("GL_EXT_texture_shadow_lod");
+
+    // Sampler objects, so one atlas can be read plainly and compared at the same time
+    glGenSamplers(1, &mRawSampler);
+    glSamplerParameteri(mRawSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glSamplerParameteri(mRawSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenSamplers(1, &mCompareSampler);
+    // without EXT_texture_shadow_lod the lookup can't name a level, so it must not mipmap
+    glSamplerParameteri(mCompareSampler, GL_TEXTURE_MIN_FILTER, mShadowLod ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+    glSamplerParameteri(mCompareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(mCompareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glSamplerParameteri(mCompareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    for (unsigned int sampler : { mRawSampler, mCompareSampler })
+    {
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    glGenFramebuffers(1, &mFBO);
+    glGenFramebuffers(2, mCopyFBOs);
+
+    mBlurProgram = blurShader.ID;
+    blurShader.use();
+    blurShader.setInt("moments", MOMENTS_TEXTURE_UNIT);
+    blurShader.setInt("blurTemp", BLUR_TEXTURE_UNIT);
+    mBlurPass   = blurShader.getUniform<int>("blurPass");
+    mBlurFace   = blurShader.getUniform<int>("face");
+    mBlurRadius = blurShader.getUniform<int>("radius");
+    mBlurSlice  = blurShader.getUniform<float>("slice");
+    mBlurLod    = blurShader.getUniform<float>("lod");
+    mBlurSize   = blurShader.getUniform<float>("size");
+    glUseProgram(0);
+
+    glGenTextures(1, &mBlurTemp);
+    glBindTexture(GL_TEXTURE_2D, mBlurTemp);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, size, size, 0, GL_RG, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(2, mBlurFBOs);
+    glBindFramebuffer(GL_FRAMEBUFFER, mBlurFBOs[0]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mBlurTemp, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    Resize(MIN_CAPACITY);
+    return mFBO != 0 && mScheduler.Init();
+}
+
+void ShadowMaps::Destroy()
+{
+    mScheduler.Destroy();
+    glDeleteTextures(1, &mAtlas);
+    glDeleteTextures(1, &mMoments);
+    glDeleteTextures(1, &mBlurTemp);
+    glDeleteSamplers(1, &mRawSampler);
+    glDeleteSamplers(1, &mCompareSampler);
+    glDeleteFramebuffers(1, &mFBO);
+    glDeleteFramebuffers(2, mCopyFBOs);
+    glDeleteFramebuffers(2, mBlurFBOs);
+    mAtlas = mMoments = mBlurTemp = mRawSampler = mCompareSampler = 0;
+    mFBO = mCopyFBOs[0] = mCopyFBOs[1] = mBlurFBOs[0] = mBlurFBOs[1] = 0;
+    mCapacity = 0;
+    mFreeSlices.clear();
+    mLights.clear();
+}
+
+void ShadowMaps::SetFilter(Filter filter, Quality quality)
+{
+    bool moments = filter == FILTER_MOMENTS;
+    bool rebuild = moments != (mFilter == FILTER_MOMENTS) || (moments && quality != mQuality);
+    // compared lookups without EXT_texture_shadow_lod only read level 0, so the levels change too
+    bool relevel = !mShadowLod && (filter == FILTER_COMPARE) != (mFilter == FILTER_COMPARE);
+    mFilter  = filter;
+    mQuality = quality;
+    if (rebuild)
+        Resize(mCapacity);
+    else if (relevel)
+        Invalidate();
+}
+
+int ShadowMaps::FilterTaps(Filter filter, Quality quality)
+{
+    // compare taps each filter 2x2 texels, so they need fewer
+    static const int pcfTaps[QUALITY_COUNT]     = { 4, 8, 20 };
+    static const int compareTaps[QUALITY_COUNT] = { 0, 4, 8 };
+    return filter == FILTER_COMPARE ? compareTaps[quality] : pcfTaps[quality];
+}
+
+ShaderDefines ShadowMaps::LitDefines(bool shadows, Filter filter, Quality quality)
+{
+    ShaderDefines defines = { { "SHADOWS", shadows ? "1" : "0" } };
+    if (shadows)
+    {
+        defines["SHADOW_FILTER"] = std::to_string(filter);
+        // moments read one filtered texel, whatever the quality
+        if (filter != FILTER_MOMENTS)
+            defines["SHADOW_TAPS"] = std::to_string(FilterTaps(filter, quality));
+    }
+    return defines;
+}
+
+void ShadowMaps::SetSamplers(Shader& shader)
+{
+    shader.use();
+    shader.setInt("shadowAtlas", ATLAS_TEXTURE_UNIT);
+    shader.setInt("shadowAtlasCompare", COMPARE_TEXTURE_UNIT);
+    shader.setInt("shadowMoments", MOMENTS_TEXTURE_UNIT);
+}
+
+void ShadowMaps::Invalidate()
+{
+    for (LightCache& light : mLights)
+        light.valid = false;
+    // the lights in the slots may be different ones now
+    mScheduler.Reset();
+}
+
+float ShadowMaps::LightCoverage(const glm::vec3& lightPos, float radius,
+                                const glm::vec3& viewPos, float tanHalfFov)
+{
+    float distance = glm::length(lightPos - viewPos);
+    if (distance <= radius)
+        return 1.0f;
+    return radius / (distance * tanHalfFov);
+}
+
+unsigned int ShadowMaps::CoverageLod(float coverage)
+{
+    if (coverage >= 1.0f)
+        return 0;
+    int lod = (int)std::floor(-std::log2(std::max(coverage, 1e-6f)));
+    return (unsigned int)std::min(lod, (int)SHADOW_LEVELS - 1);
+}
+
+void ShadowMaps::Resize(unsigned int capacity)
+{
+    // One cube map array with SHADOW_LEVELS levels; filtering is up to the sampler objects
+    auto createAtlas = [&](unsigned int& texture, GLenum internalFormat, GLenum format)
+    {
+        glDeleteTextures(1, &texture);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, texture);
+        for (unsigned int level = 0; level < SHADOW_LEVELS; ++level)
+        {
+            unsigned int size = std::max(mSize >> level, 1u);
+            glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, internalFormat, size, size, capacity * 6,
+                         0, format, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, SHADOW_LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+    };
+    // float depth: the face projections spread 1..1000 over it very unevenly
+    createAtlas(mAtlas, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT);
+    if (mFilter == FILTER_MOMENTS)
+        createAtlas(mMoments, GL_RG32F, GL_RG);
+    else
+    {
+        glDeleteTextures(1, &mMoments);
+        mMoments = 0;
+    }
+
+    // Hand the live slices out again from 0 up; their contents went with the old atlas
+    mCapacity = capacity;
+    int next = 0;
+    for (LightCache& light : mLights)
+    {
+        if (light.staticSlice >= 0)
+            light.staticSlice = next++;
+        if (light.dynamicSlice >= 0)
+            light.dynamicSlice = next++;
+        light.valid = false;
+    }
+    mFreeSlices.clear();
+    for (int slice = (int)capacity - 1; slice >= next; --slice)
+        mFreeSlices.push_back(slice);
+
+    size_t levelBytes = (size_t)mSize * mSize * (mMoments ? 4 + 8 : 4);
+    mStats.atlasBytes = 0;
+    for (unsigned int level = 0; level < SHADOW_LEVELS; ++level)
+        mStats.atlasBytes += (levelBytes >> (2 * level)) * 6 * capacity;
+}
+
+int ShadowMaps::AllocateSlice()
+{
+    if (mFreeSlices.empty())
+        Resize(mCapacity * 2);
+    int slice = mFreeSlices.back();
+    mFreeSlices.pop_back();
+    return slice;
+}
+
+void ShadowMaps::FreeSlice(int& slice)
+{
+    if (slice < 0)
+        return;
+    mFreeSlices.push_back(slice);
+    slice = -1;
+}
+
+void ShadowMaps::AttachTargets(unsigned int lod, int layer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+    // every attachment layered or none, or the framebuffer is incomplete
+    auto attach = [&](GLenum attachment, unsigned int texture)
+    {
+        if (texture == 0)
+            glFramebufferTexture(GL_FRAMEBUFFER, attachment, 0, 0);
+        else if (layer < 0)
+            glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture, lod);
+        else
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, texture, lod, layer);
+    };
+    attach(GL_DEPTH_ATTACHMENT, mAtlas);
+    attach(GL_COLOR_ATTACHMENT0, mMoments);
+    glDrawBuffer(mMoments ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+    glReadBuffer(GL_NONE);
+}
+
+void ShadowMaps::ClearFaces(int slice, unsigned int lod, uint8_t faces)
+{
+    // a layered attachment would clear every slice, so clear the layers one by one
+    static const float farDepth = 1.0f;
+    static const float farMoments[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    for (unsigned int face = 0; face < 6; ++face)
+    {
+        if (!((faces >> face) & 1))
+            continue;
+        AttachTargets(lod, slice * 6 + face);
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+        if (mMoments)
+            glClearBufferfv(GL_COLOR, 0, farMoments);
+    }
+}
+
+void ShadowMaps::CopyFaces(int source, int destination, unsigned int lod, uint8_t faces)
+{
+    unsigned int size = std::max(mSize >> lod, 1u);
+    if (GLAD_GL_VERSION_4_3)
+    {
+        for (unsigned int face = 0; face < 6; ++face)
+        {
+            if (!((faces >> face) & 1))
+                continue;
+            for (unsigned int texture : { mAtlas, mMoments })
+            {
+                if (texture != 0)
+                    glCopyImageSubData(texture, GL_TEXTURE_CUBE_MAP_ARRAY, lod, 0, 0, source * 6 + face,
+                                       texture, GL_TEXTURE_CUBE_MAP_ARRAY, lod, 0, 0, destination * 6 + face, size, size, 1);
+            }
+        }
+        return;
+    }
+
+    // GL 4.0-4.2: blit layer by layer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mCopyFBOs[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mCopyFBOs[1]);
+    glReadBuffer(mMoments ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+    glDrawBuffer(mMoments ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+    for (unsigned int face = 0; face < 6; ++face)
+    {
+        if (!((faces >> face) & 1))
+            continue;
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mAtlas, lod, source * 6 + face);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mAtlas, lod, destination * 6 + face);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMoments, lod, source * 6 + face);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMoments, lod, destination * 6 + face);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, size, size,
+                          GL_DEPTH_BUFFER_BIT | (mMoments ? GL_COLOR_BUFFER_BIT : 0), GL_NEAREST);
+    }
+}
+
+void ShadowMaps::BlurFaces(GLStateCache& cache, int slice, unsigned int lod, uint8_t faces)
+{
+    static const int blurRadius[QUALITY_COUNT] = { 1, 2, 4 };
+    unsigned int size = std::max(mSize >> lod, 1u);
+    GeometryArena::Range triangle = GeometryArena::Get().GetRange(Primitives::Get(PRIMITIVE_FULLSCREEN_TRIANGLE));
+
+    cache.UseProgram(mBlurProgram);
+    cache.BindVertexArray(Primitives::VertexArray(PRIMITIVE_FULLSCREEN_TRIANGLE));
+    cache.BindTexture(BLUR_TEXTURE_UNIT, GL_TEXTURE_2D, mBlurTemp);
+    mBlurRadius.Set(blurRadius[mQuality]);
+    mBlurSlice.Set((float)slice);
+    mBlurLod.Set((float)lod);
+    mBlurSize.Set((float)size);
+    glViewport(0, 0, size, size);
+    glDisable(GL_DEPTH_TEST);
+    for (unsigned int face = 0; face < 6; ++face)
+    {
+        if (!((faces >> face) & 1))
+            continue;
+        mBlurFace.Set((int)face);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            // the face is written in the second pass, so it must not be bound for reading then
+            if (pass == 0)
+                glBindFramebuffer(GL_FRAMEBUFFER, mBlurFBOs[0]);
+            else
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, mBlurFBOs[1]);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMoments, lod, slice * 6 + face);
+            }
+            cache.BindTexture(MOMENTS_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, pass == 0 ? mMoments : 0);
+            mBlurPass.Set(pass);
+            glDrawElementsBaseVertex(GL_TRIANGLES, triangle.indexCount, GL_UNSIGNED_INT,
+                                     (void*)(sizeof(unsigned int) * triangle.firstIndex), triangle.baseVertex);
+            cache.CountDraw();
+        }
+    }
+    glEnable(GL_DEPTH_TEST);
+}
+
+void ShadowMaps::Update(GLStateCache& cache, RenderQueue& queue, const Shader& depthShader,
+                        const std::vector<glm::vec3>& positions, const std::vector<float>& coverage,
+                        const glm::mat4* faceMatrices, const std::vector<float>& ranges, size_t lightCount)
+{
+    mStats.staticFaces = mStats.dynamicFaces = mStats.cachedLights = 0;
+    lightCount = std::min(std::min(lightCount, mLights.size()), ranges.size());
+
+    // Lights that went away give their slices back; shrink once the atlas is mostly empty
+    for (size_t n = lightCount; n < mLights.size(); ++n)
+    {
+        FreeSlice(mLights[n].staticSlice);
+        FreeSlice(mLights[n].dynamicSlice);
+        mSampledSlices[n] = -1;
+    }
+    unsigned int used = mCapacity - (unsigned int)mFreeSlices.size();
+    if (mCapacity > MIN_CAPACITY && used * 4 <= mCapacity)
+        Resize(std::max(mCapacity / 2, MIN_CAPACITY));
+
+    // Allocate every slice before deciding what is stale: growing the atlas drops all cached slices
+    std::vector<uint64_t> staticVersions(lightCount), dynamicVersions(lightCount);
+    for (size_t n = 0; n < lightCount; ++n)
+    {
+        LightCache& light = mLights[n];
+        size_t dynamicCount = queue.CasterVersions(positions[n], ranges[n], staticVersions[n], dynamicVersions[n]);
+        if (light.staticSlice < 0)
+        {
+            light.staticSlice = AllocateSlice();
+            light.valid = false;
+        }
+        if (dynamicCount > 0 && light.dynamicSlice < 0)
+        {
+            light.dynamicSlice = AllocateSlice();
+            light.dynamicReady = false;
+            light.stale = ALL_FACES;
+            // static moments were blurred in place; the dynamic pass blurs its copy of them again
+            if (mMoments)
+                light.staleStatic = ALL_FACES;
+        }
+        if (dynamicCount == 0 && light.dynamicSlice >= 0)
+        {
+            FreeSlice(light.dynamicSlice);
+            light.dynamicReady = false;
+            // static moments are only blurred when nothing is drawn over them
+            if (mMoments)
+                light.staleStatic = ALL_FACES;
+        }
+    }
+
+    unsigned int maxLod = (mFilter == FILTER_COMPARE && !mShadowLod) ? 0 : SHADOW_LEVELS - 1;
+    mRequests.resize(lightCount);
+    for (size_t n = 0; n < lightCount; ++n)
+    {
+        LightCache& light = mLights[n];
+        float lightCoverage = n < coverage.size() ? coverage[n] : 1.0f;
+        unsigned int lod = std::min(CoverageLod(lightCoverage), maxLod);
+        bool changed = !light.valid || positions[n] != light.position || ranges[n] != light.range ||
+                       lod != light.renderLod || staticVersions[n] != light.staticVersion;
+        if (!light.valid)
+            light.staticReady = light.dynamicReady = false;
+        if (changed)
+        {
+            light.staleStatic = ALL_FACES;
+            light.renderLod   = lod;
+        }
+        if (light.dynamicSlice >= 0 && dynamicVersions[n] != light.dynamicVersion)
+        {
+            light.stale = ALL_FACES;
+            changed = true;
+        }
+        light.stale |= light.staleStatic;
+        if (light.dynamicSlice < 0)
+            light.stale = light.staleStatic;
+
+        light.position       = positions[n];
+        light.range          = ranges[n];
+        light.staticVersion  = staticVersions[n];
+        light.dynamicVersion = dynamicVersions[n];
+        light.valid          = true;
+        mRequests[n] = { (uint32_t)n, lightCoverage, changed, light.stale };
+        if (light.stale == 0)
+            mStats.cachedLights++;
+    }
+    mScheduler.Schedule(mRequests, mScheduledFaces);
+
+    // A layered attachment is one level, so lights are batched per level
+    unsigned int scheduled = mScheduler.GetStats().facesRendered;
+    if (scheduled > 0)
+    {
+        mScheduler.BeginTiming();
+        for (unsigned int lod = 0; lod < SHADOW_LEVELS; ++lod)
+        {
+            unsigned int size = std::max(mSize >> lod, 1u);
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                bool dynamicPass = pass == 1;
+                mPassLights.clear();
+                mPassIndices.clear();
+                for (size_t n = 0; n < lightCount; ++n)
+                {
+                    const LightCache& light = mLights[n];
+                    if (light.renderLod != lod)
+                        continue;
+                    // moving casters are redrawn on every scheduled face, over a fresh copy of the static one
+                    uint8_t faces = dynamicPass ? (light.dynamicSlice >= 0 ? mScheduledFaces[n] : 0)
+                                                : (uint8_t)(mScheduledFaces[n] & light.staleStatic);
+                    if (faces == 0)
+                        continue;
+                    int slice = dynamicPass ? light.dynamicSlice : light.staticSlice;
+                    if (dynamicPass)
+                        CopyFaces(light.staticSlice, slice, lod, faces);
+                    else
+                        ClearFaces(slice, lod, faces);
+                    mPassLights.push_back({ positions[n], slice * 6, (uint32_t)(n * 6), faceMatrices + n * 6, ranges[n], faces });
+                    mPassIndices.push_back(n);
+                    for (; faces != 0; faces &= faces - 1)
+                        (dynamicPass ? mStats.dynamicFaces : mStats.staticFaces)++;
+                }
+                if (mPassLights.empty())
+                    continue;
+
+                AttachTargets(lod, -1);
+                glViewport(0, 0, size, size);
+                queue.FlushShadowLayered(cache, depthShader, mPassLights,
+                                         dynamicPass ? CASTERS_DYNAMIC : CASTERS_STATIC);
+
+                // prefilter the moments of each finished face: the slice that is sampled
+                if (mMoments)
+                {
+                    for (size_t k = 0; k < mPassLights.size(); ++k)
+                    {
+                        if (dynamicPass || mLights[mPassIndices[k]].dynamicSlice < 0)
+                            BlurFaces(cache, mPassLights[k].layerBase / 6, lod, mPassLights[k].faces);
+                    }
+                }
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        mScheduler.EndTiming(scheduled);
+    }
+
+    // A level is sampled once all its faces are in; until then the last complete one is
+    for (size_t n = 0; n < lightCount; ++n)
+    {
+        LightCache& light = mLights[n];
+        light.staleStatic &= ~mScheduledFaces[n];
+        light.stale       &= ~mScheduledFaces[n];
+        if (light.stale == 0)
+        {
+            light.lod          = light.renderLod;
+            light.staticReady  = true;
+            light.dynamicReady = light.dynamicSlice >= 0;
+        }
+        if (light.dynamicReady)
+            mSampledSlices[n] = light.dynamicSlice;
+        else
+            mSampledSlices[n] = light.staticReady ? light.staticSlice : -1;
+        mSampledLods[n] = (float)light.lod;
+    }
+
+    mStats.slicesAllocated = mCapacity;
+    mStats.slicesUsed = mCapacity - (unsigned int)mFreeSlices.size();
+}
+
+void ShadowMaps::Bind(GLStateCache& cache) const
+{
+    cache.BindTexture(ATLAS_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, mAtlas);
+    cache.BindTexture(COMPARE_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, mAtlas);
+    cache.BindTexture(MOMENTS_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, mMoments);
+    glBindSampler(ATLAS_TEXTURE_UNIT, mRawSampler);
+    glBindSampler(COMPARE_TEXTURE_UNIT, mCompareSampler);
+}
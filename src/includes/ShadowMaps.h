@@ -0,0 +1,189 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../helpers/shader.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "ShadowScheduler.h"
+
+/**
+ * Point light shadows in one cube-map-array atlas, cached between frames.
+ *
+ * Atlas slices (six layers each) are handed out on demand, so shadow memory
+ * follows the lights that are active; the array grows by doubling and shrinks
+ * by half once it is a quarter used. Every slice has SHADOW_LEVELS mip levels.
+ * A light renders into and is sampled from the level that matches its screen
+ * coverage (CoverageLod()), so a small or distant light costs a quarter or less
+ * of a full-size map. The slice and level go to the shaders through the light
+ * block, and the whole atlas is one sampler on ATLAS_TEXTURE_UNIT.
+ *
+ * Each light keeps a slice of its static casters (RenderQueue::IsStatic). Its
+ * faces go stale when the light moves, changes level or the static casters
+ * within its range change (RenderQueue::CasterVersions). When moving casters
+ * are in range, the static slice is copied into a second slice and they are
+ * drawn over it; that slice is sampled instead. When nothing in range changed
+ * the light costs nothing, so shadows in a static scene are rendered once.
+ *
+ * Stale faces are not necessarily redrawn at once: the ShadowScheduler picks
+ * which ones fit this frame's time budget. A light moving to a new level keeps
+ * sampling the old one until every face of the new one has been drawn.
+ *
+ * Everything that needs drawing goes out through RenderQueue::FlushShadowLayered:
+ * one layered pass per atlas level for all lights' static casters, and one for
+ * their moving casters, each caster instanced once per cube face it touches.
+ *
+ * The atlas holds hardware depth (the depth pass writes no gl_FragDepth, so it
+ * keeps early-Z) and is bound twice: plainly for manual PCF and through a
+ * comparison sampler for hardware PCF. FILTER_MOMENTS adds a second atlas of
+ * (distance, distance^2), blurred once per redrawn face, so shading takes one
+ * filtered fetch per light; it only exists while that filter is selected.
+ */
+class ShadowMaps
+{
+public:
+    static const unsigned int SHADOW_LEVELS        = 4;
+    static const unsigned int ATLAS_TEXTURE_UNIT   = 9;  // samplerCubeArray shadowAtlas
+    static const unsigned int COMPARE_TEXTURE_UNIT = 10; // samplerCubeArrayShadow shadowAtlasCompare
+    static const unsigned int MOMENTS_TEXTURE_UNIT = 11; // samplerCubeArray shadowMoments
+    static const unsigned int BLUR_TEXTURE_UNIT    = 4;  // shadow_blur.fs scratch
+    static const uint8_t      ALL_FACES            = 0x3F;
+
+    // Matches SHADOW_FILTER_* in the shaders
+    enum Filter
+    {
+        FILTER_PCF = 0, // manual depth comparisons
+        FILTER_COMPARE, // hardware comparisons, each a bilinear 2x2 PCF
+        FILTER_MOMENTS, // variance shadow map, one fetch
+        FILTER_COUNT
+    };
+
+    // Picks the PCF disk taps, or the moments blur radius
+    enum Quality
+    {
+        QUALITY_LOW = 0,
+        QUALITY_MEDIUM,
+        QUALITY_HIGH,
+        QUALITY_COUNT
+    };
+
+    struct Stats
+    {
+        unsigned int staticFaces;  // faces of static slices redrawn this frame
+        unsigned int dynamicFaces; // faces that had moving casters redrawn
+        unsigned int cachedLights; // lights with nothing stale
+        unsigned int slicesUsed;
+        unsigned int slicesAllocated;
+        size_t       atlasBytes;
+    };
+
+    // Cube map arrays need GL 4.0
+    static bool IsSupported();
+    // Whether vertex shaders may write gl_Layer (ARB_shader_viewport_layer_array or
+    // AMD_vertex_shader_layer); without it the depth pass needs its geometry shader
+    static bool HasVertexLayer();
+
+    // size is the face resolution of level 0; blurShader is shadow_blur.vs/.fs
+    bool Init(unsigned int size, unsigned int maxLights, Shader& blurShader);
+    void Destroy();
+
+    // Forgets every cached map (e.g. after a scene switch)
+    void Invalidate();
+
+    // Fraction of the screen height a light of the given radius spans from viewPos
+    // (1 or more when the camera is inside it); tanHalfFov is tan(fovY / 2)
+    static float LightCoverage(const glm::vec3& lightPos, float radius,
+                               const glm::vec3& viewPos, float tanHalfFov);
+    // Atlas level for that coverage: each halving drops a level
+    static unsigned int CoverageLod(float coverage);
+
+    // Brings the first lightCount lights' slices up to date, as far as the scheduler's budget
+    // allows (lights past that release theirs). coverage is each light's LightCoverage(),
+    // faceMatrices six face view-projections per light (as uploaded to the ShadowData block),
+    // ranges each light's radius, the far plane of those matrices.
+    void Update(GLStateCache& cache, RenderQueue& queue, const Shader& depthShader,
+                const std::vector<glm::vec3>& positions, const std::vector<float>& coverage,
+                const glm::mat4* faceMatrices, const std::vector<float>& ranges, size_t lightCount);
+
+    // Switching to or from FILTER_MOMENTS, or its quality, drops every cached map
+    void SetFilter(Filter filter, Quality quality);
+    Filter GetFilter() const { return mFilter; }
+    // Disk taps besides the centre for the PCF filters (ShadowData shadowTaps)
+    int FilterTaps() const { return FilterTaps(mFilter, mQuality); }
+    static int FilterTaps(Filter filter, Quality quality);
+    // The lit shader (bloom.fs) permutation for a shadow setup: SHADOWS, SHADOW_FILTER, SHADOW_TAPS
+    static ShaderDefines LitDefines(bool shadows, Filter filter, Quality quality);
+
+    // Points the three shadow samplers' units at the atlases
+    void Bind(GLStateCache& cache) const;
+    // Sets the shadowAtlas* sampler uniforms of a shading program
+    static void SetSamplers(Shader& shader);
+    // Per light: atlas slice to sample (-1: none yet) and its level, for UniformBuffers::UpdateLights
+    const std::vector<int>&   Slices() const { return mSampledSlices; }
+    const std::vector<float>& Lods() const   { return mSampledLods; }
+    const Stats& GetStats() const { return mStats; }
+
+    ShadowScheduler& GetScheduler() { return mScheduler; }
+
+private:
+    struct LightCache
+    {
+        int          staticSlice  = -1;
+        int          dynamicSlice = -1; // only while moving casters are in range
+        unsigned int lod          = 0;  // level the sampled slices are complete at
+        unsigned int renderLod    = 0;  // level stale faces are drawn at
+        glm::vec3    position     = glm::vec3(0.0f);
+        float        range        = 0.0f; // far plane the slices were drawn with
+        uint64_t     staticVersion  = 0;
+        uint64_t     dynamicVersion = 0;
+        uint8_t      staleStatic  = 0;  // faces whose static casters need drawing
+        uint8_t      stale        = 0;  // ... and whose moving casters do (includes staleStatic)
+        bool         staticReady  = false; // every face drawn at least once at lod
+        bool         dynamicReady = false;
+        bool         valid        = false;
+    };
+
+    int  AllocateSlice();
+    void FreeSlice(int& slice);
+    // Recreates the atlas with room for capacity slices; cached contents are lost
+    void Resize(unsigned int capacity);
+    // Points mFBO at one layer of every atlas (layer >= 0) or all layers of the level
+    void AttachTargets(unsigned int lod, int layer);
+    void ClearFaces(int slice, unsigned int lod, uint8_t faces);
+    void CopyFaces(int source, int destination, unsigned int lod, uint8_t faces);
+    void BlurFaces(GLStateCache& cache, int slice, unsigned int lod, uint8_t faces);
+
+    unsigned int mSize = 0;
+    unsigned int mAtlas = 0;
+    unsigned int mCapacity = 0; // slices
+    std::vector<int> mFreeSlices;
+
+    unsigned int mMoments = 0;       // FILTER_MOMENTS only
+    unsigned int mRawSampler = 0;     // nearest, no comparison
+    unsigned int mCompareSampler = 0; // linear, GL_COMPARE_REF_TO_TEXTURE
+    bool mShadowLod = false;          // EXT_texture_shadow_lod: compared lookups can pick a level
+    Filter  mFilter  = FILTER_COMPARE;
+    Quality mQuality = QUALITY_MEDIUM;
+
+    unsigned int mFBO = 0;
+    unsigned int mCopyFBOs[2] = { 0, 0 }; // read / draw, for the blit fallback
+
+    unsigned int mBlurProgram = 0;
+    unsigned int mBlurTemp = 0;             // RG32F, one face of level 0
+    unsigned int mBlurFBOs[2] = { 0, 0 };   // into mBlurTemp / into a moments layer
+    Uniform<int>   mBlurPass, mBlurFace, mBlurRadius;
+    Uniform<float> mBlurSlice, mBlurLod, mBlurSize;
+    std::vector<LightCache> mLights;
+    std::vector<ShadowLight> mPassLights; // scratch for one layered pass
+    std::vector<size_t>      mPassIndices; // ... and the light index of each
+    std::vector<ShadowScheduler::Request> mRequests;
+    std::vector<uint8_t> mScheduledFaces;
+    std::vector<int>   mSampledSlices;
+    std::vector<float> mSampledLods;
+    ShadowScheduler mScheduler;
+    Stats mStats = {};
+};
@@ -0,0 +1,177 @@
+#include "ShadowScheduler.h"
+
+#include <algorithm>
+
+// Smoothing of the per-light change rate and of the per-face cost
+static const float RATE_SMOOTHING = 0.1f;
+static const float COST_SMOOTHING = 0.2f;
+
+static unsigned int FaceCount(uint8_t faces)
+{
+    unsigned int count = 0;
+    for (; faces != 0; faces &= faces - 1)
+        count++;
+    return count;
+}
+
+// The first face in stale at or after start, wrapping around; stale must not be empty
+static uint8_t NextFace(uint8_t stale, uint8_t start, uint8_t& index)
+{
+    for (uint8_t n = 0; n < 6; ++n)
+    {
+        index = (uint8_t)((start + n) % 6);
+        if (stale & (1u << index))
+            break;
+    }
+    return (uint8_t)(1u << index);
+}
+
+bool ShadowScheduler::Init()
+{
+    glGenQueries(QUERY_RING, mQueries);
+    return mQueries[0] != 0;
+}
+
+void ShadowScheduler::Destroy()
+{
+    glDeleteQueries(QUERY_RING, mQueries);
+    for (unsigned int i = 0; i < QUERY_RING; ++i)
+    {
+        mQueries[i] = 0;
+        mQueryPending[i] = false;
+    }
+}
+
+void ShadowScheduler::ReadTimings()
+{
+    for (unsigned int i = 0; i < QUERY_RING; ++i)
+    {
+        if (!mQueryPending[i])
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(mQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(mQueries[i], GL_QUERY_RESULT, &elapsed);
+        mQueryPending[i] = false;
+
+        mStats.gpuMs = (float)(elapsed / 1.0e6);
+        if (mQueryFaces[i] > 0)
+            mMsPerFace += (mStats.gpuMs / mQueryFaces[i] - mMsPerFace) * COST_SMOOTHING;
+    }
+    mStats.msPerFace = mMsPerFace;
+}
+
+void ShadowScheduler::Schedule(const std::vector<Request>& requests, std::vector<uint8_t>& faces)
+{
+    ReadTimings();
+
+    const size_t count = requests.size();
+    size_t slots = mRate.size();
+    for (const Request& request : requests)
+        slots = std::max(slots, (size_t)request.light + 1);
+    mRate.resize(slots, 1.0f);
+    mWaited.resize(slots, 0);
+    mNextFace.resize(slots, 0);
+    faces.assign(count, 0);
+
+    float budgetFaces = mBudgetMs / std::max(mMsPerFace, 1e-4f);
+    mRanked.clear();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Request& request = requests[i];
+        mRate[request.light] += ((request.changed ? 1.0f : 0.0f) - mRate[request.light]) * RATE_SMOOTHING;
+        if (request.staleFaces == 0)
+            continue;
+        // important lights are never deferred, but still count against the budget
+        if (request.coverage >= IMPORTANT_COVERAGE)
+        {
+            faces[i] = request.staleFaces;
+            budgetFaces -= (float)FaceCount(request.staleFaces);
+        }
+        else
+            mRanked.push_back(i);
+    }
+
+    auto priority = [&](uint32_t i)
+    {
+        uint32_t light = requests[i].light;
+        return requests[i].coverage * (1.0f + mRate[light]) * (1.0f + mWaited[light]);
+    };
+    std::sort(mRanked.begin(), mRanked.end(), [&](uint32_t a, uint32_t b) { return priority(a) > priority(b); });
+
+    auto takeFace = [&](uint32_t i)
+    {
+        uint32_t light = requests[i].light;
+        uint8_t index = 0;
+        faces[i] |= NextFace(requests[i].staleFaces & ~faces[i], mNextFace[light], index);
+        mNextFace[light] = (uint8_t)((index + 1) % 6);
+        budgetFaces -= 1.0f;
+    };
+
+    // the longest-waiting light gets a face whatever the important ones left of the budget
+    if (!mRanked.empty())
+    {
+        uint32_t longest = mRanked[0];
+        for (uint32_t i : mRanked)
+        {
+            if (mWaited[requests[i].light] > mWaited[requests[longest].light])
+                longest = i;
+        }
+        takeFace(longest);
+    }
+
+    // everyone else: rounds of one stale face each, best first, while the budget lasts
+    bool scheduled = true;
+    while (scheduled && budgetFaces >= 1.0f)
+    {
+        scheduled = false;
+        for (uint32_t i : mRanked)
+        {
+            if (budgetFaces < 1.0f)
+                break;
+            if ((requests[i].staleFaces & ~faces[i]) == 0)
+                continue;
+            takeFace(i);
+            scheduled = true;
+        }
+    }
+
+    mStats.facesRendered = mStats.facesDeferred = mStats.lightsDeferred = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t left = requests[i].staleFaces & ~faces[i];
+        mStats.facesRendered += FaceCount(faces[i]);
+        mStats.facesDeferred += FaceCount(left);
+        mStats.lightsDeferred += left != 0 ? 1 : 0;
+        uint32_t light = requests[i].light;
+        mWaited[light] = left != 0 && faces[i] == 0 ? mWaited[light] + 1 : 0;
+    }
+}
+
+void ShadowScheduler::Reset()
+{
+    mRate.clear();
+    mWaited.clear();
+    mNextFace.clear();
+}
+
+void ShadowScheduler::BeginTiming()
+{
+    // with every query of the ring still in flight this frame goes unmeasured
+    mTiming = !mQueryPending[mNextQuery];
+    if (mTiming)
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[mNextQuery]);
+}
+
+void ShadowScheduler::EndTiming(unsigned int faces)
+{
+    if (!mTiming)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    mQueryFaces[mNextQuery] = faces;
+    mQueryPending[mNextQuery] = true;
+    mNextQuery = (mNextQuery + 1) % QUERY_RING;
+    mTiming = false;
+}
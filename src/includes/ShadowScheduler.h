@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Decides which shadow cube faces are re-rendered each frame, so shadow work
+ * stays within a time budget however many lights there are.
+ *
+ * Lights are ranked by screen importance (the fraction of the screen height
+ * their range covers) weighted by how often their shadows change, and by how
+ * many frames have passed since one of their stale faces was last drawn. Lights
+ * covering at least IMPORTANT_COVERAGE of the screen get every stale face
+ * refreshed every frame. The rest share what is left of the budget in rounds of
+ * one face per light, in rank order, while it lasts; distant or slow lights are
+ * brought up to date over several frames only when the budget runs short. Even
+ * when the important lights use up the whole budget, the longest-waiting of the
+ * rest still gets one face, so no light is starved for good. Each light's faces
+ * are taken in turn, so a light that is stale every frame still cycles through
+ * all six.
+ *
+ * The budget is in milliseconds of GPU time. A GL_TIME_ELAPSED query around the
+ * shadow passes measures what a face costs; results are read from a small ring
+ * a few frames late, only once GL has them, and smoothed.
+ */
+class ShadowScheduler
+{
+public:
+    static constexpr float IMPORTANT_COVERAGE = 0.25f;
+    static const unsigned int QUERY_RING = 4;
+
+    struct Request
+    {
+        uint32_t light;    // the light's slot; keys its change rate and waiting history
+        float   coverage;  // screen importance, see ShadowMaps::LightCoverage
+        bool    changed;   // the light or its casters changed this frame
+        uint8_t staleFaces; // bit per cube face that needs rendering
+    };
+
+    struct Stats
+    {
+        unsigned int facesRendered;  // this frame
+        unsigned int facesDeferred;  // stale faces left for later frames
+        unsigned int lightsDeferred; // lights with stale faces left
+        float        gpuMs;          // shadow passes of the last measured frame
+        float        msPerFace;      // smoothed cost estimate
+    };
+
+    bool Init();
+    void Destroy();
+
+    void SetBudget(float milliseconds) { mBudgetMs = milliseconds; }
+    float GetBudget() const { return mBudgetMs; }
+
+    // Faces to render this frame, one mask per request
+    void Schedule(const std::vector<Request>& requests, std::vector<uint8_t>& faces);
+    // Forgets every light's history, for when the slots change hands (e.g. a scene switch)
+    void Reset();
+
+    // Around the shadow passes; faces is how many were rendered
+    void BeginTiming();
+    void EndTiming(unsigned int faces);
+
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    void ReadTimings();
+
+    float mBudgetMs = 2.0f;
+    float mMsPerFace = 0.05f; // until the first measurement
+
+    std::vector<float>        mRate;   // per light slot, smoothed fraction of frames it changed in
+    std::vector<unsigned int> mWaited; // per light slot, frames since a stale face of it was drawn
+    std::vector<uint8_t>      mNextFace; // per light slot, the face its next round starts looking at
+    std::vector<uint32_t>     mRanked; // scratch
+
+    unsigned int mQueries[QUERY_RING] = {};
+    unsigned int mQueryFaces[QUERY_RING] = {};
+    bool         mQueryPending[QUERY_RING] = {};
+    unsigned int mNextQuery = 0;
+    bool         mTiming = false;
+    Stats mStats = {};
+};
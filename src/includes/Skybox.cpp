@@ -4,74 +4,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 
-extern float SCR_HEIGHT;
-extern float SCR_WIDTH;
-
-
-// Define the vertices for a cube (skybox)
-static float skyboxVertices[] = {
-    // positions          
-    -1.0f,  1.0f, -1.0f,
-    -1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-
-    -1.0f, -1.0f,  1.0f,
-    -1.0f, -1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f,
-
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-
-    -1.0f, -1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f,
-
-    -1.0f,  1.0f, -1.0f,
-     1.0f,  1.0f, -1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f,
-    -1.0f,  1.0f, -1.0f,
-
-    -1.0f, -1.0f, -1.0f,
-    -1.0f, -1.0f,  1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-    -1.0f, -1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f
-};
+#include "Primitives.h"
 
 Skybox::Skybox(Shader& shader, const std::vector<std::string>& faces)
     : m_Shader(shader)
 {
-    // Generate and bind VAO and VBO
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    
-    glBindVertexArray(VAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    
-    // Define vertex attributes
-    glEnableVertexAttribArray(0); // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    
-    glBindVertexArray(0);
-
     // Load cubemap textures
     cubemapTexture = loadCubemap(faces);
 
@@ -85,27 +22,17 @@ Skybox::~Skybox()
     Cleanup();
 }
 
-void Skybox::Render(Camera& camera)
+void Skybox::Render()
 {
     // Change depth function so depth test passes when values are equal to depth buffer's content
     glDepthFunc(GL_LEQUAL);
 
     m_Shader.use();
 
-    // Create view and projection matrices
-    glm::mat4 view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // Remove translation from the view matrix
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-        (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-    
-    m_Shader.setMat4("view", view);
-    m_Shader.setMat4("projection", projection);
-
-    // Skybox cube
-    glBindVertexArray(VAO);
+    // Skybox cube: the shared primitive, whose positions double as lookup directions
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    Primitives::Draw(PRIMITIVE_CUBE);
 
     // Restore default depth function
     glDepthFunc(GL_LESS);
@@ -113,8 +40,6 @@ void Skybox::Render(Camera& camera)
 
 void Skybox::Cleanup()
 {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
     glDeleteTextures(1, &cubemapTexture);
 }
 
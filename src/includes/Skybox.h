@@ -37,9 +37,9 @@ public:
     /**
      * @brief Renders the skybox.
      * 
-     * @param camera Reference to the Camera object providing view and projection matrices.
+     * View and projection are read from the shared FrameData uniform block.
      */
-    void Render(Camera& camera);
+    void Render();
 
     /**
      * @brief Cleans up OpenGL resources manually if needed.
@@ -48,7 +48,6 @@ public:
 
 private:
     Shader& m_Shader;            ///< Reference to the shader used for rendering the skybox.
-    unsigned int VAO, VBO;       ///< Vertex Array Object and Vertex Buffer Object.
     unsigned int cubemapTexture; ///< ID of the loaded cubemap texture.
 
     /**
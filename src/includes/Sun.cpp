@@ -1,17 +1,12 @@
 #include "Sun.h"
 #include <vector>
 
-
-extern int SCR_WIDTH;
-extern int SCR_HEIGHT;
-
-extern float far_plane;
+Material Sun::material;
 
 // Constructor
-Sun::Sun(Shader& shader, glm::vec3 color, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
-    : shader(shader), color(color), position(position), rotation(rotation), scale(scale)
+Sun::Sun(Shader& shader, SceneNode& parent, glm::vec3 color, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
+    : shader(shader), color(color), node(parent.AddChild(position, rotation, scale))
 {
-    InitRenderData();
 }
 
 // Destructor
@@ -20,128 +15,34 @@ Sun::~Sun()
 
 // Setters
 void Sun::SetPosition(const glm::vec3& pos) {
-    position = pos;
+    node->SetPosition(pos);
 }
 
-glm::vec3 Sun::GetPosition() {
-    return position;
+glm::vec3 Sun::GetPosition() const {
+    return node->GetPosition();
 }
 
 void Sun::SetRotation(const glm::vec3& rot) {
-    rotation = rot;
+    node->SetRotation(rot);
 }
 
 void Sun::SetScale(const glm::vec3& scl) {
-    scale = scl;
+    node->SetScale(scl);
 }
 
-// Render method
-void Sun::Render(Camera& camera, const std::vector<glm::vec3>& lightPositions, 
-                 const std::vector<glm::vec3>& lightColors)
+void Sun::Submit(RenderQueue& queue) const
 {
-    // Activate shader
-    shader.use();
-
-    // View and Projection matrices
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 
-        (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, far_plane);
-    glm::mat4 view = camera.GetViewMatrix(); // Now allowed since camera is non-const
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-
-    // Model matrix
-    glm::mat4 modelMat = glm::mat4(1.0f);
-    modelMat = glm::translate(modelMat, position);
-    modelMat = glm::rotate(modelMat, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    modelMat = glm::rotate(modelMat, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    modelMat = glm::rotate(modelMat, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    modelMat = glm::scale(modelMat, scale);
-    shader.setMat4("model", modelMat);
-    shader.setVec3("lightColor", color);
-
-
-    // Set lighting uniforms
-    for (unsigned int i = 0; i < lightPositions.size(); i++)
-    {
-        shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-        shader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-    }
-    shader.setVec3("viewPos", camera.Position);
-
-    // Render Sun
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    DrawPacket packet;
+    packet.program       = shader.ID;
+    packet.material      = &material;
+    Primitives::Describe(PRIMITIVE_CUBE, packet);
+    packet.color         = color;
+    packet.castsShadow   = false;
+    packet.transform     = GetModelMatrix();
+    queue.Submit(RENDER_PASS_EMISSIVE, packet);
 }
 
-void Sun::InitRenderData()
+const glm::mat4& Sun::GetModelMatrix() const
 {
-    // Define the vertices for a Sun
-    float vertices[] = {
-        // positions          // normals           // texture coords
-        // back face
-        -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-         1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-        -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-        -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-         1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-        -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-        -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-        -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-        -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-         1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-         1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-         1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-         1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-         1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-         1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-        -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-        -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-         1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-         1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-        -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-        -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
-    };
-
-    // Setup buffer and vertex array objects
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    // Position attribute
-    glEnableVertexAttribArray(0);	
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // Normal attribute
-    glEnableVertexAttribArray(1);	
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // Texture Coordinate attribute
-    glEnableVertexAttribArray(2);	
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-    glBindVertexArray(0);
+    return node->GetWorldMatrix();
 }
@@ -5,13 +5,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "../helpers/shader.h"
 #include "../helpers/camera.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "Primitives.h"
 #include <string>
 #include <vector>
 
 class Sun {
 public:
-    // Constructors
-    Sun(Shader& shader, glm::vec3 color = glm::vec3(1.0f), 
+    // Constructors; the sun hangs under the given scene node
+    Sun(Shader& shader, SceneNode& parent, glm::vec3 color = glm::vec3(1.0f), 
          glm::vec3 position = glm::vec3(0.0f), 
          glm::vec3 rotation = glm::vec3(0.0f), 
          glm::vec3 scale = glm::vec3(1.0f));
@@ -21,26 +24,23 @@ public:
 
     // Setters for transformations
     void SetPosition(const glm::vec3& position);
-    glm::vec3 GetPosition();
+    glm::vec3 GetPosition() const;
     void SetRotation(const glm::vec3& rotation);
     void SetScale(const glm::vec3& scale);
 
-    // Render the Sun
-    // Changed from const Camera& to Camera&
-    void Render(Camera& camera, const std::vector<glm::vec3>& lightPositions, 
-               const std::vector<glm::vec3>& lightColors);
+    // Queue a draw packet (emissive, casts no shadow). Suns share the primitive cube and
+    // one material, and their colour goes in per instance, so every sun in the scene is
+    // a single instanced draw.
+    void Submit(RenderQueue& queue) const;
 
-private:
-    // Render data
-    unsigned int VAO, VBO;
+    // World matrix cached by the scene graph
+    const glm::mat4& GetModelMatrix() const;
 
+private:
     // Sun properties
     Shader& shader;
+    static Material material; // no textures or constants; shared so suns batch
     glm::vec3 color;
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
+    SceneNode* node;
 
-    // Initialization
-    void InitRenderData();
 };
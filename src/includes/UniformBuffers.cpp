@@ -0,0 +1,115 @@
+#include "UniformBuffers.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+UniformBuffers::UniformBuffers()
+    : mInit(false), mFrameUBO(0), mLightsUBO(0), mShadowUBO(0), mClusterUBO(0)
+{
+    std::memset(&mLightData, 0, sizeof(mLightData));
+    std::memset(&mShadowData, 0, sizeof(mShadowData));
+}
+
+UniformBuffers::~UniformBuffers() {}
+
+bool UniformBuffers::Init()
+{
+    if (mInit) return true;
+
+    auto createBlock = [](unsigned int& ubo, GLsizeiptr size, GLuint binding)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    };
+
+    createBlock(mFrameUBO,  sizeof(FrameBlock),  FRAME_BLOCK_BINDING);
+    createBlock(mLightsUBO, sizeof(LightBlock),  LIGHTS_BLOCK_BINDING);
+    createBlock(mShadowUBO, sizeof(ShadowBlock), SHADOW_BLOCK_BINDING);
+    createBlock(mClusterUBO, sizeof(ClusterBlock), CLUSTER_BLOCK_BINDING);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    mInit = true;
+    return true;
+}
+
+void UniformBuffers::Destroy()
+{
+    glDeleteBuffers(1, &mFrameUBO);
+    glDeleteBuffers(1, &mLightsUBO);
+    glDeleteBuffers(1, &mShadowUBO);
+    glDeleteBuffers(1, &mClusterUBO);
+    mFrameUBO = mLightsUBO = mShadowUBO = mClusterUBO = 0;
+    mInit = false;
+}
+
+void UniformBuffers::Attach(const Shader& shader) const
+{
+    shader.bindUniformBlock("FrameData",  FRAME_BLOCK_BINDING);
+    shader.bindUniformBlock("LightData",  LIGHTS_BLOCK_BINDING);
+    shader.bindUniformBlock("ShadowData", SHADOW_BLOCK_BINDING);
+    shader.bindUniformBlock("ClusterData", CLUSTER_BLOCK_BINDING);
+}
+
+void UniformBuffers::UpdateFrame(const glm::mat4& projection, const glm::mat4& view,
+                                 const glm::vec3& viewPos, float farPlane, float ambientStrength)
+{
+    FrameBlock frame = {};
+    frame.projection      = projection;
+    frame.view            = view;
+    frame.viewPos         = viewPos;
+    frame.farPlane        = farPlane;
+    frame.ambientStrength = ambientStrength;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, mFrameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffers::UpdateLights(const std::vector<glm::vec3>& positions,
+                                  const std::vector<glm::vec3>& colors,
+                                  const std::vector<int>& shadowSlices,
+                                  const std::vector<float>& shadowLods)
+{
+    size_t count = std::min<size_t>(std::min(positions.size(), colors.size()), MAX_LIGHTS);
+    mLightData.lightCount = static_cast<int>(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        mLightData.lights[i].position = positions[i];
+        mLightData.lights[i].color    = colors[i];
+        mLightData.lights[i].shadowSlice = i < shadowSlices.size() ? shadowSlices[i] : -1;
+        mLightData.lights[i].shadowLod   = i < shadowLods.size() ? shadowLods[i] : 0.0f;
+    }
+
+    // Only the header and the active lights need to go up
+    GLsizeiptr size = offsetof(LightBlock, lights) + count * sizeof(LightBlockEntry);
+    glBindBuffer(GL_UNIFORM_BUFFER, mLightsUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, &mLightData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffers::UpdateShadows(const glm::mat4* shadowMatrices, const glm::vec2* shadowPlanes, size_t lightCount,
+                                   bool enabled, int filter, int taps)
+{
+    lightCount = std::min<size_t>(lightCount, MAX_LIGHTS);
+    mShadowData.enabled   = enabled ? 1 : 0;
+    mShadowData.filter    = filter;
+    mShadowData.taps      = taps;
+    for (size_t n = 0; n < lightCount; ++n)
+        mShadowData.shadowPlanes[n] = glm::vec4(shadowPlanes[n], 0.0f, 0.0f);
+    std::copy(shadowMatrices, shadowMatrices + lightCount * 6, mShadowData.shadowMatrices);
+
+    GLsizeiptr size = offsetof(ShadowBlock, shadowMatrices) + lightCount * 6 * sizeof(glm::mat4);
+    glBindBuffer(GL_UNIFORM_BUFFER, mShadowUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, &mShadowData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffers::UpdateClusters(const ClusterBlock& clusters)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, mClusterUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterBlock), &clusters);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "../helpers/shader.h"
+
+// Upper bound on shadow-casting lights; sizes the light and shadow blocks.
+// Must match MAX_LIGHTS in the shaders. Lighting itself takes any number of
+// lights through ClusteredLights.
+const unsigned int MAX_LIGHTS = 16;
+
+// Fixed binding points shared by every program that declares the blocks
+enum UniformBlockBinding
+{
+    FRAME_BLOCK_BINDING   = 0, // FrameData:   camera and frame constants
+    LIGHTS_BLOCK_BINDING  = 1, // LightData:   shadow-casting light list
+    SHADOW_BLOCK_BINDING  = 2, // ShadowData:  shadow projection and parameters
+    CLUSTER_BLOCK_BINDING = 3  // ClusterData: froxel grid lookup
+};
+
+// std140 mirrors of the GLSL blocks. Keep field order and padding in sync with the shaders.
+struct FrameBlock
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float     farPlane;
+    float     ambientStrength;
+    float     pad[3];
+};
+
+struct LightBlockEntry
+{
+    glm::vec3 position;
+    int       shadowSlice; // shadow atlas slice, -1 when the light has none
+    glm::vec3 color;
+    float     shadowLod;   // atlas mip level the light's shadow was rendered at
+};
+
+struct LightBlock
+{
+    int             lightCount;
+    int             pad[3];
+    LightBlockEntry lights[MAX_LIGHTS];
+};
+
+struct ShadowBlock
+{
+    int       enabled;
+    int       filter; // ShadowMaps::Filter
+    int       taps;   // ShadowMaps::FilterTaps()
+    int       pad;
+    glm::vec4 shadowPlanes[MAX_LIGHTS];       // per light: x = near, y = far
+    glm::mat4 shadowMatrices[MAX_LIGHTS * 6]; // six cube faces per light
+};
+
+struct ClusterBlock
+{
+    glm::ivec4 grid;  // froxel counts in xyz, w = light count
+    glm::vec4  scale; // xy = froxels per pixel, z/w = slice = log(view depth) * z + w
+};
+
+/**
+ * Owns the per-frame uniform buffer objects. Each block is uploaded once per
+ * frame and bound to its fixed binding point, so individual draws only set
+ * what is really per-object (the model matrix).
+ */
+class UniformBuffers
+{
+public:
+    UniformBuffers();
+    ~UniformBuffers();
+
+    bool Init();
+    void Destroy();
+
+    // Points the program's FrameData/LightData/ShadowData/ClusterData blocks (if present) at the shared bindings
+    void Attach(const Shader& shader) const;
+
+    void UpdateFrame(const glm::mat4& projection, const glm::mat4& view,
+                     const glm::vec3& viewPos, float farPlane, float ambientStrength);
+    // shadowSlices/shadowLods come from ShadowMaps; lights without an entry get no shadow
+    void UpdateLights(const std::vector<glm::vec3>& positions,
+                      const std::vector<glm::vec3>& colors,
+                      const std::vector<int>& shadowSlices = std::vector<int>(),
+                      const std::vector<float>& shadowLods = std::vector<float>());
+    // shadowPlanes: each light's near and far plane, the ones its six matrices were built with
+    void UpdateShadows(const glm::mat4* shadowMatrices, const glm::vec2* shadowPlanes, size_t lightCount,
+                       bool enabled, int filter, int taps);
+    void UpdateClusters(const ClusterBlock& clusters);
+
+private:
+    bool mInit;
+    unsigned int mFrameUBO;
+    unsigned int mLightsUBO;
+    unsigned int mShadowUBO;
+    unsigned int mClusterUBO;
+
+    LightBlock  mLightData;
+    ShadowBlock mShadowData;
+};
@@ -34,6 +34,8 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // union of the mesh bounds, in model space
+    Bounds bounds;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -69,6 +71,9 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        for(const Mesh& mesh : meshes)
+            bounds.Merge(mesh.bounds);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -11,7 +11,11 @@
 
 #include <iostream>
 #include <vector>
+#include <array>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
 
 // Custom class includes
 #include "includes/BloomFBO.h"
@@ -21,9 +25,21 @@
 #include "includes/Cube.h"
 #include "includes/Sun.h"
 #include "includes/Object.h"
+#include "includes/UniformBuffers.h"
+#include "includes/RenderQueue.h"
+#include "includes/GLStateCache.h"
+#include "includes/OcclusionCuller.h"
+#include "includes/GpuCuller.h"
+#include "includes/GeometryArena.h"
+#include "includes/Primitives.h"
+#include "includes/ClusteredLights.h"
+#include "includes/DeferredRenderer.h"
+#include "includes/DepthPrepass.h"
+#include "includes/ShadowMaps.h"
 
 // Scene management
 #include "scenes.h"
+#include "benchmarks.h"
 
 // Forward declaration for callbacks
 void framebuffer_size_callback(GLFWwindow*, int, int);
@@ -55,20 +71,51 @@ const unsigned int SHADOW_WIDTH = 512, SHADOW_HEIGHT = 512;
 float near_plane  = 1.0f;
 float far_plane   = 1000.0f;
 bool  showShadow  = true;
+// GPU time the shadow passes may take per frame; stale faces past it wait (adjusted with [ and ])
+float shadowBudgetMs = 2.0f;
+// ShadowMaps::Filter (cycled with F) and ShadowMaps::Quality (cycled with K)
+int shadowFilter  = ShadowMaps::FILTER_COMPARE;
+int shadowQuality = ShadowMaps::QUALITY_MEDIUM;
+// Deferred path: accumulate PCF / compare shadows over frames (J)
+bool temporalShadows = true;
+
+// Occlusion culling of the camera pass (toggled with O)
+bool occlusionCulling = true;
+// GPU culling + multi-draw-indirect when the context is 4.3+ (toggled with G)
+bool gpuDrivenCulling = true;
+// Deferred shading instead of forward, per scene in allScenes order (toggled with R)
+bool deferredShading[4] = { false, false, false, false };
+// Depth pre-pass ahead of forward shading, per scene (cycled auto / on / off with T).
+// Auto turns it on where the measured overdraw is high, as in the trees scene.
+int depthPrepassMode[4] = { DepthPrepass::MODE_AUTO, DepthPrepass::MODE_AUTO,
+                            DepthPrepass::MODE_AUTO, DepthPrepass::MODE_AUTO };
+// The geometry arena is packed once its free space splits into more blocks than this
+const unsigned int ARENA_MAX_FREE_BLOCKS = 16;
 
 float control_y = 0.0f;
 
-int main()
+int main(int argc, char** argv)
 {
+    // Headless benchmarks, no window needed
+    if (argc > 1 && std::strcmp(argv[1], "--bench-bvh") == 0)
+        return RunBvhBenchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000);
+
     // Initialize GLFW
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 8); // 8x MSAA
 
+    // Ask for 4.3 (GPU-driven culling), settle for 3.3 where that isn't available (macOS)
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Todhchai - Ireland in Future", nullptr, nullptr);
     if (!window)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Todhchai - Ireland in Future", nullptr, nullptr);
+    }
+    if (!window)
     {
         std::cerr << "Failed to create GLFW Window" << std::endl;
         glfwTerminate();
@@ -96,42 +143,97 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE); // Disable face culling for cube rendering
 
-    // Load shaders
+    // Load shaders; linked programs are kept on disk and reused while the sources and driver stay the same.
+    // Compiles run on the driver's threads where it can, so programs build while the scenes load below.
+    ProgramCache::setDirectory("shader_cache");
+    bool parallelCompile = ParallelCompile::enable();
     Shader shader("shaders/bloom.vs", "shaders/bloom.fs");
     Shader shaderLight("shaders/bloom.vs", "shaders/light_box.fs");
     Shader shaderBloomFinal("shaders/bloom_final.vs", "shaders/bloom_final.fs");
-    Shader simpleDepthShader("shaders/point_shadows_depth.vs",
+    // Layered shadow pass: gl_Layer straight from the vertex shader where the driver
+    // allows it, otherwise through a pass-through geometry shader
+    bool vertexLayer = ShadowMaps::HasVertexLayer();
+    Shader simpleDepthShader(vertexLayer ? "shaders/point_shadows_layer.vs" : "shaders/point_shadows_depth.vs",
                              "shaders/point_shadows_depth.fs",
-                             "shaders/point_shadows_depth.gs");
-
-    // Configure shadow maps
-    const unsigned int MAX_SUNS = 16;
-    unsigned int depthCubemaps[MAX_SUNS];
-    unsigned int depthMapFBOs[MAX_SUNS];
-    glGenTextures(MAX_SUNS, depthCubemaps);
-    glGenFramebuffers(MAX_SUNS, depthMapFBOs);
-
-    for (unsigned int n = 0; n < MAX_SUNS; ++n)
+                             vertexLayer ? nullptr : "shaders/point_shadows_depth.gs");
+    Shader shadowBlurShader("shaders/shadow_blur.vs", "shaders/shadow_blur.fs");
+    Shader occlusionProxyShader("shaders/occlusion_proxy.vs", "shaders/occlusion_proxy.fs");
+    Shader depthPrepassShader("shaders/depth_prepass.vs", "shaders/depth_prepass.fs");
+    Shader deferredGeometryShader("shaders/bloom.vs", "shaders/deferred_geometry.fs");
+    Shader deferredLightShader("shaders/deferred_light.vs", "shaders/deferred_light.fs");
+    Shader deferredCompositeShader("shaders/deferred_composite.vs", "shaders/deferred_composite.fs");
+    Shader deferredShadowSampleShader("shaders/deferred_composite.vs", "shaders/deferred_shadow_sample.fs");
+    Shader deferredShadowResolveShader("shaders/deferred_composite.vs", "shaders/deferred_shadow_resolve.fs");
+
+    // Every lit and deferred light variant the shadow keys can pick, queued up front when the
+    // driver builds them in the background; otherwise each is compiled the first time it is picked
+    if (parallelCompile)
     {
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemaps[n]);
-        for (unsigned int i = 0; i < 6; ++i)
+        shader.precompile(ShadowMaps::LitDefines(false, ShadowMaps::FILTER_PCF, ShadowMaps::QUALITY_LOW));
+        deferredLightShader.precompile(DeferredRenderer::LightDefines(false, false, ShadowMaps::FILTER_PCF, ShadowMaps::QUALITY_LOW));
+        deferredLightShader.precompile(DeferredRenderer::LightDefines(true, true, ShadowMaps::FILTER_PCF, ShadowMaps::QUALITY_LOW));
+        for (int f = 0; f < ShadowMaps::FILTER_COUNT && ShadowMaps::IsSupported(); ++f)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
-                         SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            ShadowMaps::Filter filter = static_cast<ShadowMaps::Filter>(f);
+            if (filter != ShadowMaps::FILTER_MOMENTS)
+                deferredShadowSampleShader.precompile(DeferredRenderer::SampleDefines(filter));
+            for (int q = 0; q < ShadowMaps::QUALITY_COUNT; ++q)
+            {
+                ShadowMaps::Quality quality = static_cast<ShadowMaps::Quality>(q);
+                shader.precompile(ShadowMaps::LitDefines(true, filter, quality));
+                deferredLightShader.precompile(DeferredRenderer::LightDefines(true, false, filter, quality));
+            }
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBOs[n]);
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemaps[n], 0);
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
+    // Initialize Scenes
+    ParkScene      parkScene;
+    TreesScene     treesScene;
+    TowerScene     towerScene;
+    StructureScene structureScene;
+
+    parkScene.Init(shaderLight, shader);
+    treesScene.Init(shaderLight, shader);
+    towerScene.Init(shaderLight, shader);
+    structureScene.Init(shaderLight, shader);
+
+    std::vector<BaseScene*> allScenes = { &towerScene, &parkScene, &structureScene, &treesScene };
+
+
+    // Shared per-frame uniform blocks (camera, lights, shadows)
+    UniformBuffers uniformBuffers;
+    uniformBuffers.Init();
+    uniformBuffers.Attach(shaderLight);
+    uniformBuffers.Attach(simpleDepthShader);
+    uniformBuffers.Attach(occlusionProxyShader);
+    uniformBuffers.Attach(depthPrepassShader);
+    uniformBuffers.Attach(deferredGeometryShader);
+    uniformBuffers.Attach(deferredCompositeShader);
+    uniformBuffers.Attach(deferredShadowResolveShader);
+
+    // Per-froxel light lists for the lit shader; the deferred light volumes read the same lights
+    ClusteredLights clusteredLights;
+    clusteredLights.Init();
+    // the deferred light and sampling shaders have variants per shadow setup, like the lit shader
+    deferredLightShader.addSetup([&](Shader& light)
+    {
+        uniformBuffers.Attach(light);
+        clusteredLights.Attach(light);
+    });
+    deferredShadowSampleShader.addSetup([&](Shader& sample)
+    {
+        uniformBuffers.Attach(sample);
+        clusteredLights.Attach(sample);
+    });
+
+    // Shadow cube-map-array atlas, cached while the lights and casters keep still
+    bool shadowsSupported = ShadowMaps::IsSupported();
+    if (!shadowsSupported)
+        std::cout << "Cube map arrays need OpenGL 4.0; shadows disabled" << std::endl;
+    ShadowMaps shadowMaps;
+    if (shadowsSupported)
+        shadowMaps.Init(SHADOW_WIDTH, MAX_LIGHTS, shadowBlurShader);
+
     // Configure HDR MSAA Framebuffer
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
@@ -155,7 +257,7 @@ int main()
     unsigned int rboDepthMSAA;
     glGenRenderbuffers(1, &rboDepthMSAA);
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepthMSAA);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT,
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT24,
                                      SCR_WIDTH, SCR_HEIGHT);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
                               GL_RENDERBUFFER, rboDepthMSAA);
@@ -188,13 +290,19 @@ int main()
                                GL_TEXTURE_2D, resolvedColorBuffers[i], 0);
     }
 
-    unsigned int resolvedDepthRBO;
-    glGenRenderbuffers(1, &resolvedDepthRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, resolvedDepthRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT,
-                          SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                              GL_RENDERBUFFER, resolvedDepthRBO);
+    // A texture rather than a renderbuffer so the GPU culler can build its Hi-Z pyramid
+    // from it; the format matches the MSAA depth buffer, as the resolve blit requires
+    unsigned int resolvedDepthTexture;
+    glGenTextures(1, &resolvedDepthTexture);
+    glBindTexture(GL_TEXTURE_2D, resolvedDepthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
+                 SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                           GL_TEXTURE_2D, resolvedDepthTexture, 0);
 
     unsigned int resolvedAttachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
     glDrawBuffers(2, resolvedAttachments);
@@ -226,19 +334,22 @@ int main()
             std::cout << "Ping-pong Framebuffer not complete!" << std::endl;
     }
 
-    // Configure shaders
-    shader.use();
-    shader.setInt("diffuseTexture", 0);
+    // Configure shaders. The lit shader's variants (one per shadow setup) all get the same
+    // blocks and samplers; the shadow atlases never change unit, so they are set once too.
+    shader.addSetup([&](Shader& lit)
+    {
+        uniformBuffers.Attach(lit);
+        clusteredLights.Attach(lit);
+        ShadowMaps::SetSamplers(lit);
+        lit.setInt("diffuseTexture", 0);
+    });
 
     shaderBloomFinal.use();
     shaderBloomFinal.setInt("scene", 0);
     shaderBloomFinal.setInt("bloomBlur", 1);
 
-    simpleDepthShader.use();
-    simpleDepthShader.setFloat("far_plane", far_plane);
-
-    shader.use();
-    shader.setInt("depthMap", 1);
+    // Resolve the remaining per-draw uniform handles once; everything shared lives in the uniform blocks
+    Uniform<float> exposureUniform   = shaderBloomFinal.getUniform<float>("exposure");
 
     // Update framebuffer size
     glfwMakeContextCurrent(window);
@@ -251,36 +362,54 @@ int main()
     BloomRenderer bloomRenderer;
     bloomRenderer.Init(SCR_WIDTH, SCR_HEIGHT);
 
-    // Initialize Scenes
-    ParkScene      parkScene;
-    TreesScene     treesScene;
-    TowerScene     towerScene;
-    StructureScene structureScene;
-
-    parkScene.Init(shaderLight, shader);
-    treesScene.Init(shaderLight, shader);
-    towerScene.Init(shaderLight, shader);
-    structureScene.Init(shaderLight, shader);
+    DepthPrepass depthPrepass;
+    depthPrepass.Init(depthPrepassShader);
 
-    std::vector<BaseScene*> allScenes = { &towerScene, &parkScene, &structureScene, &treesScene };
+    DeferredRenderer deferredRenderer;
+    deferredRenderer.Init(SCR_WIDTH, SCR_HEIGHT, deferredGeometryShader, deferredLightShader, deferredCompositeShader,
+                          deferredShadowSampleShader, deferredShadowResolveShader);
 
     // Lambda to generate shadow transformation matrices
-    auto GetShadowTransforms = [&](const glm::vec3& lightPos) -> std::vector<glm::mat4>
+    // (far: the light's radius, so depth precision goes where the light reaches)
+    auto GetShadowTransforms = [&](const glm::vec3& lightPos, float farPlane) -> std::array<glm::mat4, 6>
     {
-        std::vector<glm::mat4> mats;
         glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f),
                                                 static_cast<float>(SHADOW_WIDTH) / SHADOW_HEIGHT,
-                                                near_plane, far_plane);
-
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1, 0, 0),  glm::vec3(0, -1, 0)));
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0)));
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 1, 0),  glm::vec3(0, 0, 1)));
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)));
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, 1),  glm::vec3(0, -1, 0)));
-        mats.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0)));
-        return mats;
+                                                near_plane, farPlane);
+
+        return {
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1, 0, 0),  glm::vec3(0, -1, 0)),
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0)),
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 1, 0),  glm::vec3(0, 0, 1)),
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)),
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, 1),  glm::vec3(0, -1, 0)),
+            shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0)),
+        };
     };
 
+    std::array<glm::mat4, MAX_LIGHTS * 6> shadowMatrices;
+
+    // Scenes submit into the queue once per frame; both passes replay it through the state cache
+    RenderQueue  renderQueue;
+    GLStateCache stateCache;
+    renderQueue.Init();
+
+    OcclusionCuller occlusionCuller;
+    occlusionCuller.Init(occlusionProxyShader);
+
+    // The GPU-driven path replaces both CPU culling and occlusion queries for meshes
+    GpuCuller gpuCuller;
+    bool gpuDrivenSupported = GpuCuller::IsSupported() && gpuCuller.Init(SCR_WIDTH, SCR_HEIGHT);
+    std::cout << "OpenGL " << GLVersion.major << "." << GLVersion.minor << ": GPU-driven culling "
+              << (gpuDrivenSupported ? "available" : "unavailable, using the CPU path") << std::endl;
+    const ProgramCache::Stats& programStats = ProgramCache::stats();
+    std::cout << "Shader programs: " << programStats.loaded << " from the binary cache, " << programStats.compiled
+              << " compiled from source" << (ProgramCache::isEnabled() ? "" : " (binary cache unsupported)")
+              << (parallelCompile ? ", in parallel" : "")
+              << ", " << programStats.ms << " ms" << std::endl;
+
+    int shadowSceneIndex = currentSceneIndex; // scene the shadow slots were filled for
+
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -302,6 +431,69 @@ int main()
                       << " | FPS: " << fps << std::endl;
             std::cout << "Control Y: " << control_y << std::endl;
 
+            const GLStateCache::Stats& glStats = stateCache.GetStats();
+            std::cout << "Draw calls: " << glStats.drawCalls
+                      << " (" << glStats.instances << " instances)"
+                      << " | GL state calls issued: " << glStats.TotalIssued()
+                      << ", skipped: " << glStats.TotalSkipped() << std::endl;
+
+            const RenderQueue::CullStats& cameraCull = renderQueue.GetCameraCullStats();
+            const RenderQueue::CullStats& shadowCull = renderQueue.GetShadowCullStats();
+            std::cout << "Culling: camera " << cameraCull.visible << " visible / " << cameraCull.culled << " culled"
+                      << " | shadow faces " << shadowCull.visible << " drawn / " << shadowCull.culled << " culled" << std::endl;
+            const OcclusionCuller::Stats& occlusionStats = occlusionCuller.GetStats();
+            std::cout << "Occlusion " << (occlusionCulling ? "on" : "off") << ": " << occlusionStats.tested << " boxes tested, "
+                      << occlusionStats.conditional << " conditional draws, "
+                      << occlusionStats.skipped << " draws skipped (previous frame)" << std::endl;
+            if (gpuDrivenSupported && gpuDrivenCulling)
+            {
+                const GpuCuller::Stats& gpuStats = gpuCuller.GetStats();
+                std::cout << "GPU culling: " << gpuStats.objects << " objects in " << gpuStats.groups
+                          << " indirect commands, " << gpuStats.multiDraws << " multi-draws" << std::endl;
+            }
+            std::cout << "Scene graph: " << allScenes[currentSceneIndex - 1]->GetSceneGraph().GetUpdatedCount()
+                      << " world matrices recomputed last frame" << std::endl;
+
+            GeometryArena::Stats arenaStats = GeometryArena::Get().GetStats();
+            std::cout << "Geometry arena: " << arenaStats.allocations << " meshes, "
+                      << arenaStats.usedBytes / 1024 << " / " << arenaStats.capacityBytes / 1024 << " KiB used, "
+                      << arenaStats.freeBlocks << " free blocks, " << arenaStats.repacks << " repacks" << std::endl;
+            const ShadowMaps::Stats& shadowStats = shadowMaps.GetStats();
+            std::cout << "Shadow maps: " << shadowStats.staticFaces << " static faces redrawn, "
+                      << shadowStats.dynamicFaces << " with moving casters, "
+                      << shadowStats.cachedLights << " lights cached (last frame), atlas "
+                      << shadowStats.slicesUsed << " / " << shadowStats.slicesAllocated << " slices, "
+                      << shadowStats.atlasBytes / 1024 << " KiB" << std::endl;
+            const ShadowScheduler::Stats& scheduleStats = shadowMaps.GetScheduler().GetStats();
+            std::cout << "Shadow budget: " << scheduleStats.gpuMs << " / " << shadowBudgetMs << " ms, "
+                      << scheduleStats.msPerFace << " ms per face, " << scheduleStats.facesDeferred
+                      << " faces of " << scheduleStats.lightsDeferred << " lights deferred" << std::endl;
+            static const char* filterNames[ShadowMaps::FILTER_COUNT] = { "PCF", "compare", "moments" };
+            static const char* qualityNames[ShadowMaps::QUALITY_COUNT] = { "low", "medium", "high" };
+            std::cout << "Shadow filter: " << filterNames[shadowMaps.GetFilter()] << ", "
+                      << qualityNames[shadowQuality] << " quality, " << shadowMaps.FilterTaps() << " taps, "
+                      << shader.variantCount() << " lit shader variants" << std::endl;
+            if (!deferredShading[currentSceneIndex - 1])
+            {
+                static const char* prepassModes[] = { "auto", "on", "off" };
+                const DepthPrepass::Stats& prepassStats = depthPrepass.GetStats();
+                std::cout << "Depth pre-pass " << prepassModes[depthPrepassMode[currentSceneIndex - 1]]
+                          << (prepassStats.active ? " (running)" : " (idle)") << ": overdraw " << prepassStats.overdraw
+                          << ", " << prepassStats.shadedSamples << " samples shaded, "
+                          << prepassStats.savedSamples << " saved" << std::endl;
+            }
+            if (deferredShading[currentSceneIndex - 1])
+            {
+                const DeferredRenderer::Stats& deferredStats = deferredRenderer.GetStats();
+                std::cout << "Deferred shading: " << deferredStats.lights << " light volumes, "
+                          << deferredStats.litSamples << " samples lit"
+                          << (deferredRenderer.GetTemporalShadows() ? ", temporal shadows" : "") << std::endl;
+            }
+            const ClusteredLights::Stats& clusterStats = clusteredLights.GetStats();
+            std::cout << "Clustered lights: " << clusterStats.binnedLights << " / " << clusterStats.lights << " lights binned, "
+                      << clusterStats.indices << " froxel entries, " << clusterStats.occupiedClusters << " froxels lit, "
+                      << "max " << clusterStats.maxPerCluster << " per froxel" << std::endl;
+
             timeSinceLastPrint = 0.0f;
             framesCount = 0;
         }
@@ -309,91 +501,173 @@ int main()
         // Process input
         processInput(window);
 
-        // Update current scene
+        // A scene switch hands the shadow slots to other lights; start them over
+        if (shadowSceneIndex != currentSceneIndex)
+        {
+            shadowMaps.Invalidate();
+            shadowSceneIndex = currentSceneIndex;
+        }
+
+        // Update current scene, then refresh the world matrices it moved
         BaseScene* currentScene = allScenes[currentSceneIndex - 1];
         currentScene->Update(deltaTime);
-
-        // Shadow pass for each sun
-        size_t sunCount = currentScene->GetLightCount();
-        for (size_t n = 0; n < sunCount; ++n)
+        currentScene->GetSceneGraph().Update();
+
+        // Shadow settings, and the lit and deferred light shaders specialised for them: a variant set up here
+        // drives GL directly, so this comes before the state cache starts the frame. Until
+        // it has finished building, the default permutation draws in its place.
+        bool shadowsOn = showShadow && shadowsSupported;
+        ShadowMaps::Filter filter   = static_cast<ShadowMaps::Filter>(shadowFilter);
+        ShadowMaps::Quality quality = static_cast<ShadowMaps::Quality>(shadowQuality);
+        if (shadowsSupported)
+            shadowMaps.SetFilter(filter, quality);
+        const Shader& litShader = shader.variantIfReady(ShadowMaps::LitDefines(shadowsOn, filter, quality));
+        if (deferredShading[currentSceneIndex - 1])
         {
-            glm::vec3 lightPos = currentScene->GetLightPositions()[n];
-
-            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-            glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBOs[n]);
-            glClear(GL_DEPTH_BUFFER_BIT);
-            simpleDepthShader.use();
-
-            std::vector<glm::mat4> shadowMats = GetShadowTransforms(lightPos);
-            for (unsigned int i = 0; i < 6; ++i)
-            {
-                std::string name = "shadowMatrices[" + std::to_string(i) + "]";
-                simpleDepthShader.setMat4(name.c_str(), shadowMats[i]);
-            }
-            simpleDepthShader.setVec3("lightPos", lightPos);
-            simpleDepthShader.setFloat("far_plane", far_plane);
-
-            currentScene->RenderDepth(simpleDepthShader);
-
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            deferredRenderer.SetTemporalShadows(temporalShadows && shadowsOn && filter != ShadowMaps::FILTER_MOMENTS);
+            deferredRenderer.SetShadowVariant(shadowsOn, filter, quality);
         }
 
-        // Normal rendering pass
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClearColor(0.f, 0.f, 0.f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Bind shadow maps
-        shader.use();
-        for (size_t i = 0; i < sunCount; ++i)
+        // Repack the geometry arena once it fragments: between frames, so nothing is mid-draw
+        // when it swaps its buffers, and before the state cache starts tracking bindings
+        GeometryArena::Get().Defragment(ARENA_MAX_FREE_BLOCKS);
+
+        // Collect and sort this frame's draws; bloom drove GL directly last frame, so start the cache clean
+        stateCache.BeginFrame();
+        renderQueue.Begin(camera.Position);
+        currentScene->Submit(renderQueue);
+        renderQueue.Sort();
+
+        // Upload the frame's lights and shadow transforms once; every pass reads them from the blocks
+        const std::vector<glm::vec3>& lightPositions = currentScene->GetLightPositions();
+        const std::vector<glm::vec3>& lightColors    = currentScene->GetLightColors();
+        size_t sunCount = std::min<size_t>(currentScene->GetLightCount(), MAX_LIGHTS);
+        std::vector<float> shadowRanges(sunCount);
+        std::vector<glm::vec2> shadowPlanes(sunCount);
+        for (size_t n = 0; n < sunCount; ++n)
         {
-            std::string uniformName = "depthMaps[" + std::to_string(i) + "]";
-            shader.setInt(uniformName.c_str(), 1 + static_cast<int>(i));
+            shadowRanges[n] = std::max(ClusteredLights::LightRadius(lightColors[n]), 2.0f * near_plane);
+            shadowPlanes[n] = glm::vec2(near_plane, shadowRanges[n]);
+            std::array<glm::mat4, 6> shadowMats = GetShadowTransforms(lightPositions[n], shadowRanges[n]);
+            std::copy(shadowMats.begin(), shadowMats.end(), shadowMatrices.begin() + n * 6);
         }
+        uniformBuffers.UpdateShadows(shadowMatrices.data(), shadowPlanes.data(), sunCount, shadowsOn,
+                                     shadowFilter, shadowMaps.FilterTaps());
+
+        // The shadow pass measures depth from this frame's light positions, so they go up first;
+        // the slices and LODs it assigns are patched in afterwards
+        uniformBuffers.UpdateLights(lightPositions, lightColors);
 
-        for (size_t i = 0; i < sunCount; ++i)
+        // Shadow pass for all suns at once; only what changed near a light is drawn again,
+        // at a resolution that follows how much of the screen the light can reach
+        if (shadowsOn)
         {
-            glActiveTexture(GL_TEXTURE1 + i);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemaps[i]);
+            float tanHalfFov = std::tan(glm::radians(camera.Zoom) * 0.5f);
+            std::vector<float> shadowCoverage(sunCount);
+            for (size_t n = 0; n < sunCount; ++n)
+                shadowCoverage[n] = ShadowMaps::LightCoverage(lightPositions[n], shadowRanges[n],
+                                                              camera.Position, tanHalfFov);
+            shadowMaps.GetScheduler().SetBudget(shadowBudgetMs);
+            shadowMaps.Update(stateCache, renderQueue, simpleDepthShader, lightPositions, shadowCoverage,
+                              shadowMatrices.data(), shadowRanges, sunCount);
+            uniformBuffers.UpdateLights(lightPositions, lightColors, shadowMaps.Slices(), shadowMaps.Lods());
+            shadowMaps.Bind(stateCache);
         }
 
-        // Set projection and view matrices
+        // Camera block: projection, view and frame constants
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
                                                 static_cast<float>(SCR_WIDTH) / SCR_HEIGHT,
                                                 0.1f, far_plane);
         glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view",       view);
-        shader.setVec3("viewPos",    camera.Position);
-        shader.setFloat("far_plane", far_plane);
-        shader.setInt("shadows",     showShadow ? 1 : 0);
-        shader.setInt("lightCount",  static_cast<int>(currentScene->GetLightCount()));
-        shader.setFloat("ambientS", control_y);
-
-        // Configure light properties
-        for (int i = 0; i < static_cast<int>(currentScene->GetLightCount()); i++)
+        uniformBuffers.UpdateFrame(projection, view, camera.Position, far_plane, control_y);
+
+        // Bin every light into the camera's froxels
+        clusteredLights.SetProjection(projection, 0.1f, far_plane, SCR_WIDTH, SCR_HEIGHT);
+        clusteredLights.Bin(view, lightPositions, lightColors);
+        clusteredLights.Upload();
+        uniformBuffers.UpdateClusters(clusteredLights.GetBlock());
+        clusteredLights.Bind(stateCache);
+
+        bool gpuDriven = gpuDrivenSupported && gpuDrivenCulling;
+        Frustum cameraFrustum = Frustum::FromMatrix(projection * view);
+        auto flushCamera = [&]()
         {
-            const glm::vec3& pos = currentScene->GetLightPositions()[i];
-            const glm::vec3& col = currentScene->GetLightColors()[i];
+            if (gpuDriven)
+                renderQueue.FlushIndirect(stateCache, gpuCuller, cameraFrustum);
+            else
+                renderQueue.Flush(stateCache, cameraFrustum, occlusionCulling ? &occlusionCuller : nullptr);
+        };
 
-            shader.setVec3("lights[" + std::to_string(i) + "].Position", pos);
-            shader.setVec3("lights[" + std::to_string(i) + "].Color",    col);
+        if (deferredShading[currentSceneIndex - 1])
+        {
+            // G-buffer from the opaque packets, lit by light volumes, composited into the
+            // resolved targets; the light proxies then draw forward over the scene depth
+            PassFilter geometryFilter;
+            geometryFilter.passMask    = 1u << RENDER_PASS_OPAQUE;
+            geometryFilter.program     = shader.ID;
+            geometryFilter.replacement = deferredRenderer.GeometryProgram();
+            deferredRenderer.BeginGeometry();
+            renderQueue.SetPassFilter(geometryFilter);
+            flushCamera();
+
+            deferredRenderer.Light(stateCache, projection * view, clusteredLights.GetStats().lights,
+                                   clusteredLights.GetScreenRect(sunCount));
+            deferredRenderer.Composite(stateCache, resolvedFBO);
+
+            PassFilter emissiveFilter;
+            emissiveFilter.passMask = 1u << RENDER_PASS_EMISSIVE;
+            renderQueue.SetPassFilter(emissiveFilter);
+            renderQueue.Flush(stateCache, cameraFrustum);
+            renderQueue.SetPassFilter(PassFilter());
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
+        else
+        {
+            // Normal rendering pass
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            glClearColor(0.f, 0.f, 0.f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Depth of everything first, so the lit pass shades each visible sample once
+            bool prepass = depthPrepass.Begin(static_cast<DepthPrepass::Mode>(depthPrepassMode[currentSceneIndex - 1]),
+                                              SCR_WIDTH * SCR_HEIGHT * 4); // 4x MSAA target
+            if (prepass)
+            {
+                PassFilter prepassFilter;
+                prepassFilter.replacement = depthPrepass.Program();
+                renderQueue.SetPassFilter(prepassFilter);
+                depthPrepass.BeginDepth();
+                renderQueue.Flush(stateCache, cameraFrustum);
+                depthPrepass.EndDepth();
+                renderQueue.SetPassFilter(PassFilter());
+            }
 
-        // Render current scene
-        currentScene->Render(shader, camera);
+            // Render current scene, the lit packets with the variant picked above
+            PassFilter litFilter;
+            litFilter.program     = shader.ID;
+            litFilter.replacement = litShader.ID != shader.ID ? litShader.ID : 0;
+            renderQueue.SetPassFilter(litFilter);
+            depthPrepass.BeginShading();
+            flushCamera();
+            depthPrepass.EndShading();
+            renderQueue.SetPassFilter(PassFilter());
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            // Resolve MSAA framebuffer
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, hdrFBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolvedFBO);
+            glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT,
+                              0, 0, SCR_WIDTH, SCR_HEIGHT,
+                              GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                              GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
 
-        // Resolve MSAA framebuffer
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, hdrFBO);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolvedFBO);
-        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT,
-                          0, 0, SCR_WIDTH, SCR_HEIGHT,
-                          GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
-                          GL_NEAREST);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // This frame's depth becomes next frame's occlusion test
+        if (gpuDriven)
+            gpuCuller.BuildHiZ(resolvedDepthTexture, projection * view);
 
         // Apply bloom effect
         bloomRenderer.RenderBloomTexture(resolvedColorBuffers[1], bloomFilterRadius);
@@ -405,7 +679,7 @@ int main()
         glBindTexture(GL_TEXTURE_2D, resolvedColorBuffers[0]);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, bloomRenderer.BloomTexture());
-        shaderBloomFinal.setFloat("exposure", exposure);
+        exposureUniform.Set(exposure);
         bloomRenderer.renderQuad();
 
         // Swap buffers and poll events
@@ -415,6 +689,18 @@ int main()
 
     // Cleanup
     bloomRenderer.Destroy();
+    deferredRenderer.Destroy();
+    if (shadowsSupported)
+        shadowMaps.Destroy();
+    depthPrepass.Destroy();
+    uniformBuffers.Destroy();
+    clusteredLights.Destroy();
+    renderQueue.Destroy();
+    occlusionCuller.Destroy();
+    if (gpuDrivenSupported)
+        gpuCuller.Destroy();
+    GeometryArena::Get().Destroy();
+    Primitives::Reset();
     glfwTerminate();
     return 0;
 }
@@ -2,6 +2,7 @@
 #include "includes/Sun.h"
 #include "includes/Cube.h"
 #include "includes/Object.h"
+#include "includes/RenderQueue.h"
 #include "helpers/filesystem.h"
 #include "helpers/shader.h"
 #include "helpers/camera.h"
@@ -28,17 +29,16 @@ void ParkScene::Init(Shader& shaderLight, Shader& shader)
     // Create suns
     for (size_t i = 0; i < m_lightPositions.size(); i++)
     {
-        Sun sun(shaderLight, m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
-        m_suns.push_back(sun);
+        m_suns.emplace_back(shaderLight, m_sceneGraph.Root(), m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
     }
 
     // Add park object
-    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/park/park.obj"),
+    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/park/park.obj"), m_sceneGraph.Root(),
                            glm::vec3(0.f, 2.f, 0.f), glm::vec3(0.f), glm::vec3(0.3f));
 
     // Add floor
     unsigned int floorTex = loadTexture(FileSystem::getPath("resources/textures/gray_concrete_powder.png").c_str(), true);
-    m_cubes.emplace_back(shader, floorTex, glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
+    m_cubes.emplace_back(shader, floorTex, m_sceneGraph.Root(), glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
 
     // Set orbit parameters
     m_angleOffsetsDeg = { 0.f, 30.f, 60.f, 90.f };
@@ -61,23 +61,14 @@ void ParkScene::Update(float dt)
     }
 }
 
-void ParkScene::RenderDepth(Shader& depthShader)
+void ParkScene::Submit(RenderQueue& queue)
 {
     for (auto& c : m_cubes)
-        c.RenderDepth(depthShader);
+        c.Submit(queue);
     for (auto& o : m_objects)
-        o.RenderDepth(depthShader);
-}
-
-void ParkScene::Render(Shader& mainShader, Camera& camera)
-{
-    std::vector<glm::vec3> dummyLP, dummyLC;
-    for (auto& c : m_cubes)
-        c.Render(camera, dummyLP, dummyLC);
-    for (auto& o : m_objects)
-        o.Render(camera, dummyLP, dummyLC);
+        o.Submit(queue);
     for (auto& sun : m_suns)
-        sun.Render(camera, dummyLP, dummyLC);
+        sun.Submit(queue);
 }
 
 const std::vector<glm::vec3>& ParkScene::GetLightPositions() const { return m_lightPositions; }
@@ -106,17 +97,16 @@ void TowerScene::Init(Shader& shaderLight, Shader& shader)
     // Create suns
     for (size_t i = 0; i < m_lightPositions.size(); i++)
     {
-        Sun sun(shaderLight, m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
-        m_suns.push_back(sun);
+        m_suns.emplace_back(shaderLight, m_sceneGraph.Root(), m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
     }
 
     // Add tower object
-    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/tower.obj"),
+    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/tower.obj"), m_sceneGraph.Root(),
                            glm::vec3(0.f, 6.3f, 0.f), glm::vec3(0.f), glm::vec3(0.5f));
 
     // Add floor
     unsigned int floorTex = loadTexture(FileSystem::getPath("resources/textures/gray_concrete_powder.png").c_str(), true);
-    m_cubes.emplace_back(shader, floorTex, glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
+    m_cubes.emplace_back(shader, floorTex, m_sceneGraph.Root(), glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
 
     // Set orbit parameters
     m_angleOffsetsDeg = { 0.f, 30.f, 60.f, 90.f, 120.f};
@@ -139,23 +129,14 @@ void TowerScene::Update(float dt)
     }
 }
 
-void TowerScene::RenderDepth(Shader& depthShader)
+void TowerScene::Submit(RenderQueue& queue)
 {
     for (auto& c : m_cubes)
-        c.RenderDepth(depthShader);
+        c.Submit(queue);
     for (auto& o : m_objects)
-        o.RenderDepth(depthShader);
-}
-
-void TowerScene::Render(Shader& mainShader, Camera& camera)
-{
-    std::vector<glm::vec3> dummyLP, dummyLC;
-    for (auto& c : m_cubes)
-        c.Render(camera, dummyLP, dummyLC);
-    for (auto& o : m_objects)
-        o.Render(camera, dummyLP, dummyLC);
+        o.Submit(queue);
     for (auto& sun : m_suns)
-        sun.Render(camera, dummyLP, dummyLC);
+        sun.Submit(queue);
 }
 
 const std::vector<glm::vec3>& TowerScene::GetLightPositions() const { return m_lightPositions; }
@@ -186,19 +167,18 @@ void StructureScene::Init(Shader& shaderLight, Shader& shader)
     // Create suns
     for (size_t i = 0; i < m_lightPositions.size(); i++)
     {
-        Sun sun(shaderLight, m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
-        m_suns.push_back(sun);
+        m_suns.emplace_back(shaderLight, m_sceneGraph.Root(), m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
     }
 
 
 
     // Add structure object
-    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/trinity.obj"),
+    m_objects.emplace_back(shader, FileSystem::getPath("resources/objects/trinity.obj"), m_sceneGraph.Root(),
                            glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f), glm::vec3(0.1f));
 
     // Add floor
     unsigned int floorTex = loadTexture(FileSystem::getPath("resources/textures/gray_concrete_powder.png").c_str(), true);
-    m_cubes.emplace_back(shader, floorTex, glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
+    m_cubes.emplace_back(shader, floorTex, m_sceneGraph.Root(), glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f), glm::vec3(50.f, 1.0f, 50.f));
 
     // Clear orbit parameters as they are not needed
     m_angleOffsetsDeg.clear();
@@ -210,23 +190,14 @@ void StructureScene::Update(float dt)
     // Currently no updates required
 }
 
-void StructureScene::RenderDepth(Shader& depthShader)
+void StructureScene::Submit(RenderQueue& queue)
 {
     for (auto& c : m_cubes)
-        c.RenderDepth(depthShader);
+        c.Submit(queue);
     for (auto& o : m_objects)
-        o.RenderDepth(depthShader);
-}
-
-void StructureScene::Render(Shader& mainShader, Camera& camera)
-{
-    std::vector<glm::vec3> dummyLP, dummyLC;
-    for (auto& c : m_cubes)
-        c.Render(camera, dummyLP, dummyLC);
-    for (auto& o : m_objects)
-        o.Render(camera, dummyLP, dummyLC);
+        o.Submit(queue);
     for (auto& sun : m_suns)
-        sun.Render(camera, dummyLP, dummyLC);
+        sun.Submit(queue);
 }
 
 const std::vector<glm::vec3>& StructureScene::GetLightPositions() const { return m_lightPositions; }
@@ -253,8 +224,7 @@ void TreesScene::Init(Shader& shaderLight, Shader& shader)
     // Create suns
     for (size_t i = 0; i < m_lightPositions.size(); i++)
     {
-        Sun sun(shaderLight, m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
-        m_suns.push_back(sun);
+        m_suns.emplace_back(shaderLight, m_sceneGraph.Root(), m_lightColors[i], m_lightPositions[i], glm::vec3(0.f), glm::vec3(0.25f));
     }
 
     // Load tree models
@@ -268,6 +238,9 @@ void TreesScene::Init(Shader& shaderLight, Shader& shader)
     std::uniform_int_distribution<int> distTreeType(1, 2);
     std::uniform_real_distribution<float> distScale(0.8f, 1.2f);
 
+    // Trees share a parent so the whole forest can be moved with one node
+    SceneNode* forest = m_sceneGraph.Root().AddChild();
+
     for(int i = 0; i < m_numTrees; ++i)
     {
         float x = distPos(gen);
@@ -279,12 +252,12 @@ void TreesScene::Init(Shader& shaderLight, Shader& shader)
 
         float scaleFactor = distScale(gen);
 
-        m_trees.emplace_back(shader, treePath, glm::vec3(x, y, z), glm::vec3(0.f), glm::vec3(scaleFactor));
+        m_trees.emplace_back(shader, treePath, *forest, glm::vec3(x, y, z), glm::vec3(0.f), glm::vec3(scaleFactor));
     }
 
     // Add floor
     unsigned int floorTex = loadTexture(FileSystem::getPath("resources/textures/grass_block_top.png").c_str(), true);
-    m_cubes.emplace_back(shader, floorTex, glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f), glm::vec3(100.f, 1.0f, 100.f));
+    m_cubes.emplace_back(shader, floorTex, m_sceneGraph.Root(), glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f), glm::vec3(100.f, 1.0f, 100.f));
 }
 
 void TreesScene::Update(float dt)
@@ -292,21 +265,13 @@ void TreesScene::Update(float dt)
     // No updates required as suns are linked to the camera
 }
 
-void TreesScene::RenderDepth(Shader& depthShader)
-{
-    for (auto& c : m_cubes)
-        c.RenderDepth(depthShader);
-    for (auto& t : m_trees)
-        t.RenderDepth(depthShader);
-}
-
-void TreesScene::Render(Shader& mainShader, Camera& camera)
+void TreesScene::Submit(RenderQueue& queue)
 {
-    m_cubes[0].Render(camera, m_lightPositions, m_lightColors);
+    m_cubes[0].Submit(queue);
     for (auto& t : m_trees)
-        t.Render(camera, m_lightPositions, m_lightColors);
+        t.Submit(queue);
     for (auto& sun : m_suns)
-        sun.Render(camera, m_lightPositions, m_lightColors);
+        sun.Submit(queue);
 }
 
 const std::vector<glm::vec3>& TreesScene::GetLightPositions() const { return m_lightPositions; }
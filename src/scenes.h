@@ -2,6 +2,7 @@
 #include <glm/glm.hpp>
 #include "helpers/shader.h"
 #include "helpers/camera.h"
+#include "includes/SceneGraph.h"
 #include <vector>
 #include <string>
 
@@ -9,6 +10,7 @@
 class Sun;
 class Cube;
 class Object;
+class RenderQueue;
 
 // base class for all scenes.
 class BaseScene
@@ -18,12 +20,19 @@ public:
 
     virtual void Init(Shader& shaderLight, Shader& shader) = 0;
     virtual void Update(float dt) = 0;
-    virtual void RenderDepth(Shader& depthShader) = 0;
-    virtual void Render(Shader& mainShader, Camera& camera) = 0;
+    // Queues this frame's draw packets; the caller sorts and flushes for each pass
+    virtual void Submit(RenderQueue& queue) = 0;
 
     virtual const std::vector<glm::vec3>& GetLightPositions() const = 0;
     virtual const std::vector<glm::vec3>& GetLightColors() const = 0;
     virtual size_t GetLightCount() const = 0;
+
+    // Every object in the scene hangs off this graph; the caller updates it
+    // after Update() so only the nodes moved this frame are recomputed
+    SceneGraph& GetSceneGraph() { return m_sceneGraph; }
+
+protected:
+    SceneGraph m_sceneGraph;
 };
 
 // Scene representing a park environment.
@@ -32,8 +41,7 @@ class ParkScene : public BaseScene
 public:
     void Init(Shader& shaderLight, Shader& shader) override;
     void Update(float dt) override;
-    void RenderDepth(Shader& depthShader) override;
-    void Render(Shader& mainShader, Camera& camera) override;
+    void Submit(RenderQueue& queue) override;
 
     const std::vector<glm::vec3>& GetLightPositions() const override;
     const std::vector<glm::vec3>& GetLightColors() const override;
@@ -57,8 +65,7 @@ class TowerScene : public BaseScene
 public:
     void Init(Shader& shaderLight, Shader& shader) override;
     void Update(float dt) override;
-    void RenderDepth(Shader& depthShader) override;
-    void Render(Shader& mainShader, Camera& camera) override;
+    void Submit(RenderQueue& queue) override;
 
     const std::vector<glm::vec3>& GetLightPositions() const override;
     const std::vector<glm::vec3>& GetLightColors() const override;
@@ -82,8 +89,7 @@ class StructureScene : public BaseScene
 public:
     void Init(Shader& shaderLight, Shader& shader) override;
     void Update(float dt) override;
-    void RenderDepth(Shader& depthShader) override;
-    void Render(Shader& mainShader, Camera& camera) override;
+    void Submit(RenderQueue& queue) override;
 
     const std::vector<glm::vec3>& GetLightPositions() const override;
     const std::vector<glm::vec3>& GetLightColors() const override;
@@ -107,8 +113,7 @@ class TreesScene : public BaseScene
 public:
     void Init(Shader& shaderLight, Shader& shader) override;
     void Update(float dt) override;
-    void RenderDepth(Shader& depthShader) override;
-    void Render(Shader& mainShader, Camera& camera) override;
+    void Submit(RenderQueue& queue) override;
 
     const std::vector<glm::vec3>& GetLightPositions() const override;
     const std::vector<glm::vec3>& GetLightColors() const override;
@@ -15,10 +15,17 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-// Uniforms for camera & transformations
+// Camera & frame constants shared by all programs
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// Per-object transformation
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 // Uniforms for bone transformations
 const int MAX_BONES = 100;
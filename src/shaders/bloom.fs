@@ -1,5 +1,7 @@
 #version 330 core
-#define NUM_LIGHTS 4
+#extension GL_ARB_texture_cube_map_array : enable
+#extension GL_EXT_texture_shadow_lod : enable
+#define MAX_LIGHTS 16
 
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
@@ -10,19 +12,75 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// ShadowSlice: cube in shadowAtlas (-1: no shadow), ShadowLod: its mip level
 struct Light {
     vec3 Position;
+    int ShadowSlice;
     vec3 Color;
+    float ShadowLod;
+};
+
+layout (std140) uniform LightData {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
+
+layout (std140) uniform ClusterData {
+    ivec4 clusterGrid;  // xyz froxel counts, w = light count
+    vec4 clusterScale;  // xy froxels per pixel, slice = log(depth) * z + w
 };
 
-uniform Light lights[NUM_LIGHTS];
 uniform sampler2D diffuseTexture;
-uniform samplerCube depthMaps[NUM_LIGHTS];
-uniform vec3 viewPos;
-uniform float far_plane;
-uniform bool shadows;
-uniform int lightCount;
-uniform float ambientS;
+
+// Clustered lights: two texels per light (position + radius, colour),
+// first index + count per froxel, and the froxels' light index lists
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+
+#define SHADOW_FILTER_PCF     0
+#define SHADOW_FILTER_COMPARE 1
+#define SHADOW_FILTER_MOMENTS 2
+
+// Compile-time features, set per variant by Shader::variant(); the defaults build the base
+// program. SHADOWS 0 drops every shadow path; SHADOW_FILTER and SHADOW_TAPS fix the filter
+// and its disk taps (ShadowMaps::GetFilter / FilterTaps). The base program stands in while a
+// variant builds, so it alone still checks the shadow toggle at run time.
+#ifndef SHADOWS
+#define SHADOW_STANDIN 1
+#define SHADOWS 1
+#endif
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_COMPARE
+#endif
+#ifndef SHADOW_TAPS
+#define SHADOW_TAPS 4
+#endif
+
+#if SHADOWS
+#if SHADOW_FILTER == SHADOW_FILTER_PCF
+uniform samplerCubeArray shadowAtlas;              // every light's shadow cube, one slice each
+#elif SHADOW_FILTER == SHADOW_FILTER_COMPARE
+uniform samplerCubeArrayShadow shadowAtlasCompare; // the atlas, compared in hardware
+#else
+uniform samplerCubeArray shadowMoments;            // blurred distance moments
+#endif
 
 vec3 gridSamplingDisk[20] = vec3[]
 (
@@ -33,33 +91,80 @@ vec3 gridSamplingDisk[20] = vec3[]
    vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
 );
 
+const float SHADOW_BIAS = 0.25;
+// Chebyshev bound below this is taken as fully shadowed, to cut light bleeding
+const float LIGHT_BLEED_CUT = 0.2;
+const float MIN_VARIANCE = 1e-7;
 
-float ShadowCalculation(vec3 fragPos, vec3 lightPos, int index)
+// One atlas for every light: the slice and level come from the light block
+vec4 ShadowCoord(int index, vec3 direction)
 {
-    vec3 fragToLight = fragPos - lightPos;
-    float currentDepth = length(fragToLight);
+    return vec4(direction, float(lights[index].ShadowSlice));
+}
 
-    // Sample closest depth from depth map (shadow cubemap)
-    float closestDepth = texture(depthMaps[index], fragToLight).r;
-    closestDepth *= far_plane; // Undo mapping [0;1]
+#if SHADOW_FILTER == SHADOW_FILTER_MOMENTS
+// Chebyshev upper bound on the lit fraction from the blurred distance moments
+float MomentShadow(int index, vec3 fragToLight)
+{
+    vec2 moments = textureLod(shadowMoments, ShadowCoord(index, fragToLight), lights[index].ShadowLod).rg;
+    float distance = (length(fragToLight) - SHADOW_BIAS) / shadowPlanes[index].y;
+    if (distance <= moments.x)
+        return 0.0;
+    float variance = max(moments.y - moments.x * moments.x, MIN_VARIANCE);
+    float delta = distance - moments.x;
+    float lit = variance / (variance + delta * delta);
+    return 1.0 - clamp((lit - LIGHT_BLEED_CUT) / (1.0 - LIGHT_BLEED_CUT), 0.0, 1.0);
+}
+#else
+// Window depth the shadow pass stored for a point at offset v from the light:
+// the face projection of v's major axis, moved bias towards the light
+float CubeDepth(int index, vec3 v, float bias)
+{
+    float z = max(abs(v.x), max(abs(v.y), abs(v.z))) - bias;
+    float n = shadowPlanes[index].x;
+    float f = shadowPlanes[index].y;
+    return (f + n) / (2.0 * (f - n)) + 0.5 - f * n / ((f - n) * z);
+}
 
-    // Check whether current frag pos is in shadow
-    float bias = 0.25;
-    float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
+// 1 where lit; hardware 2x2 bilinear comparison, or a single manual one
+float LitDepth(int index, vec3 direction, float reference)
+{
+#if SHADOW_FILTER == SHADOW_FILTER_COMPARE
+#ifdef GL_EXT_texture_shadow_lod
+    return textureLod(shadowAtlasCompare, ShadowCoord(index, direction), reference, lights[index].ShadowLod);
+#else
+    // base level only; ShadowMaps keeps every light at level 0 for this filter
+    return texture(shadowAtlasCompare, ShadowCoord(index, direction), reference);
+#endif
+#else
+    return reference <= textureLod(shadowAtlas, ShadowCoord(index, direction), lights[index].ShadowLod).r ? 1.0 : 0.0;
+#endif
+}
+#endif
 
-    // PCF
-    int samples = 20;
+float ShadowCalculation(vec3 fragPos, vec3 lightPos, int index)
+{
+    vec3 fragToLight = fragPos - lightPos;
+#if SHADOW_FILTER == SHADOW_FILTER_MOMENTS
+    return MomentShadow(index, fragToLight);
+#else
+    // PCF over the centre and SHADOW_TAPS points of the disk; each compare tap already filters 2x2
+    float reference = CubeDepth(index, fragToLight, SHADOW_BIAS);
     float diskRadius = (1.0 + (length(viewPos - fragPos) / far_plane)) / 25.0;
-    for(int i = 0; i < samples; ++i)
-    {
-        float closestDepth = texture(depthMaps[index], fragToLight + gridSamplingDisk[i] * diskRadius).r;
-        closestDepth *= far_plane; // Undo mapping [0;1]
-        if(currentDepth - bias > closestDepth)
-            shadow += 1.0;
-    }
-    shadow /= float(samples + 1); // +1 for the initial shadow
+    float lit = LitDepth(index, fragToLight, reference);
+    for(int i = 0; i < SHADOW_TAPS; ++i)
+        lit += LitDepth(index, fragToLight + gridSamplingDisk[i] * diskRadius, reference);
+    return 1.0 - lit / float(SHADOW_TAPS + 1);
+#endif
+}
+#endif
 
-    return shadow;
+// Inverse square, windowed so it reaches zero at the light's radius instead of cutting off there
+float Attenuation(float distance, float radius)
+{
+    float ratio = distance / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance);
 }
 
 void main()
@@ -70,24 +175,43 @@ void main()
     // ambient
     vec3 ambient = ambientS * color;
 
+    // froxel of this fragment
+    float viewDepth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    ivec3 froxel = ivec3(ivec2(gl_FragCoord.xy * clusterScale.xy),
+                         int(log(max(viewDepth, 1e-4)) * clusterScale.z + clusterScale.w));
+    froxel = clamp(froxel, ivec3(0), clusterGrid.xyz - 1);
+    uvec2 range = texelFetch(clusterRanges, froxel.x + clusterGrid.x * (froxel.y + clusterGrid.y * froxel.z)).xy;
+
     // lighting
     vec3 lighting = vec3(0.0);
-    for(int i = 0; i < lightCount; i++)
+    for(uint n = 0u; n < range.y; n++)
     {
+        int i = int(texelFetch(clusterIndices, int(range.x + n)).r);
+        vec4 positionRadius = texelFetch(clusterLights, i * 2);
+        vec3 lightColor = texelFetch(clusterLights, i * 2 + 1).rgb;
+
+        float distance = length(fs_in.FragPos - positionRadius.xyz);
+        if (distance > positionRadius.w)
+            continue;
         // diffuse
-        vec3 lightDir = normalize(lights[i].Position - fs_in.FragPos);
+        vec3 lightDir = normalize(positionRadius.xyz - fs_in.FragPos);
         float diff = max(dot(lightDir, normal), 0.0);
-        vec3 result = lights[i].Color * diff * color;      
+        vec3 result = lightColor * diff * color;
         // attenuation (use quadratic as we have gamma correction)
-        float distance = length(fs_in.FragPos - lights[i].Position);
-        result *= 1.0 / (distance * distance);
-        
-        // Shadow
-        float shadow = shadows ? ShadowCalculation(fs_in.FragPos, lights[i].Position, i) : 0.0;
+        result *= Attenuation(distance, positionRadius.w);
+
+#if SHADOWS
+        // Shadow (lights past the light block, or not given a slice yet, cast none)
+#ifdef SHADOW_STANDIN
+        bool shadowed = shadows != 0 && i < lightCount && lights[i].ShadowSlice >= 0;
+#else
+        bool shadowed = i < lightCount && lights[i].ShadowSlice >= 0;
+#endif
+        float shadow = shadowed ? ShadowCalculation(fs_in.FragPos, positionRadius.xyz, i) : 0.0;
         result *= (1.0 - shadow);
-        
+#endif
+
         lighting += result;
-                
     }
     vec3 result = ambient + lighting;
     // Check brightness for bloom
@@ -2,24 +2,38 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per instance, streamed by the render queue
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in mat3 aInstanceNormal;
+layout (location = 14) in vec3 aInstanceColor;
 
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
 } vs_out;
+// outside the block so bloom.fs, which ignores it, still matches VS_OUT
+flat out vec3 InstanceColor;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// matches depth_prepass.vs, whose depth the shading pass tests against
+invariant gl_Position;
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vec4 worldPos = aInstanceModel * vec4(aPos, 1.0);
+    vs_out.FragPos = vec3(worldPos);
     vs_out.TexCoords = aTexCoords;
+    InstanceColor = aInstanceColor;
         
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vs_out.Normal = normalize(normalMatrix * aNormal);
+    vs_out.Normal = normalize(aInstanceNormal * aNormal);
     
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
 }
\ No newline at end of file
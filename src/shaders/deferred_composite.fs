@@ -0,0 +1,32 @@
+#version 330 core
+// Ambient plus the accumulated lights, with the same outputs as bloom.fs;
+// also copies the G-buffer depth so forward passes can draw on top
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
+uniform sampler2D lightAccumulation;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 albedo = texelFetch(gAlbedo, texel, 0);
+    vec3 result = ambientS * albedo.rgb + texelFetch(lightAccumulation, texel, 0).rgb;
+
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, albedo.a);
+    gl_FragDepth = texelFetch(gDepth, texel, 0).r;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// G-buffer pass: albedo and an octahedral normal; depth comes from the depth buffer
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec2 gNormal;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+uniform sampler2D diffuseTexture;
+
+// Unit vector -> [-1, 1]^2: project onto the octahedron, fold the lower half over
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+void main()
+{
+    gAlbedo = texture(diffuseTexture, fs_in.TexCoords);
+    gNormal = OctEncode(normalize(fs_in.Normal));
+}
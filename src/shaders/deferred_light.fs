@@ -0,0 +1,238 @@
+#version 330 core
+#extension GL_ARB_texture_cube_map_array : enable
+#extension GL_EXT_texture_shadow_lod : enable
+#define MAX_LIGHTS 16
+
+// Additive: each light volume adds its light where it covers the G-buffer
+layout (location = 0) out vec4 FragColor;
+
+flat in int LightIndex;
+flat in vec4 LightPositionRadius;
+flat in vec3 LightColor;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// ShadowSlice: cube in shadowAtlas (-1: no shadow), ShadowLod: its mip level
+struct Light {
+    vec3 Position;
+    int ShadowSlice;
+    vec3 Color;
+    float ShadowLod;
+};
+
+layout (std140) uniform LightData {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+#define SHADOW_FILTER_PCF     0
+#define SHADOW_FILTER_COMPARE 1
+#define SHADOW_FILTER_MOMENTS 2
+
+// Compile-time features, set per variant by DeferredRenderer::SetShadowVariant(): SHADOWS,
+// TEMPORAL_SHADOWS (read the resolved history instead of filtering), SHADOW_FILTER and
+// SHADOW_TAPS. Without them this builds the stand-in drawn until a variant is ready, which
+// keeps every path and follows the ShadowData block and temporalShadows at run time.
+#ifndef SHADOWS
+#define SHADOW_STANDIN 1
+#define SHADOWS 1
+#endif
+#ifndef TEMPORAL_SHADOWS
+#define TEMPORAL_SHADOWS 0
+#endif
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_PCF
+#endif
+#ifndef SHADOW_TAPS
+#define SHADOW_TAPS 20
+#endif
+
+#ifdef SHADOW_STANDIN
+#define USES_FILTER(f)  1
+#define USES_HISTORY    1
+#define SHADOWS_ON      (shadows != 0)
+#define TEMPORAL_ON     (temporalShadows != 0)
+#define FILTER          shadowFilter
+#define TAPS            shadowTaps
+uniform int temporalShadows;
+#else
+#define USES_FILTER(f)  (SHADOWS != 0 && TEMPORAL_SHADOWS == 0 && SHADOW_FILTER == (f))
+#define USES_HISTORY    (SHADOWS != 0 && TEMPORAL_SHADOWS != 0)
+#define SHADOWS_ON      true
+#define TEMPORAL_ON     (TEMPORAL_SHADOWS != 0)
+#define FILTER          SHADOW_FILTER
+#define TAPS            SHADOW_TAPS
+#endif
+
+#if USES_FILTER(SHADOW_FILTER_PCF)
+uniform samplerCubeArray shadowAtlas;              // every light's shadow cube, one slice each
+#endif
+#if USES_FILTER(SHADOW_FILTER_COMPARE)
+uniform samplerCubeArrayShadow shadowAtlasCompare; // the same atlas, compared in hardware
+#endif
+#if USES_FILTER(SHADOW_FILTER_MOMENTS)
+uniform samplerCubeArray shadowMoments;            // blurred distance moments
+#endif
+#if USES_HISTORY
+// temporally accumulated terms from deferred_shadow_resolve.fs, four lights a layer
+uniform sampler2DArray shadowHistory;
+#endif
+
+vec3 gridSamplingDisk[20] = vec3[]
+(
+   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1),
+   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+   vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
+   vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
+   vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
+);
+
+vec3 OctDecode(vec2 f)
+{
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+const float SHADOW_BIAS = 0.25;
+// Chebyshev bound below this is taken as fully shadowed, to cut light bleeding
+const float LIGHT_BLEED_CUT = 0.2;
+const float MIN_VARIANCE = 1e-7;
+
+// One atlas for every light: the slice and level come from the light block
+vec4 ShadowCoord(int index, vec3 direction)
+{
+    return vec4(direction, float(lights[index].ShadowSlice));
+}
+
+#if USES_FILTER(SHADOW_FILTER_PCF) || USES_FILTER(SHADOW_FILTER_COMPARE)
+// Window depth the shadow pass stored for a point at offset v from the light:
+// the face projection of v's major axis, moved bias towards the light
+float CubeDepth(int index, vec3 v, float bias)
+{
+    float z = max(abs(v.x), max(abs(v.y), abs(v.z))) - bias;
+    float n = shadowPlanes[index].x;
+    float f = shadowPlanes[index].y;
+    return (f + n) / (2.0 * (f - n)) + 0.5 - f * n / ((f - n) * z);
+}
+
+// 1 where lit; hardware 2x2 bilinear comparison, or a single manual one
+float LitDepth(int index, vec3 direction, float reference)
+{
+#if USES_FILTER(SHADOW_FILTER_COMPARE)
+    if (FILTER == SHADOW_FILTER_COMPARE)
+    {
+#ifdef GL_EXT_texture_shadow_lod
+        return textureLod(shadowAtlasCompare, ShadowCoord(index, direction), reference, lights[index].ShadowLod);
+#else
+        // base level only; ShadowMaps keeps every light at level 0 for this filter
+        return texture(shadowAtlasCompare, ShadowCoord(index, direction), reference);
+#endif
+    }
+#endif
+#if USES_FILTER(SHADOW_FILTER_PCF)
+    return reference <= textureLod(shadowAtlas, ShadowCoord(index, direction), lights[index].ShadowLod).r ? 1.0 : 0.0;
+#else
+    return 1.0;
+#endif
+}
+#endif
+
+#if USES_FILTER(SHADOW_FILTER_MOMENTS)
+// Chebyshev upper bound on the lit fraction from the blurred distance moments
+float MomentShadow(int index, vec3 fragToLight)
+{
+    vec2 moments = textureLod(shadowMoments, ShadowCoord(index, fragToLight), lights[index].ShadowLod).rg;
+    float distance = (length(fragToLight) - SHADOW_BIAS) / shadowPlanes[index].y;
+    if (distance <= moments.x)
+        return 0.0;
+    float variance = max(moments.y - moments.x * moments.x, MIN_VARIANCE);
+    float delta = distance - moments.x;
+    float lit = variance / (variance + delta * delta);
+    return 1.0 - clamp((lit - LIGHT_BLEED_CUT) / (1.0 - LIGHT_BLEED_CUT), 0.0, 1.0);
+}
+#endif
+
+// Same filters as the forward path (bloom.fs)
+float ShadowCalculation(vec3 fragPos, vec3 lightPos, int index)
+{
+    vec3 fragToLight = fragPos - lightPos;
+#if USES_FILTER(SHADOW_FILTER_MOMENTS)
+    if (FILTER == SHADOW_FILTER_MOMENTS)
+        return MomentShadow(index, fragToLight);
+#endif
+#if USES_FILTER(SHADOW_FILTER_PCF) || USES_FILTER(SHADOW_FILTER_COMPARE)
+    // PCF over the centre and TAPS points of the disk; each compare tap already filters 2x2
+    float reference = CubeDepth(index, fragToLight, SHADOW_BIAS);
+    float diskRadius = (1.0 + (length(viewPos - fragPos) / far_plane)) / 25.0;
+    float lit = LitDepth(index, fragToLight, reference);
+    for(int i = 0; i < TAPS; ++i)
+        lit += LitDepth(index, fragToLight + gridSamplingDisk[i] * diskRadius, reference);
+    return 1.0 - lit / float(TAPS + 1);
+#else
+    return 0.0;
+#endif
+}
+
+// Inverse square, windowed so it reaches zero at the light's radius instead of cutting off there
+float Attenuation(float distance, float radius)
+{
+    float ratio = distance / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    float distance = length(fragPos - LightPositionRadius.xyz);
+    if (distance > LightPositionRadius.w)
+        discard;
+
+    vec3 color = texelFetch(gAlbedo, texel, 0).rgb;
+    vec3 normal = OctDecode(texelFetch(gNormal, texel, 0).rg);
+
+    vec3 lightDir = normalize(LightPositionRadius.xyz - fragPos);
+    float diff = max(dot(lightDir, normal), 0.0);
+    vec3 result = LightColor * diff * color * Attenuation(distance, LightPositionRadius.w);
+
+    float shadow = 0.0;
+#if SHADOWS
+    if (SHADOWS_ON && LightIndex < lightCount && lights[LightIndex].ShadowSlice >= 0)
+    {
+#if USES_HISTORY
+        if (TEMPORAL_ON)
+            shadow = texelFetch(shadowHistory, ivec3(texel, LightIndex / 4), 0)[LightIndex % 4];
+        else
+#endif
+            shadow = ShadowCalculation(fragPos, LightPositionRadius.xyz, LightIndex);
+    }
+#endif
+    FragColor = vec4(result * (1.0 - shadow), 1.0);
+}
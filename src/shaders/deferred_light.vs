@@ -0,0 +1,31 @@
+#version 330 core
+// One instance per light: the unit sphere scaled to the light's radius
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// position + radius, colour; shared with the clustered forward path
+uniform samplerBuffer clusterLights;
+
+flat out int LightIndex;
+flat out vec4 LightPositionRadius;
+flat out vec3 LightColor;
+
+// The tessellated sphere sits inside the true one; grow it so it still covers the radius
+const float VOLUME_SCALE = 1.05;
+
+void main()
+{
+    LightIndex = gl_InstanceID;
+    LightPositionRadius = texelFetch(clusterLights, gl_InstanceID * 2);
+    LightColor = texelFetch(clusterLights, gl_InstanceID * 2 + 1).rgb;
+
+    vec3 worldPos = LightPositionRadius.xyz + aPos * LightPositionRadius.w * VOLUME_SCALE;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
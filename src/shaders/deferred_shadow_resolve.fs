@@ -0,0 +1,109 @@
+#version 330 core
+#define MAX_LIGHTS 16
+
+// Temporal shadows, second pass: last frame's accumulated terms, reprojected with
+// the camera motion and clamped to this frame's 3x3 neighbourhood, averaged with
+// this frame's few-tap terms. Same four-lights-a-target layout as the samples, plus
+// a last layer counting the frames each pixel's history holds.
+layout (location = 0) out vec4 Shadow0;
+layout (location = 1) out vec4 Shadow1;
+layout (location = 2) out vec4 Shadow2;
+layout (location = 3) out vec4 Shadow3;
+layout (location = 4) out vec4 SampleCount;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+uniform sampler2D gDepth;
+uniform sampler2D previousDepth;
+uniform sampler2DArray shadowSamples;
+uniform sampler2DArray shadowHistory;
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform mat4 inversePreviousViewProjection;
+uniform int historyValid;
+
+// Frames the per-pixel tap rotation takes to cover the disk (TAP_SETS in deferred_shadow_sample.fs)
+const float TAP_SETS = 7.0;
+// The history is a plain running mean of every frame since it was (re)started, so each full
+// rotation of tap sets lands on the 21-tap mean. Past this many frames it becomes a moving
+// average; a whole number of rotations, long enough that the rotation's ripple stays under 1/255.
+const float MAX_SAMPLES = TAP_SETS * 32.0;
+// Clamping moving history further than this means the shadow changed; start the mean over
+const float CLAMP_RESTART = 0.1;
+// History is dropped where last frame's surface was further than this (times the view distance)
+const float DISOCCLUSION_DISTANCE = 0.02;
+
+vec3 WorldPosition(mat4 inverseMatrix, vec2 uv, float depth)
+{
+    vec4 world = inverseMatrix * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(gDepth, 0);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    vec3 fragPos = WorldPosition(inverseViewProjection, gl_FragCoord.xy / vec2(size), depth);
+
+    // where the surface was on screen last frame, and whether it was visible there
+    vec4 previousClip = previousViewProjection * vec4(fragPos, 1.0);
+    vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    bool reproject = historyValid != 0 && depth < 1.0 && previousClip.w > 0.0 &&
+                     all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)));
+    if (reproject)
+    {
+        vec3 previousPos = WorldPosition(inversePreviousViewProjection, previousUV, texture(previousDepth, previousUV).r);
+        reproject = length(previousPos - fragPos) < DISOCCLUSION_DISTANCE * length(viewPos - fragPos);
+    }
+
+    // frames already in the history; the count is fetched, never filtered
+    float samples = 0.0;
+    if (reproject)
+    {
+        ivec2 previousTexel = clamp(ivec2(previousUV * vec2(size)), ivec2(0), size - 1);
+        samples = texelFetch(shadowHistory, ivec3(previousTexel, MAX_LIGHTS / 4), 0).r;
+    }
+
+    vec4 current[MAX_LIGHTS / 4];
+    vec4 history[MAX_LIGHTS / 4];
+    bool restart = !reproject;
+    for (int layer = 0; layer < MAX_LIGHTS / 4; ++layer)
+    {
+        current[layer] = texelFetch(shadowSamples, ivec3(texel, layer), 0);
+        history[layer] = current[layer];
+        if (!reproject)
+            continue;
+
+        // the neighbours tested the rest of the disk; history outside their range is stale
+        vec4 low = current[layer], high = current[layer];
+        for (int y = -1; y <= 1; ++y)
+            for (int x = -1; x <= 1; ++x)
+            {
+                ivec2 neighbour = clamp(texel + ivec2(x, y), ivec2(0), size - 1);
+                vec4 s = texelFetch(shadowSamples, ivec3(neighbour, layer), 0);
+                low = min(low, s);
+                high = max(high, s);
+            }
+        vec4 previous = texture(shadowHistory, vec3(previousUV, float(layer)));
+        history[layer] = clamp(previous, low, high);
+        vec4 moved = abs(history[layer] - previous);
+        restart = restart || max(max(moved.x, moved.y), max(moved.z, moved.w)) > CLAMP_RESTART;
+    }
+    if (restart)
+        samples = 0.0;
+
+    // the mean of samples + 1 frames: this one weighs 1 / (samples + 1)
+    float weight = 1.0 / min(samples + 1.0, MAX_SAMPLES);
+    Shadow0 = mix(history[0], current[0], weight);
+    Shadow1 = mix(history[1], current[1], weight);
+    Shadow2 = mix(history[2], current[2], weight);
+    Shadow3 = mix(history[3], current[3], weight);
+    SampleCount = vec4(min(samples + 1.0, MAX_SAMPLES), 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,163 @@
+#version 330 core
+#extension GL_ARB_texture_cube_map_array : enable
+#extension GL_EXT_texture_shadow_lod : enable
+#define MAX_LIGHTS 16
+
+// Temporal shadows, first pass: every shadowed light's term from a few taps of the
+// PCF disk. The taps rotate each frame and between neighbours, so any 3x3 block
+// covers the whole disk and seven frames of one pixel do too. Four lights a target.
+layout (location = 0) out vec4 Shadow0;
+layout (location = 1) out vec4 Shadow1;
+layout (location = 2) out vec4 Shadow2;
+layout (location = 3) out vec4 Shadow3;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// ShadowSlice: cube in shadowAtlas (-1: no shadow), ShadowLod: its mip level
+struct Light {
+    vec3 Position;
+    int ShadowSlice;
+    vec3 Color;
+    float ShadowLod;
+};
+
+layout (std140) uniform LightData {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
+
+uniform sampler2D gDepth;
+
+#define SHADOW_FILTER_PCF     0
+#define SHADOW_FILTER_COMPARE 1
+
+// SHADOW_FILTER is set per variant by DeferredRenderer::SetShadowVariant(); without it this
+// builds the stand-in drawn until a variant is ready, which follows shadowFilter at run time
+#ifndef SHADOW_FILTER
+#define SHADOW_STANDIN 1
+#define SHADOW_FILTER -1
+#endif
+
+#if defined(SHADOW_STANDIN) || SHADOW_FILTER == SHADOW_FILTER_PCF
+uniform samplerCubeArray shadowAtlas;              // every light's shadow cube, one slice each
+#endif
+#if defined(SHADOW_STANDIN) || SHADOW_FILTER == SHADOW_FILTER_COMPARE
+uniform samplerCubeArrayShadow shadowAtlasCompare; // the same atlas, compared in hardware
+#endif
+// position + radius, colour; shared with the clustered forward path
+uniform samplerBuffer clusterLights;
+uniform mat4 inverseViewProjection;
+uniform int frameIndex;
+
+vec3 gridSamplingDisk[20] = vec3[]
+(
+   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1),
+   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+   vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
+   vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
+   vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
+);
+
+const float SHADOW_BIAS = 0.25;
+// The centre plus the 20 disk points, split into TAP_SETS sets of TEMPORAL_TAPS
+const int DISK_TAPS = 21;
+const int TEMPORAL_TAPS = 3;
+const int TAP_SETS = DISK_TAPS / TEMPORAL_TAPS;
+
+// One atlas for every light: the slice and level come from the light block
+vec4 ShadowCoord(int index, vec3 direction)
+{
+    return vec4(direction, float(lights[index].ShadowSlice));
+}
+
+// Window depth the shadow pass stored for a point at offset v from the light:
+// the face projection of v's major axis, moved bias towards the light
+float CubeDepth(int index, vec3 v, float bias)
+{
+    float z = max(abs(v.x), max(abs(v.y), abs(v.z))) - bias;
+    float n = shadowPlanes[index].x;
+    float f = shadowPlanes[index].y;
+    return (f + n) / (2.0 * (f - n)) + 0.5 - f * n / ((f - n) * z);
+}
+
+// 1 where lit; hardware 2x2 bilinear comparison, or a single manual one
+float LitDepth(int index, vec3 direction, float reference)
+{
+#if defined(SHADOW_STANDIN) || SHADOW_FILTER == SHADOW_FILTER_COMPARE
+#ifdef SHADOW_STANDIN
+    if (shadowFilter == SHADOW_FILTER_COMPARE)
+#endif
+    {
+#ifdef GL_EXT_texture_shadow_lod
+        return textureLod(shadowAtlasCompare, ShadowCoord(index, direction), reference, lights[index].ShadowLod);
+#else
+        // base level only; ShadowMaps keeps every light at level 0 for this filter
+        return texture(shadowAtlasCompare, ShadowCoord(index, direction), reference);
+#endif
+    }
+#endif
+#if defined(SHADOW_STANDIN) || SHADOW_FILTER == SHADOW_FILTER_PCF
+    return reference <= textureLod(shadowAtlas, ShadowCoord(index, direction), lights[index].ShadowLod).r ? 1.0 : 0.0;
+#endif
+}
+
+// This frame's share of the 21-tap PCF in deferred_light.fs, starting at tap first
+float TemporalShadow(vec3 fragPos, int index, int first)
+{
+    vec3 fragToLight = fragPos - lights[index].Position;
+    float reference = CubeDepth(index, fragToLight, SHADOW_BIAS);
+    float diskRadius = (1.0 + (length(viewPos - fragPos) / far_plane)) / 25.0;
+    float lit = 0.0;
+    for(int n = 0; n < TEMPORAL_TAPS; ++n)
+    {
+        int i = first + n;
+        vec3 direction = i == DISK_TAPS - 1 ? fragToLight : fragToLight + gridSamplingDisk[i] * diskRadius;
+        lit += LitDepth(index, direction, reference);
+    }
+    return 1.0 - lit / float(TEMPORAL_TAPS);
+}
+
+void main()
+{
+    vec4 shadow[MAX_LIGHTS / 4] = vec4[](vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0));
+
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth < 1.0)
+    {
+        vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+        vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+        vec3 fragPos = world.xyz / world.w;
+
+        // x + 3y takes all seven values mod 7 over any 3x3 block
+        int first = TEMPORAL_TAPS * ((texel.x + 3 * texel.y + frameIndex) % TAP_SETS);
+        for (int i = 0; i < lightCount; ++i)
+        {
+            if (lights[i].ShadowSlice < 0)
+                continue;
+            vec4 positionRadius = texelFetch(clusterLights, i * 2);
+            if (length(fragPos - positionRadius.xyz) > positionRadius.w)
+                continue;
+            shadow[i / 4][i % 4] = TemporalShadow(fragPos, i, first);
+        }
+    }
+
+    Shadow0 = shadow[0];
+    Shadow1 = shadow[1];
+    Shadow2 = shadow[2];
+    Shadow3 = shadow[3];
+}
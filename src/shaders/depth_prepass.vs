@@ -0,0 +1,21 @@
+#version 330 core
+// Depth pre-pass: position only
+layout (location = 0) in vec3 aPos;
+layout (location = 7) in mat4 aInstanceModel;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// Same expression as bloom.vs, so the shading pass reproduces this depth exactly
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldPos = aInstanceModel * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
+}
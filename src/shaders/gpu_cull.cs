@@ -0,0 +1,99 @@
+#version 430 core
+// One invocation per object: frustum and Hi-Z test, then append the survivor to its
+// draw command and write its instance data where that command's instances start.
+layout (local_size_x = 64) in;
+
+struct Object {
+    mat4 model;
+    vec4 center;   // world box
+    vec4 extent;
+    vec4 color;    // instance tint, xyz
+    uint group;    // draw command index
+    uint pad0, pad1, pad2;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int  baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+// InstanceData: mat4 model + mat3 normal matrix + vec3 color, 28 tightly packed floats
+layout (std430, binding = 2) writeonly buffer Instances { float instances[]; };
+
+uniform uint objectCount;
+uniform vec4 frustumPlanes[6];
+
+uniform bool hiZEnabled;
+uniform mat4 hiZViewProjection; // the view the pyramid was rendered from (last frame)
+uniform vec2 hiZSize;           // level 0 size in texels
+uniform sampler2D hiZ;          // max depth per texel, one level per halving
+
+bool InsideFrustum(vec3 center, vec3 extent)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        vec4 p = frustumPlanes[i];
+        if (dot(p.xyz, center) + dot(abs(p.xyz), extent) + p.w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+bool OccludedByHiZ(vec3 center, vec3 extent)
+{
+    vec3 minP = vec3(1.0), maxP = vec3(0.0);
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0,
+                                             (i & 2) != 0 ? 1.0 : -1.0,
+                                             (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+            return false; // reaches behind the camera, no screen rectangle to test
+        vec3 p = clip.xyz / clip.w * 0.5 + 0.5;
+        minP = min(minP, p);
+        maxP = max(maxP, p);
+    }
+    minP.xy = clamp(minP.xy, 0.0, 1.0);
+    maxP.xy = clamp(maxP.xy, 0.0, 1.0);
+
+    // pick the level where the rectangle spans at most 2x2 texels, so four samples cover it
+    vec2 sizeTexels = (maxP.xy - minP.xy) * hiZSize;
+    float level = ceil(log2(max(max(sizeTexels.x, sizeTexels.y), 1.0)));
+    level = min(level, float(textureQueryLevels(hiZ) - 1));
+
+    float farthest = max(max(textureLod(hiZ, minP.xy, level).r, textureLod(hiZ, vec2(maxP.x, minP.y), level).r),
+                         max(textureLod(hiZ, vec2(minP.x, maxP.y), level).r, textureLod(hiZ, maxP.xy, level).r));
+    return minP.z > farthest;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= objectCount)
+        return;
+
+    Object object = objects[index];
+    if (!InsideFrustum(object.center.xyz, object.extent.xyz))
+        return;
+    if (hiZEnabled && OccludedByHiZ(object.center.xyz, object.extent.xyz))
+        return;
+
+    uint slot = commands[object.group].baseInstance + atomicAdd(commands[object.group].instanceCount, 1u);
+    mat3 normalMatrix = transpose(inverse(mat3(object.model)));
+
+    uint base = slot * 28u;
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            instances[base + uint(c * 4 + r)] = object.model[c][r];
+    for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r)
+            instances[base + 16u + uint(c * 3 + r)] = normalMatrix[c][r];
+    for (int i = 0; i < 3; ++i)
+        instances[base + 25u + uint(i)] = object.color[i];
+}
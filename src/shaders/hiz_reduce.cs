@@ -0,0 +1,32 @@
+#version 430 core
+// Builds one level of the Hi-Z pyramid: each texel keeps the farthest depth it covers.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D source; // depth buffer (sourceLevel < 0) or the pyramid's previous level
+uniform int sourceLevel;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+void main()
+{
+    ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dstSize = imageSize(destination);
+    if (any(greaterThanEqual(dst, dstSize)))
+        return;
+
+    if (sourceLevel < 0)
+    {
+        imageStore(destination, dst, vec4(texelFetch(source, dst, 0).r));
+        return;
+    }
+
+    // with an odd source size the last row/column is folded into the edge texels
+    ivec2 srcSize = textureSize(source, sourceLevel);
+    ivec2 first = dst * 2;
+    ivec2 last = min(first + ivec2(1) + ivec2(equal(dst, dstSize - 1)) * (srcSize & 1), srcSize - 1);
+
+    float farthest = 0.0;
+    for (int y = first.y; y <= last.y; ++y)
+        for (int x = first.x; x <= last.x; ++x)
+            farthest = max(farthest, texelFetch(source, ivec2(x, y), sourceLevel).r);
+    imageStore(destination, dst, vec4(farthest));
+}
@@ -8,11 +8,20 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
-uniform vec3 lightColor;
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+// per light, from the instance data
+flat in vec3 InstanceColor;
 
 void main()
 {           
-    FragColor = vec4(lightColor, 1.0);
+    FragColor = vec4(InstanceColor, 1.0);
     float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
     if(brightness > 1.0)
         BrightColor = vec4(FragColor.rgb, 1.0);
@@ -0,0 +1,5 @@
+#version 330 core
+// colour and depth writes are masked off; only the sample count matters
+void main()
+{
+}
@@ -0,0 +1,19 @@
+#version 330 core
+// primitive cube corners in [-1, 1], stretched over a world-space box
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float far_plane;
+    float ambientS;
+};
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main()
+{
+    gl_Position = projection * view * vec4(mix(boxMin, boxMax, aPos * 0.5 + 0.5), 1.0);
+}
@@ -1,16 +1,36 @@
 #version 330 core
+#define MAX_LIGHTS 16
 in vec4 GS_FragPos;
+flat in int LightIndex; // from the instance's face
 
-uniform vec3 lightPos;
-uniform float far_plane;
+// ShadowSlice: cube in shadowAtlas (-1: no shadow), ShadowLod: its mip level
+struct Light {
+    vec3 Position;
+    int ShadowSlice;
+    vec3 Color;
+    float ShadowLod;
+};
 
-void main()
-{
-    float lightDistance = length(GS_FragPos.xyz - lightPos);
+layout (std140) uniform LightData {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
 
-    // Map to [0;1] range by dividing by far_plane
-    lightDistance = lightDistance / far_plane;
+// Moments for SHADOW_FILTER_MOMENTS; with the other filters no colour buffer is
+// attached and only the (hardware, early-tested) depth is kept
+layout (location = 0) out vec2 Moments;
 
-    // Write this as modified depth
-    gl_FragDepth = lightDistance;
-}
\ No newline at end of file
+void main()
+{
+    // Map to [0;1] range by dividing by the light's far plane
+    float lightDistance = length(GS_FragPos.xyz - lights[LightIndex].Position) / shadowPlanes[LightIndex].y;
+    Moments = vec2(lightDistance, lightDistance * lightDistance);
+}
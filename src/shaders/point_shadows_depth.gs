@@ -1,24 +1,35 @@
 #version 330 core
+#define MAX_LIGHTS 16
 layout (triangles) in;
-layout (triangle_strip, max_vertices=18) out;
+layout (triangle_strip, max_vertices=3) out;
 
-uniform mat4 shadowMatrices[6];
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
 
-in vec4 FragPos[]; // Input from vertex shader
+in VS_OUT {
+    vec4 FragPos;
+    flat int Face;
+    flat int Layer;
+} gs_in[];
 
 out vec4 GS_FragPos; // Output to fragment shader
+flat out int LightIndex;
 
 void main()
 {
-    for(int face = 0; face < 6; ++face)
+    // One face per instance: pass the triangle through to its layer
+    gl_Layer = gs_in[0].Layer;
+    for(int i = 0; i < 3; ++i)
     {
-        gl_Layer = face; // Specify the cube map face to render to
-        for(int i = 0; i < 3; ++i) // For each vertex of the triangle
-        {
-            GS_FragPos = FragPos[i];
-            gl_Position = shadowMatrices[face] * GS_FragPos;
-            EmitVertex();
-        }
-        EndPrimitive();
+        GS_FragPos = gs_in[i].FragPos;
+        LightIndex = gs_in[i].Face / 6;
+        gl_Position = shadowMatrices[gs_in[i].Face] * GS_FragPos;
+        EmitVertex();
     }
-}
\ No newline at end of file
+    EndPrimitive();
+}
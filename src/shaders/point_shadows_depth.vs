@@ -1,12 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 7) in mat4 aInstanceModel; // per instance, streamed by the render queue
+layout (location = 14) in vec3 aInstanceLayer; // per instance: x = atlas layer, y = shadow matrix (light * 6 + face)
 
-uniform mat4 model;
-
-out vec4 FragPos; // Pass the world-space position to the geometry shader
+// Geometry shader fallback for drivers without gl_Layer in the vertex shader;
+// the instance already names its face, so the geometry shader only routes it
+out VS_OUT {
+    vec4 FragPos; // world space
+    flat int Face;
+    flat int Layer;
+} vs_out;
 
 void main()
 {
-    FragPos = model * vec4(aPos, 1.0);
-    gl_Position = FragPos; // Not important, will be overwritten in geometry shader
-}
\ No newline at end of file
+    vs_out.FragPos = aInstanceModel * vec4(aPos, 1.0);
+    vs_out.Face = int(aInstanceLayer.y);
+    vs_out.Layer = int(aInstanceLayer.x);
+    gl_Position = vs_out.FragPos; // Not important, will be overwritten in geometry shader
+}
@@ -0,0 +1,29 @@
+#version 330 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#define MAX_LIGHTS 16
+layout (location = 0) in vec3 aPos;
+layout (location = 7) in mat4 aInstanceModel; // per instance, streamed by the render queue
+layout (location = 14) in vec3 aInstanceLayer; // per instance: x = atlas layer, y = shadow matrix (light * 6 + face)
+
+layout (std140) uniform ShadowData {
+    int shadows;
+    int shadowFilter; // SHADOW_FILTER_*
+    int shadowTaps;   // disk taps besides the centre (PCF / compare)
+    vec4 shadowPlanes[MAX_LIGHTS]; // per light: x = near, y = far (its radius)
+    mat4 shadowMatrices[MAX_LIGHTS * 6];
+};
+
+// Same outputs as point_shadows_depth.gs, without a geometry stage:
+// each instance picks its own cube face layer
+out vec4 GS_FragPos;
+flat out int LightIndex;
+
+void main()
+{
+    int face = int(aInstanceLayer.y);
+    GS_FragPos = aInstanceModel * vec4(aPos, 1.0);
+    LightIndex = face / 6;
+    gl_Position = shadowMatrices[face] * GS_FragPos;
+    gl_Layer = int(aInstanceLayer.x);
+}
@@ -0,0 +1,55 @@
+#version 330 core
+#extension GL_ARB_texture_cube_map_array : enable
+
+// Separable Gaussian over one cube face of the moments atlas. The horizontal pass
+// reads the face through cube directions, so taps past its edge land on the
+// neighbouring face, and writes blurTemp; the vertical pass reads blurTemp back
+// into the face.
+layout (location = 0) out vec2 Moments;
+
+uniform samplerCubeArray moments;
+uniform sampler2D blurTemp;
+uniform int blurPass;  // 0: horizontal (face -> blurTemp), 1: vertical (blurTemp -> face)
+uniform int face;      // GL cube face order, +X -X +Y -Y +Z -Z
+uniform float slice;
+uniform float lod;
+uniform float size;    // face resolution at lod
+uniform int radius;    // taps either side of the centre
+
+// Direction through the face at uv in [-1, 1] (GL spec cube face table)
+vec3 FaceDirection(vec2 uv)
+{
+    if (face == 0) return vec3( 1.0, -uv.y, -uv.x);
+    if (face == 1) return vec3(-1.0, -uv.y,  uv.x);
+    if (face == 2) return vec3( uv.x,  1.0,  uv.y);
+    if (face == 3) return vec3( uv.x, -1.0, -uv.y);
+    if (face == 4) return vec3( uv.x, -uv.y,  1.0);
+    return vec3(-uv.x, -uv.y, -1.0);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float sigma = float(radius) * 0.5 + 0.5;
+
+    vec2 sum = vec2(0.0);
+    float weightSum = 0.0;
+    for (int k = -radius; k <= radius; ++k)
+    {
+        float weight = exp(-float(k * k) / (2.0 * sigma * sigma));
+        vec2 value;
+        if (blurPass == 0)
+        {
+            vec2 uv = (gl_FragCoord.xy + vec2(float(k), 0.0)) / size * 2.0 - 1.0;
+            value = textureLod(moments, vec4(FaceDirection(uv), slice), lod).rg;
+        }
+        else
+        {
+            ivec2 tap = clamp(texel + ivec2(0, k), ivec2(0), ivec2(int(size) - 1));
+            value = texelFetch(blurTemp, tap, 0).rg;
+        }
+        sum += value * weight;
+        weightSum += weight;
+    }
+    Moments = sum / weightSum;
+}